@@ -32,6 +32,7 @@ requires+=(
 	which
 	yelp-tools
 	libxss
+	libxext
 )
 
 infobegin "Update system"
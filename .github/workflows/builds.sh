@@ -18,7 +18,7 @@ infoend() {
 if [ -f meson.build ]; then
 
 	infobegin "Configure (meson)"
-	meson setup _build --prefix=/usr
+	meson setup _build --prefix=/usr -Dbenchmarks=true
 	infoend
 
 	infobegin "Build (meson)"
@@ -31,6 +31,7 @@ requires+=(
 	mate-common
 	yelp-tools
 	libxss-dev
+	libxext-dev
 )
 
 infobegin "Update system"
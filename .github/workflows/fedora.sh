@@ -33,6 +33,7 @@ requires+=(
 	mpfr-devel
 	redhat-rpm-config
 	libXScrnSaver-devel
+	libXext-devel
 )
 
 infobegin "Update system"
@@ -0,0 +1,596 @@
+/*
+ * session-bench.c - Latency benchmark for the libmateui session helpers
+ *
+ * Runs a private D-Bus daemon with a stub org.gnome.SessionManager that
+ * answers every call after a configurable delay, then measures how long
+ * the session calls keep the main thread from running its loop, and how
+ * often an idle watch and an idle callback wake the main loop up.
+ *
+ * Run with: meson test -C build --benchmark
+ *       or: ./build/benchmarks/mate-ui-session-bench --delay 50
+ */
+
+#include "mate-ui.h"
+
+#define SM_DBUS_NAME      "org.gnome.SessionManager"
+#define SM_DBUS_PATH      "/org/gnome/SessionManager"
+#define SM_DBUS_INTERFACE "org.gnome.SessionManager"
+
+static gint iterations = 200;
+static gint delay_ms = 0;
+static gint idle_seconds = 5;
+
+static const GOptionEntry options[] = {
+    { "iterations", 'n', 0, G_OPTION_ARG_INT, &iterations, "Calls per measurement", "N" },
+    { "delay", 'd', 0, G_OPTION_ARG_INT, &delay_ms, "Stub reply delay in milliseconds", "MS" },
+    { "idle-seconds", 'i', 0, G_OPTION_ARG_INT, &idle_seconds, "Time spent counting idle wakeups", "SECS" },
+    { NULL }
+};
+
+/*
+ * Stub session manager
+ *
+ * Lives on its own connection and thread, so replies keep flowing while
+ * the main thread is blocked in a synchronous call.
+ */
+static const gchar stub_xml[] =
+    "<node>"
+    "  <interface name='org.gnome.SessionManager'>"
+    "    <method name='Inhibit'>"
+    "      <arg type='s' direction='in'/>"
+    "      <arg type='u' direction='in'/>"
+    "      <arg type='s' direction='in'/>"
+    "      <arg type='u' direction='in'/>"
+    "      <arg type='u' direction='out'/>"
+    "    </method>"
+    "    <method name='Uninhibit'>"
+    "      <arg type='u' direction='in'/>"
+    "    </method>"
+    "    <method name='IsInhibited'>"
+    "      <arg type='u' direction='in'/>"
+    "      <arg type='b' direction='out'/>"
+    "    </method>"
+    "    <method name='RegisterClient'>"
+    "      <arg type='s' direction='in'/>"
+    "      <arg type='s' direction='in'/>"
+    "      <arg type='o' direction='out'/>"
+    "    </method>"
+    "    <signal name='InhibitorAdded'>"
+    "      <arg type='o'/>"
+    "    </signal>"
+    "    <signal name='InhibitorRemoved'>"
+    "      <arg type='o'/>"
+    "    </signal>"
+    "    <property name='InhibitedActions' type='u' access='read'/>"
+    "  </interface>"
+    "</node>";
+
+typedef struct
+{
+    GMutex           mutex;
+    GCond            cond;
+    gboolean         ready;
+    const gchar     *address;
+    GMainContext    *context;
+    GDBusConnection *connection;
+    GHashTable      *inhibitors;    /* cookie -> flags */
+    guint            next_cookie;
+    guint            next_client;
+} Stub;
+
+typedef struct
+{
+    GDBusMethodInvocation *invocation;
+    GVariant              *reply;
+} StubReply;
+
+static Stub stub;
+
+static gboolean
+stub_reply_cb(gpointer user_data)
+{
+    StubReply *reply = user_data;
+
+    g_dbus_method_invocation_return_value(reply->invocation, reply->reply);
+    g_free(reply);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+stub_emit(const gchar *signal_name,
+          guint        cookie)
+{
+    gchar *path = g_strdup_printf("/org/gnome/SessionManager/Inhibitor%u", cookie);
+
+    g_dbus_connection_emit_signal(stub.connection, NULL,
+                                  SM_DBUS_PATH, SM_DBUS_INTERFACE, signal_name,
+                                  g_variant_new("(o)", path), NULL);
+    g_free(path);
+}
+
+static guint
+stub_inhibited_actions(void)
+{
+    GHashTableIter iter;
+    gpointer value;
+    guint actions = 0;
+
+    g_hash_table_iter_init(&iter, stub.inhibitors);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        actions |= GPOINTER_TO_UINT(value);
+
+    return actions;
+}
+
+static void
+stub_method_call(GDBusConnection       *connection G_GNUC_UNUSED,
+                 const gchar           *sender G_GNUC_UNUSED,
+                 const gchar           *object_path G_GNUC_UNUSED,
+                 const gchar           *interface_name G_GNUC_UNUSED,
+                 const gchar           *method_name,
+                 GVariant              *parameters,
+                 GDBusMethodInvocation *invocation,
+                 gpointer               user_data G_GNUC_UNUSED)
+{
+    GVariant *result = NULL;
+
+    if (g_strcmp0(method_name, "Inhibit") == 0)
+    {
+        guint flags;
+        g_variant_get(parameters, "(&su&su)", NULL, NULL, NULL, &flags);
+
+        guint cookie = ++stub.next_cookie;
+        g_hash_table_insert(stub.inhibitors, GUINT_TO_POINTER(cookie), GUINT_TO_POINTER(flags));
+        stub_emit("InhibitorAdded", cookie);
+        result = g_variant_new("(u)", cookie);
+    }
+    else if (g_strcmp0(method_name, "Uninhibit") == 0)
+    {
+        guint cookie;
+        g_variant_get(parameters, "(u)", &cookie);
+
+        if (g_hash_table_remove(stub.inhibitors, GUINT_TO_POINTER(cookie)))
+            stub_emit("InhibitorRemoved", cookie);
+    }
+    else if (g_strcmp0(method_name, "IsInhibited") == 0)
+    {
+        guint flags;
+        g_variant_get(parameters, "(u)", &flags);
+        result = g_variant_new("(b)", (stub_inhibited_actions() & flags) != 0);
+    }
+    else if (g_strcmp0(method_name, "RegisterClient") == 0)
+    {
+        gchar *path = g_strdup_printf("/org/gnome/SessionManager/Client%u", ++stub.next_client);
+        result = g_variant_new("(o)", path);
+        g_free(path);
+    }
+
+    StubReply *reply = g_new0(StubReply, 1);
+    reply->invocation = invocation;
+    reply->reply = result;
+
+    if (delay_ms > 0)
+    {
+        GSource *source = g_timeout_source_new(delay_ms);
+        g_source_set_callback(source, stub_reply_cb, reply, NULL);
+        g_source_attach(source, stub.context);
+        g_source_unref(source);
+    }
+    else
+    {
+        stub_reply_cb(reply);
+    }
+}
+
+static GVariant *
+stub_get_property(GDBusConnection  *connection G_GNUC_UNUSED,
+                  const gchar      *sender G_GNUC_UNUSED,
+                  const gchar      *object_path G_GNUC_UNUSED,
+                  const gchar      *interface_name G_GNUC_UNUSED,
+                  const gchar      *property_name G_GNUC_UNUSED,
+                  GError          **error G_GNUC_UNUSED,
+                  gpointer          user_data G_GNUC_UNUSED)
+{
+    return g_variant_new_uint32(stub_inhibited_actions());
+}
+
+static const GDBusInterfaceVTable stub_vtable = {
+    stub_method_call,
+    stub_get_property,
+    NULL,
+    { NULL }
+};
+
+static void
+stub_name_acquired_cb(GDBusConnection *connection G_GNUC_UNUSED,
+                      const gchar     *name G_GNUC_UNUSED,
+                      gpointer         user_data G_GNUC_UNUSED)
+{
+    g_mutex_lock(&stub.mutex);
+    stub.ready = TRUE;
+    g_cond_signal(&stub.cond);
+    g_mutex_unlock(&stub.mutex);
+}
+
+static gpointer
+stub_thread(gpointer user_data G_GNUC_UNUSED)
+{
+    GError *error = NULL;
+
+    g_main_context_push_thread_default(stub.context);
+
+    stub.connection = g_dbus_connection_new_for_address_sync(stub.address,
+                                                             G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                             G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                             NULL, NULL, &error);
+    if (stub.connection == NULL)
+        g_error("Failed to connect stub session manager: %s", error->message);
+
+    GDBusNodeInfo *info = g_dbus_node_info_new_for_xml(stub_xml, &error);
+    if (info == NULL)
+        g_error("Failed to parse stub interface: %s", error->message);
+
+    if (g_dbus_connection_register_object(stub.connection, SM_DBUS_PATH,
+                                          info->interfaces[0], &stub_vtable,
+                                          NULL, NULL, &error) == 0)
+        g_error("Failed to export stub session manager: %s", error->message);
+
+    g_dbus_node_info_unref(info);
+
+    g_bus_own_name_on_connection(stub.connection, SM_DBUS_NAME,
+                                 G_BUS_NAME_OWNER_FLAGS_NONE,
+                                 stub_name_acquired_cb, NULL, NULL, NULL);
+
+    for (;;)
+        g_main_context_iteration(stub.context, TRUE);
+
+    return NULL;
+}
+
+static void
+stub_start(const gchar *address)
+{
+    g_mutex_init(&stub.mutex);
+    g_cond_init(&stub.cond);
+    stub.address = address;
+    stub.context = g_main_context_new();
+    stub.inhibitors = g_hash_table_new(NULL, NULL);
+
+    g_thread_unref(g_thread_new("stub-session-manager", stub_thread, NULL));
+
+    g_mutex_lock(&stub.mutex);
+    while (!stub.ready)
+        g_cond_wait(&stub.cond, &stub.mutex);
+    g_mutex_unlock(&stub.mutex);
+}
+
+/* Measurements */
+typedef struct
+{
+    const gchar *name;
+    GArray      *samples;   /* gint64 microseconds */
+} Measurement;
+
+static Measurement *
+measurement_new(const gchar *name)
+{
+    Measurement *m = g_new0(Measurement, 1);
+    m->name = name;
+    m->samples = g_array_sized_new(FALSE, FALSE, sizeof(gint64), iterations);
+
+    return m;
+}
+
+static gint
+compare_samples(gconstpointer a,
+                gconstpointer b)
+{
+    gint64 x = *(const gint64 *)a;
+    gint64 y = *(const gint64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+static gint64
+measurement_percentile(Measurement *m,
+                       guint        percentile)
+{
+    if (m->samples->len == 0)
+        return 0;
+
+    guint index = (m->samples->len - 1) * percentile / 100;
+    return g_array_index(m->samples, gint64, index);
+}
+
+static void
+measurement_report(Measurement *m)
+{
+    g_array_sort(m->samples, compare_samples);
+
+    g_print("%-24s p50 %8.3f ms   p99 %8.3f ms   (%u calls)\n",
+            m->name,
+            measurement_percentile(m, 50) / 1000.0,
+            measurement_percentile(m, 99) / 1000.0,
+            m->samples->len);
+
+    g_array_unref(m->samples);
+    g_free(m);
+}
+
+#define MEASURE(m, call) \
+    G_STMT_START { \
+        gint64 start_ = g_get_monotonic_time(); \
+        call; \
+        gint64 stall_ = g_get_monotonic_time() - start_; \
+        g_array_append_val((m)->samples, stall_); \
+    } G_STMT_END
+
+/* Async completion tracking */
+static gboolean async_done;
+static gpointer async_result;
+
+static void
+inhibit_done_cb(GObject      *source G_GNUC_UNUSED,
+                GAsyncResult *result,
+                gpointer      user_data G_GNUC_UNUSED)
+{
+    async_result = mate_ui_session_inhibit_finish(result, NULL);
+    async_done = TRUE;
+}
+
+static void
+boolean_done_cb(GObject      *source G_GNUC_UNUSED,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+    gboolean (*finish)(GAsyncResult *, GError **) = user_data;
+
+    finish(result, NULL);
+    async_done = TRUE;
+}
+
+static void
+wait_async(void)
+{
+    while (!async_done)
+        g_main_context_iteration(NULL, TRUE);
+
+    async_done = FALSE;
+}
+
+static void
+bench_sync(GtkApplication *app)
+{
+    Measurement *inhibit = measurement_new("inhibit");
+    Measurement *uninhibit = measurement_new("uninhibit");
+    Measurement *is_inhibited = measurement_new("is_inhibited");
+    Measurement *reg = measurement_new("register");
+
+    for (gint i = 0; i < iterations; i++)
+    {
+        MateUiSessionInhibitor *inhibitor;
+
+        MEASURE(inhibit, inhibitor = mate_ui_session_inhibit(NULL, NULL, MATE_UI_INHIBIT_LOGOUT, "benchmark"));
+        MEASURE(uninhibit, mate_ui_session_uninhibit(inhibitor));
+        MEASURE(is_inhibited, mate_ui_session_is_inhibited(MATE_UI_INHIBIT_LOGOUT));
+        MEASURE(reg, mate_ui_session_register(app, NULL));
+    }
+
+    g_print("Synchronous calls:\n");
+    measurement_report(inhibit);
+    measurement_report(uninhibit);
+    measurement_report(is_inhibited);
+    measurement_report(reg);
+}
+
+static void
+bench_async(GtkApplication *app)
+{
+    Measurement *inhibit = measurement_new("inhibit_async");
+    Measurement *uninhibit = measurement_new("uninhibit_async");
+    Measurement *is_inhibited = measurement_new("is_inhibited_async");
+    Measurement *reg = measurement_new("register_async");
+
+    for (gint i = 0; i < iterations; i++)
+    {
+        MEASURE(inhibit, mate_ui_session_inhibit_async(NULL, NULL, MATE_UI_INHIBIT_LOGOUT, "benchmark",
+                                                       NULL, inhibit_done_cb, NULL));
+        wait_async();
+
+        if (async_result != NULL)
+        {
+            MEASURE(uninhibit, mate_ui_session_uninhibit_async(async_result, NULL, boolean_done_cb,
+                                                               mate_ui_session_uninhibit_finish));
+            wait_async();
+            async_result = NULL;
+        }
+
+        MEASURE(is_inhibited, mate_ui_session_is_inhibited_async(MATE_UI_INHIBIT_LOGOUT, NULL, boolean_done_cb,
+                                                                 mate_ui_session_is_inhibited_finish));
+        wait_async();
+
+        MEASURE(reg, mate_ui_session_register_async(app, NULL, NULL, boolean_done_cb,
+                                                    mate_ui_session_register_finish));
+        wait_async();
+    }
+
+    g_print("Asynchronous calls (time until the call returns):\n");
+    measurement_report(inhibit);
+    measurement_report(uninhibit);
+    measurement_report(is_inhibited);
+    measurement_report(reg);
+}
+
+/* Counts main loop iterations: check() runs once per wakeup */
+static guint wakeups;
+
+static gboolean
+wakeup_prepare(GSource *source G_GNUC_UNUSED,
+               gint    *timeout)
+{
+    *timeout = -1;
+    return FALSE;
+}
+
+static gboolean
+wakeup_check(GSource *source G_GNUC_UNUSED)
+{
+    wakeups++;
+    return FALSE;
+}
+
+static GSourceFuncs wakeup_funcs = {
+    wakeup_prepare,
+    wakeup_check,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+static gboolean
+quit_cb(gpointer user_data)
+{
+    g_main_loop_quit(user_data);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+idle_noop(gpointer user_data G_GNUC_UNUSED)
+{
+}
+
+static void
+idle_count(gpointer user_data)
+{
+    (*(guint *)user_data)++;
+}
+
+/* Runs the main loop for idle_seconds and returns its wakeups per minute */
+static gdouble
+count_wakeups(void)
+{
+    GSource *counter = g_source_new(&wakeup_funcs, sizeof(GSource));
+    g_source_attach(counter, NULL);
+
+    GMainLoop *loop = g_main_loop_new(NULL, FALSE);
+    g_timeout_add_seconds(idle_seconds, quit_cb, loop);
+
+    wakeups = 0;
+    g_main_loop_run(loop);
+
+    /* The quit timeout itself accounts for one wakeup */
+    guint idle_wakeups = wakeups > 0 ? wakeups - 1 : 0;
+
+    g_main_loop_unref(loop);
+    g_source_destroy(counter);
+    g_source_unref(counter);
+
+    return idle_wakeups * 60.0 / idle_seconds;
+}
+
+static void
+bench_idle(void)
+{
+    g_print("Idle wakeups (idle time %s):\n",
+            mate_ui_session_has_idle_time() ? "measured" : "unavailable");
+
+    /* Far enough away that it never fires while measuring */
+    guint watch_id = mate_ui_session_add_idle_watch(60 * 60 * 1000, idle_noop, idle_noop, NULL, NULL);
+    guint armed = mate_ui_session_get_idle_source_count();
+    gdouble rate = count_wakeups();
+    mate_ui_session_remove_idle_watch(watch_id);
+
+    g_print("%-24s %8.1f wakeups/min   (%u armed sources)\n", "idle watch", rate, armed);
+
+    /* A threshold of 0 keeps the callback ticking for the whole run */
+    guint calls = 0;
+    guint callback_id = mate_ui_session_set_idle_callback(0, G_CALLBACK(idle_count), &calls, NULL);
+    armed = mate_ui_session_get_idle_source_count();
+    rate = count_wakeups();
+    g_source_remove(callback_id);
+
+    g_print("%-24s %8.1f wakeups/min   (%u armed sources, %.1f calls/min)\n",
+            "idle callback", rate, armed, calls * 60.0 / idle_seconds);
+}
+
+static gboolean
+set_flag_cb(gpointer user_data)
+{
+    *(gboolean *)user_data = TRUE;
+    return G_SOURCE_REMOVE;
+}
+
+static void
+inhibited_changed_cb(MateUiSessionMonitor *monitor G_GNUC_UNUSED,
+                     guint                 flags G_GNUC_UNUSED,
+                     gpointer              user_data)
+{
+    *(gboolean *)user_data = TRUE;
+}
+
+int
+main(int    argc,
+     char **argv)
+{
+    GError *error = NULL;
+
+    GOptionContext *context = g_option_context_new("- benchmark libmateui session calls");
+    g_option_context_add_main_entries(context, options, NULL);
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        g_printerr("%s\n", error->message);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    if (iterations < 1 || delay_ms < 0 || idle_seconds < 1)
+    {
+        g_printerr("Invalid arguments\n");
+        return 1;
+    }
+
+    /* Must come before anything connects to the session bus */
+    GTestDBus *bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(bus);
+
+    stub_start(g_test_dbus_get_bus_address(bus));
+
+    /* A display is optional; without one idle time uses the fallback */
+    gtk_init_check(&argc, &argv);
+
+    GtkApplication *app = gtk_application_new("org.mate.UiSessionBench", G_APPLICATION_NON_UNIQUE);
+
+    /* Wait until the session manager is tracked, as after app startup */
+    gboolean tracked = FALSE;
+    MateUiSessionMonitor *monitor = mate_ui_session_monitor_get_default();
+    gulong handler = g_signal_connect(monitor, "inhibited-changed",
+                                      G_CALLBACK(inhibited_changed_cb), &tracked);
+    gboolean timed_out = FALSE;
+    guint timeout_id = g_timeout_add_seconds(5, set_flag_cb, &timed_out);
+
+    while (!tracked && !timed_out)
+        g_main_context_iteration(NULL, TRUE);
+
+    if (!timed_out)
+        g_source_remove(timeout_id);
+    g_signal_handler_disconnect(monitor, handler);
+
+    if (!tracked)
+        g_printerr("Warning: session manager was not tracked in time\n");
+
+    g_print("Stub reply delay: %d ms, %d iterations\n\n", delay_ms, iterations);
+
+    bench_sync(app);
+    g_print("\n");
+    bench_async(app);
+    g_print("\n");
+    bench_idle();
+
+    g_object_unref(app);
+    g_test_dbus_down(bus);
+    g_object_unref(bus);
+
+    return 0;
+}
@@ -7,6 +7,7 @@
  * - MateUiMenu for menubar construction
  * - MateUiDialogs for standard dialogs
  * - MateUiAccel for accelerator management
+ * - mateui-compile-ui for menu and accelerator tables built at compile time
  * - MateUiSession for session management
  * - MateUiSettings for preferences binding
  * - MateUiUtil for utility functions
@@ -25,56 +26,11 @@ static const gchar *authors[] = {
     NULL
 };
 
-/* Menu entries for File menu */
-static const MateUiMenuEntry file_menu_entries[] = {
-    { "_New",        "app.new",    "<Control>n", "document-new" },
-    { "_Open...",    "app.open",   "<Control>o", "document-open" },
-    { "_Save",       "win.save",   "<Control>s", "document-save" },
-    { "Save _As...", "win.save-as", "<Control><Shift>s", "document-save-as" },
-    MATE_UI_MENU_SEPARATOR,
-    { "_Quit",       "app.quit",   "<Control>q", "application-exit" },
-};
-
-/* Menu entries for Edit menu */
-static const MateUiMenuEntry edit_menu_entries[] = {
-    { "_Undo",       "win.undo",   "<Control>z", "edit-undo" },
-    { "_Redo",       "win.redo",   "<Control><Shift>z", "edit-redo" },
-    MATE_UI_MENU_SEPARATOR,
-    { "Cu_t",        "win.cut",    "<Control>x", "edit-cut" },
-    { "_Copy",       "win.copy",   "<Control>c", "edit-copy" },
-    { "_Paste",      "win.paste",  "<Control>v", "edit-paste" },
-    MATE_UI_MENU_SEPARATOR,
-    { "_Preferences", "app.preferences", "<Control>comma", "preferences-system" },
-};
-
-/* Menu entries for Help menu */
-static const MateUiMenuEntry help_menu_entries[] = {
-    { "_Contents",   "app.help",   "F1", "help-contents" },
-    MATE_UI_MENU_SEPARATOR,
-    { "_About",      "app.about",  NULL, "help-about" },
-};
-
-/* All submenus */
-static const MateUiSubmenu submenus[] = {
-    { "_File", file_menu_entries, G_N_ELEMENTS(file_menu_entries) },
-    { "_Edit", edit_menu_entries, G_N_ELEMENTS(edit_menu_entries) },
-    { "_Help", help_menu_entries, G_N_ELEMENTS(help_menu_entries) },
-};
-
-/* Accelerator entries */
-static const MateUiAccelEntry accel_entries[] = {
-    { "app.new",     "<Control>n" },
-    { "app.open",    "<Control>o" },
-    { "app.quit",    "<Control>q" },
-    { "app.help",    "F1" },
-    { "win.save",    "<Control>s" },
-    { "win.save-as", "<Control><Shift>s" },
-    { "win.undo",    "<Control>z" },
-    { "win.redo",    "<Control><Shift>z" },
-    { "win.cut",     "<Control>x" },
-    { "win.copy",    "<Control>c" },
-    { "win.paste",   "<Control>v" },
-};
+/*
+ * Menus and accelerators, compiled from demo-menus.ui.ini by
+ * mateui-compile-ui at build time: demo_menus, demo_accels
+ */
+#include "demo-menus.h"
 
 /* Forward declarations */
 static void startup_cb(GApplication *app, gpointer user_data);
@@ -298,9 +254,11 @@ startup_cb(GApplication *gapp,
                                      app);
 
     /* Set up accelerators - must be done after GTK init */
-    mate_ui_accel_set_app_accels(GTK_APPLICATION(app),
-                                  accel_entries,
-                                  G_N_ELEMENTS(accel_entries));
+    MateUiAccelMap *accel_map = mate_ui_accel_map_new();
+    mate_ui_accel_map_add_compiled(accel_map, &demo_accels);
+    mate_ui_accel_map_apply_to_app(accel_map, GTK_APPLICATION(app));
+    g_object_set_data_full(G_OBJECT(app), "demo-accel-map",
+                            accel_map, (GDestroyNotify) mate_ui_accel_map_free);
 }
 
 /* Create the main window */
@@ -325,9 +283,9 @@ activate_cb(GApplication *gapp,
     GtkAccelGroup *accel_group = mate_ui_accel_group_new();
     gtk_window_add_accel_group(GTK_WINDOW(window), accel_group);
 
-    GtkWidget *menubar = mate_ui_menu_bar_new_from_entries(submenus,
-                                                            G_N_ELEMENTS(submenus),
-                                                            accel_group);
+    GtkWidget *menubar = mate_ui_menu_bar_new_from_compiled(demo_menus,
+                                                             G_N_ELEMENTS(demo_menus),
+                                                             accel_group);
     mate_ui_window_set_menubar(MATE_UI_WINDOW(window), menubar);
 
     /* Create toolbar */
@@ -27,6 +27,7 @@
         glib
         xorg.libX11
         xorg.libXScrnSaver
+        xorg.libXext
         libSM
         libICE
       ];
@@ -53,6 +54,7 @@
         pkgs.glib
         pkgs.gtk3
         pkgs.xorg.libXScrnSaver
+        pkgs.xorg.libXext
       ];
       shellHook = ''
         echo "dev shell for libmateui: run 'meson setup build && meson compile -C build'"
@@ -11,237 +11,1955 @@
 
 #include "config.h"
 #include "mate-ui-accel.h"
+#include "mate-ui-private.h"
+
+#include <string.h>
+
+/*
+ * Accelerators are parsed once when they are added; the map keeps the
+ * parsed key and modifiers next to the interned action name so consumers
+ * never parse the string again.
+ */
+typedef struct
+{
+    const gchar     *action_name;   /* interned */
+    gchar           *accel;
+    guint            key;
+    GdkModifierType  mods;
+} AccelMapEntry;
+
+/*
+ * Applications the map has been applied to, each with the set of actions
+ * changed since its last apply, so a re-apply only touches those.
+ */
+typedef struct
+{
+    MateUiAccelMap *map;
+    GtkApplication *app;
+    GHashTable     *dirty;   /* interned action_name set */
+} AccelMapApp;
+
+/*
+ * Autosave state. It outlives the map while a write is in flight, so the
+ * write callback never touches a freed map.
+ */
+typedef struct
+{
+    MateUiAccelMap *map;          /* NULL once detached from the map */
+    GFile          *file;
+    guint           delay;
+    guint           timeout_id;
+    gboolean        dirty;
+    gboolean        writing;
+    GBytes         *content;      /* of the write in flight */
+    GCancellable   *cancellable;
+    GMutex          lock;
+    GCond           done;
+    gboolean        busy;         /* worker still writing; under lock */
+} AccelMapAutosave;
+
+/* Watched backing file; outlives the map while a reload is in flight */
+typedef struct
+{
+    MateUiAccelMap *map;          /* NULL once detached from the map */
+    GFile          *file;
+    gchar          *filename;
+    GFileMonitor   *monitor;
+    guint           reload_id;
+    gboolean        reloading;
+    gboolean        pending;      /* changed again during a reload */
+} AccelMapWatch;
 
 struct _MateUiAccelMap
 {
-    GHashTable *accels;  /* action_name -> accel string */
+    GHashTable       *accels;    /* interned action_name -> AccelMapEntry */
+    GSList           *apps;      /* AccelMapApp */
+    AccelMapAutosave *autosave;
+    AccelMapWatch    *watch;
+};
+
+static void accel_map_autosave_schedule(MateUiAccelMap *map);
+static void accel_map_autosave_detach(MateUiAccelMap *map);
+static void accel_map_watch_detach(MateUiAccelMap *map);
+
+G_DEFINE_QUARK(mate-ui-accel-error-quark, mate_ui_accel_error)
+
+/*
+ * Conflict index
+ *
+ * Every binding made through this module is recorded under its normalized
+ * key and modifiers, so finding the owners of an accelerator is a single
+ * hash lookup. Owners are identified by what they bind (an action in a
+ * map or application, a closure in an accel group, or a key router
+ * binding); bindings of the same action from several places, such as an
+ * accel map entry and a key router binding for "win.save", do not
+ * conflict with each other. Key router actions are named after where
+ * the window finds them.
+ */
+typedef struct
+{
+    MateUiAccelOwner      owner;
+    gconstpointer         tag;    /* closure for accel group bindings */
+    MateUiAccelConflict  *slot;
+} AccelIndexOwner;
+
+struct _MateUiAccelIndex
+{
+    GObject     parent_instance;
+
+    GHashTable *slots;       /* MateUiAccelConflict, keyed by itself */
+    GHashTable *owners;      /* AccelIndexOwner, keyed by itself */
+    GHashTable *conflicts;   /* set of conflicting MateUiAccelConflict */
+    GHashTable *apps;        /* set of watched GtkApplications */
+};
+
+G_DEFINE_TYPE(MateUiAccelIndex, mate_ui_accel_index, G_TYPE_OBJECT)
+
+enum
+{
+    SIGNAL_CONFLICT,
+    N_SIGNALS
 };
 
+static guint index_signals[N_SIGNALS];
+
+static MateUiAccelIndex *accel_index = NULL;
+
+static guint
+accel_index_slot_hash(gconstpointer data)
+{
+    const MateUiAccelConflict *slot = data;
+    return slot->key * 31 + slot->mods;
+}
+
+static gboolean
+accel_index_slot_equal(gconstpointer a,
+                       gconstpointer b)
+{
+    const MateUiAccelConflict *x = a;
+    const MateUiAccelConflict *y = b;
+    return x->key == y->key && x->mods == y->mods;
+}
+
+static void
+accel_index_slot_free(gpointer data)
+{
+    MateUiAccelConflict *slot = data;
+
+    g_ptr_array_unref(slot->owners);
+    g_free(slot);
+}
+
+static guint
+accel_index_owner_hash(gconstpointer data)
+{
+    const AccelIndexOwner *owner = data;
+    return g_direct_hash(owner->owner.instance) ^
+           g_direct_hash(owner->owner.action_name) ^
+           g_direct_hash(owner->tag);
+}
+
+static gboolean
+accel_index_owner_equal(gconstpointer a,
+                        gconstpointer b)
+{
+    const AccelIndexOwner *x = a;
+    const AccelIndexOwner *y = b;
+    return x->owner.instance == y->owner.instance &&
+           x->owner.action_name == y->owner.action_name &&
+           x->tag == y->tag;
+}
+
+/* What an owner binds; equal identities never conflict */
+static gconstpointer
+accel_index_owner_identity(const AccelIndexOwner *owner)
+{
+    return owner->owner.action_name ? (gconstpointer) owner->owner.action_name : owner->tag;
+}
+
+static gboolean
+accel_index_slot_conflicts(const MateUiAccelConflict *slot)
+{
+    if (slot->owners->len < 2)
+        return FALSE;
+
+    gconstpointer first = accel_index_owner_identity(g_ptr_array_index(slot->owners, 0));
+
+    for (guint i = 1; i < slot->owners->len; i++)
+    {
+        if (accel_index_owner_identity(g_ptr_array_index(slot->owners, i)) != first)
+            return TRUE;
+    }
+
+    return FALSE;
+}
+
+static void
+accel_index_normalize(guint           *key,
+                      GdkModifierType *mods)
+{
+    *key = gdk_keyval_to_lower(*key);
+    *mods &= gtk_accelerator_get_default_mod_mask();
+}
+
+static void
+mate_ui_accel_index_finalize(GObject *object)
+{
+    MateUiAccelIndex *index = MATE_UI_ACCEL_INDEX(object);
+
+    g_hash_table_unref(index->conflicts);
+    g_hash_table_unref(index->owners);
+    g_hash_table_unref(index->slots);
+    g_hash_table_unref(index->apps);
+
+    G_OBJECT_CLASS(mate_ui_accel_index_parent_class)->finalize(object);
+}
+
+static void
+mate_ui_accel_index_class_init(MateUiAccelIndexClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+    object_class->finalize = mate_ui_accel_index_finalize;
+
+    /**
+     * MateUiAccelIndex::conflict:
+     * @index: The #MateUiAccelIndex
+     * @key: The normalized key value
+     * @mods: The normalized #GdkModifierType
+     *
+     * Emitted when a binding is added for an accelerator that something
+     * else already binds.
+     */
+    index_signals[SIGNAL_CONFLICT] =
+        g_signal_new("conflict",
+                     G_TYPE_FROM_CLASS(klass),
+                     G_SIGNAL_RUN_LAST,
+                     0,
+                     NULL, NULL,
+                     NULL,
+                     G_TYPE_NONE, 2,
+                     G_TYPE_UINT,
+                     GDK_TYPE_MODIFIER_TYPE);
+}
+
+static void
+mate_ui_accel_index_init(MateUiAccelIndex *index)
+{
+    index->slots = g_hash_table_new_full(accel_index_slot_hash, accel_index_slot_equal,
+                                         NULL, accel_index_slot_free);
+    index->owners = g_hash_table_new_full(accel_index_owner_hash, accel_index_owner_equal,
+                                          g_free, NULL);
+    index->conflicts = g_hash_table_new(NULL, NULL);
+    index->apps = g_hash_table_new(NULL, NULL);
+}
+
+/**
+ * mate_ui_accel_index_get_default:
+ *
+ * Gets the index of every accelerator bound through libmateui.
+ *
+ * Returns: (transfer none): The default #MateUiAccelIndex
+ */
+MateUiAccelIndex *
+mate_ui_accel_index_get_default(void)
+{
+    if (accel_index == NULL)
+        accel_index = g_object_new(MATE_UI_TYPE_ACCEL_INDEX, NULL);
+
+    return accel_index;
+}
+
+static void
+accel_index_remove(gpointer       instance,
+                   const gchar   *action_name,
+                   gconstpointer  tag)
+{
+    if (accel_index == NULL)
+        return;
+
+    AccelIndexOwner lookup = { { 0, instance, action_name }, tag, NULL };
+    AccelIndexOwner *owner = g_hash_table_lookup(accel_index->owners, &lookup);
+    if (owner == NULL)
+        return;
+
+    MateUiAccelConflict *slot = owner->slot;
+
+    g_hash_table_steal(accel_index->owners, owner);
+    g_ptr_array_remove_fast(slot->owners, owner);
+    g_free(owner);
+
+    if (!accel_index_slot_conflicts(slot))
+        g_hash_table_remove(accel_index->conflicts, slot);
+
+    if (slot->owners->len == 0)
+        g_hash_table_remove(accel_index->slots, slot);
+}
+
+/* Records that @instance binds @key and @mods, replacing its previous binding */
+static void
+accel_index_add(MateUiAccelOwnerKind  kind,
+                gpointer              instance,
+                const gchar          *action_name,
+                gconstpointer         tag,
+                guint                 key,
+                GdkModifierType       mods)
+{
+    MateUiAccelIndex *index = mate_ui_accel_index_get_default();
+
+    accel_index_remove(instance, action_name, tag);
+    accel_index_normalize(&key, &mods);
+
+    MateUiAccelConflict lookup = { key, mods, NULL };
+    MateUiAccelConflict *slot = g_hash_table_lookup(index->slots, &lookup);
+
+    if (slot == NULL)
+    {
+        slot = g_new0(MateUiAccelConflict, 1);
+        slot->key = key;
+        slot->mods = mods;
+        slot->owners = g_ptr_array_new();
+        g_hash_table_add(index->slots, slot);
+    }
+
+    AccelIndexOwner *owner = g_new0(AccelIndexOwner, 1);
+    owner->owner.kind = kind;
+    owner->owner.instance = instance;
+    owner->owner.action_name = action_name;
+    owner->tag = tag;
+    owner->slot = slot;
+
+    g_ptr_array_add(slot->owners, owner);
+    g_hash_table_add(index->owners, owner);
+
+    /* A conflict is new if nothing already there binds the same thing */
+    gboolean is_new = slot->owners->len > 1;
+    for (guint i = 0; is_new && i + 1 < slot->owners->len; i++)
+    {
+        if (accel_index_owner_identity(g_ptr_array_index(slot->owners, i)) ==
+            accel_index_owner_identity(owner))
+            is_new = FALSE;
+    }
+
+    if (is_new)
+    {
+        g_hash_table_add(index->conflicts, slot);
+        g_signal_emit(index, index_signals[SIGNAL_CONFLICT], 0, key, mods);
+    }
+}
+
+/* Drops every binding owned by @instance */
+static void
+accel_index_remove_instance(gpointer instance)
+{
+    if (accel_index == NULL)
+        return;
+
+    GHashTableIter iter;
+    gpointer key;
+    GSList *stale = NULL;
+
+    g_hash_table_iter_init(&iter, accel_index->owners);
+    while (g_hash_table_iter_next(&iter, &key, NULL))
+    {
+        AccelIndexOwner *owner = key;
+        if (owner->owner.instance == instance)
+            stale = g_slist_prepend(stale, owner);
+    }
+
+    for (GSList *l = stale; l != NULL; l = l->next)
+    {
+        AccelIndexOwner *owner = l->data;
+        accel_index_remove(owner->owner.instance, owner->owner.action_name, owner->tag);
+    }
+
+    g_slist_free(stale);
+}
+
+static void
+accel_index_app_finalized(gpointer  data G_GNUC_UNUSED,
+                          GObject  *where_the_object_was)
+{
+    if (accel_index == NULL)
+        return;
+
+    g_hash_table_remove(accel_index->apps, where_the_object_was);
+    accel_index_remove_instance(where_the_object_was);
+}
+
+static void
+accel_index_add_app(GtkApplication *app,
+                    const gchar    *action_name,
+                    const gchar    *accel)
+{
+    MateUiAccelIndex *index = mate_ui_accel_index_get_default();
+    const gchar *interned = g_intern_string(action_name);
+    guint key;
+    GdkModifierType mods;
+
+    if (accel == NULL || !mate_ui_accel_parse(accel, &key, &mods))
+    {
+        accel_index_remove(app, interned, NULL);
+        return;
+    }
+
+    if (!g_hash_table_contains(index->apps, app))
+    {
+        g_hash_table_add(index->apps, app);
+        g_object_weak_ref(G_OBJECT(app), accel_index_app_finalized, NULL);
+    }
+
+    accel_index_add(MATE_UI_ACCEL_OWNER_APP, app, interned, NULL, key, mods);
+}
+
+/**
+ * mate_ui_accel_index_lookup:
+ * @index: A #MateUiAccelIndex
+ * @key: The key value
+ * @mods: The modifier mask
+ *
+ * Gets everything that binds an accelerator. @key and @mods are
+ * normalized first, so "<Control>S" and "<Primary>s" are the same.
+ *
+ * Returns: (transfer none) (nullable) (element-type MateUiAccelOwner):
+ *   The owners, or %NULL if the accelerator is unbound. The array is
+ *   only valid until bindings change.
+ */
+GPtrArray *
+mate_ui_accel_index_lookup(MateUiAccelIndex *index,
+                            guint             key,
+                            GdkModifierType   mods)
+{
+    g_return_val_if_fail(MATE_UI_IS_ACCEL_INDEX(index), NULL);
+
+    accel_index_normalize(&key, &mods);
+
+    MateUiAccelConflict lookup = { key, mods, NULL };
+    MateUiAccelConflict *slot = g_hash_table_lookup(index->slots, &lookup);
+
+    return slot ? slot->owners : NULL;
+}
+
+/**
+ * mate_ui_accel_index_has_conflict:
+ * @index: A #MateUiAccelIndex
+ * @key: The key value
+ * @mods: The modifier mask
+ *
+ * Checks whether more than one action or callback binds an accelerator.
+ *
+ * Returns: %TRUE if the accelerator is in conflict
+ */
+gboolean
+mate_ui_accel_index_has_conflict(MateUiAccelIndex *index,
+                                  guint             key,
+                                  GdkModifierType   mods)
+{
+    g_return_val_if_fail(MATE_UI_IS_ACCEL_INDEX(index), FALSE);
+
+    accel_index_normalize(&key, &mods);
+
+    MateUiAccelConflict lookup = { key, mods, NULL };
+    MateUiAccelConflict *slot = g_hash_table_lookup(index->slots, &lookup);
+
+    return slot != NULL && g_hash_table_contains(index->conflicts, slot);
+}
+
+/**
+ * mate_ui_accel_index_list_conflicts:
+ * @index: A #MateUiAccelIndex
+ *
+ * Lists every accelerator that is currently in conflict. Conflicts are
+ * tracked as bindings change, so this does not scan the bindings.
+ *
+ * Returns: (transfer container) (element-type MateUiAccelConflict): The
+ *   conflicts. They are only valid until bindings change.
+ */
+GPtrArray *
+mate_ui_accel_index_list_conflicts(MateUiAccelIndex *index)
+{
+    g_return_val_if_fail(MATE_UI_IS_ACCEL_INDEX(index), NULL);
+
+    GPtrArray *conflicts = g_ptr_array_sized_new(g_hash_table_size(index->conflicts));
+    GHashTableIter iter;
+    gpointer key;
+
+    g_hash_table_iter_init(&iter, index->conflicts);
+    while (g_hash_table_iter_next(&iter, &key, NULL))
+        g_ptr_array_add(conflicts, key);
+
+    return conflicts;
+}
+
+static AccelMapEntry *
+accel_map_entry_new(const gchar     *action_name,
+                    const gchar     *accel,
+                    guint            key,
+                    GdkModifierType  mods)
+{
+    AccelMapEntry *entry = g_new0(AccelMapEntry, 1);
+    entry->action_name = g_intern_string(action_name);
+    entry->accel = g_strdup(accel);
+    entry->key = key;
+    entry->mods = mods;
+
+    return entry;
+}
+
+static void
+accel_map_entry_free(gpointer data)
+{
+    AccelMapEntry *entry = data;
+
+    g_free(entry->accel);
+    g_free(entry);
+}
+
+static void
+accel_map_app_free(AccelMapApp *state)
+{
+    g_hash_table_unref(state->dirty);
+    g_free(state);
+}
+
+static void
+accel_map_app_finalized(gpointer  data,
+                        GObject  *where_the_object_was G_GNUC_UNUSED)
+{
+    AccelMapApp *state = data;
+
+    state->map->apps = g_slist_remove(state->map->apps, state);
+    accel_map_app_free(state);
+}
+
+static AccelMapApp *
+accel_map_find_app(MateUiAccelMap *map,
+                   GtkApplication *app)
+{
+    for (GSList *l = map->apps; l != NULL; l = l->next)
+    {
+        AccelMapApp *state = l->data;
+        if (state->app == app)
+            return state;
+    }
+
+    return NULL;
+}
+
+static void
+accel_map_mark_dirty(MateUiAccelMap *map,
+                     const gchar    *action_name)
+{
+    for (GSList *l = map->apps; l != NULL; l = l->next)
+    {
+        AccelMapApp *state = l->data;
+        g_hash_table_add(state->dirty, (gpointer) action_name);
+    }
+}
+
+/*
+ * Stores @entry, taking ownership; unchanged bindings are not marked
+ * dirty. Returns whether the accelerator text changed, so callers that
+ * store many entries can schedule a single autosave.
+ */
+static gboolean
+accel_map_store_entry(MateUiAccelMap *map,
+                      AccelMapEntry  *entry)
+{
+    AccelMapEntry *old = g_hash_table_lookup(map->accels, entry->action_name);
+
+    if (old == NULL || old->key != entry->key || old->mods != entry->mods)
+        accel_map_mark_dirty(map, entry->action_name);
+
+    gboolean changed = old == NULL || strcmp(old->accel, entry->accel) != 0;
+
+    accel_index_add(MATE_UI_ACCEL_OWNER_MAP, map, entry->action_name, NULL,
+                    entry->key, entry->mods);
+    g_hash_table_replace(map->accels, (gpointer) entry->action_name, entry);
+
+    return changed;
+}
+
+static void
+accel_map_set_entry(MateUiAccelMap *map,
+                    AccelMapEntry  *entry)
+{
+    if (accel_map_store_entry(map, entry))
+        accel_map_autosave_schedule(map);
+}
+
+static void
+accel_map_remove_entry(MateUiAccelMap *map,
+                       const gchar    *action_name)
+{
+    AccelMapEntry *entry = g_hash_table_lookup(map->accels, action_name);
+    if (entry == NULL)
+        return;
+
+    accel_map_mark_dirty(map, entry->action_name);
+    accel_map_autosave_schedule(map);
+    accel_index_remove(map, entry->action_name, NULL);
+    g_hash_table_remove(map->accels, action_name);
+}
+
+/**
+ * mate_ui_accel_map_new:
+ *
+ * Creates a new accelerator map.
+ *
+ * Returns: (transfer full): A new #MateUiAccelMap
+ */
+MateUiAccelMap *
+mate_ui_accel_map_new(void)
+{
+    MateUiAccelMap *map = g_new0(MateUiAccelMap, 1);
+    map->accels = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, accel_map_entry_free);
+    return map;
+}
+
+/**
+ * mate_ui_accel_map_free:
+ * @map: A #MateUiAccelMap
+ *
+ * Frees an accelerator map. Pending autosave changes are dropped; call
+ * mate_ui_accel_map_flush() first to keep them.
+ */
+void
+mate_ui_accel_map_free(MateUiAccelMap *map)
+{
+    if (map == NULL)
+        return;
+
+    for (GSList *l = map->apps; l != NULL; l = l->next)
+    {
+        AccelMapApp *state = l->data;
+
+        g_object_weak_unref(G_OBJECT(state->app), accel_map_app_finalized, state);
+        accel_map_app_free(state);
+    }
+    g_slist_free(map->apps);
+
+    accel_map_watch_detach(map);
+    accel_map_autosave_detach(map);
+    accel_index_remove_instance(map);
+    g_hash_table_unref(map->accels);
+    g_free(map);
+}
+
+/**
+ * mate_ui_accel_map_try_add:
+ * @map: A #MateUiAccelMap
+ * @action_name: The action name
+ * @accel: The accelerator string
+ * @error: Return location for error
+ *
+ * Adds an accelerator to the map, replacing any previous one for
+ * @action_name. The accelerator is parsed here, so an invalid one is
+ * reported now instead of being skipped when the map is used.
+ *
+ * Returns: %TRUE if the accelerator was valid and added
+ */
+gboolean
+mate_ui_accel_map_try_add(MateUiAccelMap  *map,
+                           const gchar     *action_name,
+                           const gchar     *accel,
+                           GError         **error)
+{
+    g_return_val_if_fail(map != NULL, FALSE);
+    g_return_val_if_fail(action_name != NULL, FALSE);
+    g_return_val_if_fail(accel != NULL, FALSE);
+
+    guint key;
+    GdkModifierType mods;
+
+    if (!mate_ui_accel_parse(accel, &key, &mods))
+    {
+        g_set_error(error, MATE_UI_ACCEL_ERROR, MATE_UI_ACCEL_ERROR_INVALID,
+                    "Invalid accelerator \"%s\" for action \"%s\"", accel, action_name);
+        return FALSE;
+    }
+
+    accel_map_set_entry(map, accel_map_entry_new(action_name, accel, key, mods));
+
+    return TRUE;
+}
+
+/**
+ * mate_ui_accel_map_add:
+ * @map: A #MateUiAccelMap
+ * @action_name: The action name
+ * @accel: The accelerator string
+ *
+ * Adds an accelerator to the map. Invalid accelerators are rejected with
+ * a warning; use mate_ui_accel_map_try_add() to handle them yourself.
+ */
+void
+mate_ui_accel_map_add(MateUiAccelMap *map,
+                       const gchar    *action_name,
+                       const gchar    *accel)
+{
+    g_return_if_fail(map != NULL);
+    g_return_if_fail(action_name != NULL);
+    g_return_if_fail(accel != NULL);
+
+    GError *error = NULL;
+    if (!mate_ui_accel_map_try_add(map, action_name, accel, &error))
+    {
+        g_warning("%s", error->message);
+        g_error_free(error);
+    }
+}
+
+/**
+ * mate_ui_accel_map_add_entries:
+ * @map: A #MateUiAccelMap
+ * @entries: Array of #MateUiAccelEntry structures
+ * @n_entries: Number of entries
+ *
+ * Adds multiple accelerators to the map.
+ */
+void
+mate_ui_accel_map_add_entries(MateUiAccelMap         *map,
+                               const MateUiAccelEntry *entries,
+                               gsize                   n_entries)
+{
+    g_return_if_fail(map != NULL);
+    g_return_if_fail(entries != NULL || n_entries == 0);
+
+    for (gsize i = 0; i < n_entries; i++)
+    {
+        mate_ui_accel_map_add(map, entries[i].action_name, entries[i].accel);
+    }
+}
+
+/**
+ * mate_ui_accel_map_add_compiled:
+ * @map: A #MateUiAccelMap
+ * @table: A #MateUiCompiledAccelTable
+ *
+ * Adds the accelerators of a table generated by mateui-compile-ui to the
+ * map. They were parsed and checked at build time, so nothing is parsed
+ * here.
+ */
+void
+mate_ui_accel_map_add_compiled(MateUiAccelMap                 *map,
+                                const MateUiCompiledAccelTable *table)
+{
+    g_return_if_fail(map != NULL);
+    g_return_if_fail(table != NULL);
+
+    for (gsize i = 0; i < table->n_entries; i++)
+    {
+        const MateUiCompiledAccel *accel = &table->entries[i];
+
+        accel_map_set_entry(map, accel_map_entry_new(accel->action_name, accel->accel,
+                                                     accel->key, accel->mods));
+    }
+}
+
+/**
+ * mate_ui_compiled_accel_table_lookup:
+ * @table: A #MateUiCompiledAccelTable
+ * @action_name: The action name
+ *
+ * Finds the accelerator of an action in a table generated by
+ * mateui-compile-ui. The table is indexed by a perfect hash, so this
+ * takes two hashes and one string comparison.
+ *
+ * Returns: (transfer none) (nullable): The accelerator, or %NULL
+ */
+const MateUiCompiledAccel *
+mate_ui_compiled_accel_table_lookup(const MateUiCompiledAccelTable *table,
+                                     const gchar                    *action_name)
+{
+    g_return_val_if_fail(table != NULL, NULL);
+    g_return_val_if_fail(action_name != NULL, NULL);
+
+    if (table->n_entries == 0 || table->n_seeds == 0)
+        return NULL;
+
+    guint32 bucket = _mate_ui_compiled_hash(action_name, 0) % table->n_seeds;
+    guint32 slot = _mate_ui_compiled_hash(action_name, table->seeds[bucket]) % table->n_entries;
+    const MateUiCompiledAccel *accel = &table->entries[slot];
+
+    return strcmp(accel->action_name, action_name) == 0 ? accel : NULL;
+}
+
+/**
+ * mate_ui_accel_map_remove:
+ * @map: A #MateUiAccelMap
+ * @action_name: The action name to remove
+ *
+ * Removes an accelerator from the map.
+ */
+void
+mate_ui_accel_map_remove(MateUiAccelMap *map,
+                          const gchar    *action_name)
+{
+    g_return_if_fail(map != NULL);
+    g_return_if_fail(action_name != NULL);
+
+    accel_map_remove_entry(map, action_name);
+}
+
+/**
+ * mate_ui_accel_map_get:
+ * @map: A #MateUiAccelMap
+ * @action_name: The action name
+ *
+ * Gets the accelerator for an action.
+ *
+ * Returns: (transfer none) (nullable): The accelerator string or %NULL
+ */
+const gchar *
+mate_ui_accel_map_get(MateUiAccelMap *map,
+                       const gchar    *action_name)
+{
+    g_return_val_if_fail(map != NULL, NULL);
+    g_return_val_if_fail(action_name != NULL, NULL);
+
+    AccelMapEntry *entry = g_hash_table_lookup(map->accels, action_name);
+    return entry ? entry->accel : NULL;
+}
+
+/**
+ * mate_ui_accel_map_lookup:
+ * @map: A #MateUiAccelMap
+ * @action_name: The action name
+ * @key: (out) (optional): Return location for the key
+ * @mods: (out) (optional): Return location for the modifiers
+ *
+ * Gets the parsed accelerator for an action, without parsing it again.
+ *
+ * Returns: %TRUE if @action_name has an accelerator
+ */
+gboolean
+mate_ui_accel_map_lookup(MateUiAccelMap  *map,
+                          const gchar     *action_name,
+                          guint           *key,
+                          GdkModifierType *mods)
+{
+    g_return_val_if_fail(map != NULL, FALSE);
+    g_return_val_if_fail(action_name != NULL, FALSE);
+
+    AccelMapEntry *entry = g_hash_table_lookup(map->accels, action_name);
+    if (entry == NULL)
+        return FALSE;
+
+    if (key != NULL)
+        *key = entry->key;
+    if (mods != NULL)
+        *mods = entry->mods;
+
+    return TRUE;
+}
+
+static void
+accel_map_apply_action(MateUiAccelMap *map,
+                       GtkApplication *app,
+                       const gchar    *action_name)
+{
+    AccelMapEntry *entry = g_hash_table_lookup(map->accels, action_name);
+    const gchar *accels[] = { entry ? entry->accel : NULL, NULL };
+
+    gtk_application_set_accels_for_action(app, action_name, accels);
+}
+
+/**
+ * mate_ui_accel_map_apply_to_app:
+ * @map: A #MateUiAccelMap
+ * @app: A #GtkApplication
+ *
+ * Applies the accelerator map to an application. The first call sets
+ * every accelerator; later calls for the same @app only update actions
+ * added, changed or removed since, and clear the accelerators of
+ * removed actions.
+ */
+void
+mate_ui_accel_map_apply_to_app(MateUiAccelMap *map,
+                                GtkApplication *app)
+{
+    g_return_if_fail(map != NULL);
+    g_return_if_fail(GTK_IS_APPLICATION(app));
+
+    AccelMapApp *state = accel_map_find_app(map, app);
+    GHashTableIter iter;
+    gpointer key;
+
+    if (state == NULL)
+    {
+        state = g_new0(AccelMapApp, 1);
+        state->map = map;
+        state->app = app;
+        state->dirty = g_hash_table_new(g_str_hash, g_str_equal);
+
+        g_object_weak_ref(G_OBJECT(app), accel_map_app_finalized, state);
+        map->apps = g_slist_prepend(map->apps, state);
+
+        g_hash_table_iter_init(&iter, map->accels);
+        while (g_hash_table_iter_next(&iter, &key, NULL))
+            accel_map_apply_action(map, app, key);
+
+        return;
+    }
+
+    g_hash_table_iter_init(&iter, state->dirty);
+    while (g_hash_table_iter_next(&iter, &key, NULL))
+        accel_map_apply_action(map, app, key);
+
+    g_hash_table_remove_all(state->dirty);
+}
+
+/*
+ * Accelerator file parser
+ *
+ * Scans the file in place in a single pass. Each line is
+ * "action_name=accelerator"; blank lines are skipped, an unescaped '#'
+ * starts a comment, and a backslash makes the next character literal,
+ * so '=', '#' and '\\' can appear in action names. Fields are unescaped
+ * into two reused buffers, so only the parsed entries are allocated.
+ *
+ * Malformed lines and invalid accelerators are skipped with a warning,
+ * so one bad line does not lose the rest of a user's bindings.
+ *
+ * Accelerators are resolved to key and modifiers as they are read, so
+ * the parser can run on a worker thread. Only <Primary> needs the
+ * display's keymap, so what it stands for is looked up on the main
+ * thread beforehand and handed to the parser.
+ */
+typedef struct
+{
+    const gchar     *filename;
+    GdkModifierType  primary;
+    guint            line;
+    GString         *action;
+    GString         *accel;
+    GString         *scratch;
+    GHashTable      *accels;   /* interned action_name -> AccelMapEntry */
+} AccelParser;
+
+/* What <Primary> stands for; must be called on the main thread */
+static GdkModifierType
+accel_primary_mod(void)
+{
+    guint key;
+    GdkModifierType mods;
+
+    gtk_accelerator_parse("<Primary>a", &key, &mods);
+
+    return mods;
+}
+
+/*
+ * Parses @accel like mate_ui_accel_parse(), with <Primary> mapped to
+ * @primary. Everything else GTK parses is plain string work, so this is
+ * safe on any thread. @scratch is reused between calls.
+ */
+static gboolean
+accel_parse_with_primary(const gchar     *accel,
+                         GdkModifierType  primary,
+                         GString         *scratch,
+                         guint           *key,
+                         GdkModifierType *mods)
+{
+    gboolean has_primary = FALSE;
+
+    g_string_truncate(scratch, 0);
+
+    for (const gchar *p = accel; *p != '\0'; )
+    {
+        if (g_ascii_strncasecmp(p, "<Primary>", 9) == 0)
+        {
+            has_primary = TRUE;
+            p += 9;
+        }
+        else
+        {
+            g_string_append_c(scratch, *p++);
+        }
+    }
+
+    gtk_accelerator_parse(scratch->str, key, mods);
+    if (*key == 0)
+        return FALSE;
+
+    if (has_primary)
+        *mods |= primary;
+
+    return TRUE;
+}
+
+static gboolean
+accel_parser_error(AccelParser  *parser,
+                   gint          code,
+                   GError      **error,
+                   const gchar  *message)
+{
+    gchar *display_name = g_filename_display_name(parser->filename);
+
+    g_set_error(error, MATE_UI_ACCEL_ERROR, code,
+                "%s:%u: %s", display_name, parser->line, message);
+    g_free(display_name);
+
+    return FALSE;
+}
+
+static gboolean
+accel_parser_line(AccelParser  *parser,
+                  const gchar  *start,
+                  const gchar  *end,
+                  GError      **error)
+{
+    GString *field = parser->action;
+    gsize action_len = 0;
+    gsize accel_len = 0;
+    gsize *field_len = &action_len;
+    gboolean seen_equals = FALSE;
+
+    g_string_truncate(parser->action, 0);
+    g_string_truncate(parser->accel, 0);
+
+    for (const gchar *p = start; p < end; p++)
+    {
+        gchar c = *p;
+        gboolean escaped = FALSE;
+
+        if (c == '#')
+            break;
+
+        if (c == '=' && !seen_equals)
+        {
+            seen_equals = TRUE;
+            field = parser->accel;
+            field_len = &accel_len;
+            continue;
+        }
+
+        if (c == '\\')
+        {
+            if (p + 1 == end || p[1] == '\r')
+                return accel_parser_error(parser, MATE_UI_ACCEL_ERROR_PARSE, error,
+                                          "Backslash at end of line");
+            c = *++p;
+            escaped = TRUE;
+        }
+
+        if (!escaped && g_ascii_isspace(c))
+        {
+            /* Leading whitespace is dropped, trailing is trimmed below */
+            if (field->len > 0)
+                g_string_append_c(field, c);
+            continue;
+        }
+
+        g_string_append_c(field, c);
+        *field_len = field->len;
+    }
+
+    g_string_truncate(parser->action, action_len);
+    g_string_truncate(parser->accel, accel_len);
+
+    if (!seen_equals)
+    {
+        if (parser->action->len == 0)
+            return TRUE;
+
+        return accel_parser_error(parser, MATE_UI_ACCEL_ERROR_PARSE, error,
+                                  "Expected '=' after the action name");
+    }
+
+    if (parser->action->len == 0)
+        return accel_parser_error(parser, MATE_UI_ACCEL_ERROR_PARSE, error,
+                                  "Missing action name");
+
+    if (parser->accel->len == 0)
+        return accel_parser_error(parser, MATE_UI_ACCEL_ERROR_PARSE, error,
+                                  "Missing accelerator");
+
+    guint key;
+    GdkModifierType mods;
+
+    if (!accel_parse_with_primary(parser->accel->str, parser->primary, parser->scratch,
+                                  &key, &mods))
+    {
+        gchar *message = g_strdup_printf("Invalid accelerator \"%s\" for %s",
+                                         parser->accel->str, parser->action->str);
+        accel_parser_error(parser, MATE_UI_ACCEL_ERROR_INVALID, error, message);
+        g_free(message);
+        return FALSE;
+    }
+
+    /* A later line for the same action wins, as it would when added in turn */
+    AccelMapEntry *entry = accel_map_entry_new(parser->action->str, parser->accel->str,
+                                               key, mods);
+    g_hash_table_replace(parser->accels, (gpointer) entry->action_name, entry);
+
+    return TRUE;
+}
+
+/*
+ * Parses @length bytes at @data into a new table of entries, skipping
+ * malformed lines. <Primary> stands for @primary.
+ *
+ * Returns: (transfer full): the entries, keyed like the map's table
+ */
+static GHashTable *
+accel_map_parse(const gchar     *data,
+                gsize            length,
+                const gchar     *filename,
+                GdkModifierType  primary)
+{
+    AccelParser parser;
+    parser.filename = filename;
+    parser.primary = primary;
+    parser.line = 0;
+    parser.action = g_string_sized_new(64);
+    parser.accel = g_string_sized_new(32);
+    parser.scratch = g_string_sized_new(32);
+    parser.accels = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, accel_map_entry_free);
+
+    const gchar *p = data;
+    const gchar *end = data + length;
+
+    while (p < end)
+    {
+        const gchar *eol = memchr(p, '\n', end - p);
+        if (eol == NULL)
+            eol = end;
+
+        /* Tolerate CRLF line endings */
+        const gchar *line_end = eol;
+        if (line_end > p && line_end[-1] == '\r')
+            line_end--;
+
+        GError *error = NULL;
+
+        parser.line++;
+        if (!accel_parser_line(&parser, p, line_end, &error))
+        {
+            g_warning("Ignoring accelerator line: %s", error->message);
+            g_error_free(error);
+        }
+        p = eol + 1;
+    }
+
+    g_string_free(parser.action, TRUE);
+    g_string_free(parser.accel, TRUE);
+    g_string_free(parser.scratch, TRUE);
+
+    return parser.accels;
+}
+
+/* A file to read, with what <Primary> stands for */
+typedef struct
+{
+    gchar           *filename;
+    GdkModifierType  primary;
+} AccelMapRead;
+
+/* Must be called on the main thread */
+static AccelMapRead *
+accel_map_read_new(const gchar *filename)
+{
+    AccelMapRead *spec = g_new0(AccelMapRead, 1);
+    spec->filename = g_strdup(filename);
+    spec->primary = accel_primary_mod();
+
+    return spec;
+}
+
+static void
+accel_map_read_free(gpointer data)
+{
+    AccelMapRead *spec = data;
+
+    g_free(spec->filename);
+    g_free(spec);
+}
+
+/* Reads and parses a file; safe to call from any thread */
+static GHashTable *
+accel_map_read(AccelMapRead  *spec,
+               GError       **error)
+{
+    GMappedFile *file = g_mapped_file_new(spec->filename, FALSE, error);
+    if (file == NULL)
+        return NULL;
+
+    const gchar *data = g_mapped_file_get_contents(file);
+    gsize length = g_mapped_file_get_length(file);
+
+    GHashTable *accels = accel_map_parse(data ? data : "", length,
+                                         spec->filename, spec->primary);
+    g_mapped_file_unref(file);
+
+    return accels;
+}
+
+/*
+ * Moves every parsed entry into @map in one step, taking ownership of
+ * @accels. Loading into an empty map, the usual case, swaps the tables;
+ * otherwise the entries are moved over. Either way only the conflict
+ * index and the dirty sets are updated per entry, and the autosave is
+ * scheduled once.
+ */
+static void
+accel_map_commit(MateUiAccelMap *map,
+                 GHashTable     *accels)
+{
+    GHashTableIter iter;
+    gpointer value;
+    gboolean changed = FALSE;
+
+    if (g_hash_table_size(map->accels) == 0)
+    {
+        GHashTable *empty = map->accels;
+        map->accels = accels;
+        accels = empty;
+
+        g_hash_table_iter_init(&iter, map->accels);
+        while (g_hash_table_iter_next(&iter, NULL, &value))
+        {
+            AccelMapEntry *entry = value;
+
+            accel_map_mark_dirty(map, entry->action_name);
+            accel_index_add(MATE_UI_ACCEL_OWNER_MAP, map, entry->action_name, NULL,
+                            entry->key, entry->mods);
+            changed = TRUE;
+        }
+    }
+    else
+    {
+        g_hash_table_iter_init(&iter, accels);
+        while (g_hash_table_iter_next(&iter, NULL, &value))
+        {
+            g_hash_table_iter_steal(&iter);
+            if (accel_map_store_entry(map, value))
+                changed = TRUE;
+        }
+    }
+
+    g_hash_table_unref(accels);
+
+    if (changed)
+        accel_map_autosave_schedule(map);
+}
+
+/**
+ * mate_ui_accel_map_load:
+ * @map: A #MateUiAccelMap
+ * @filename: Path to the accelerator file
+ * @error: Return location for error
+ *
+ * Loads accelerators from a file. File format is one entry per line:
+ * action_name=<accelerator>. Blank lines are ignored, '#' starts a
+ * comment, and a backslash makes the next character literal.
+ *
+ * Malformed lines and invalid accelerators are skipped with a warning.
+ *
+ * Returns: %TRUE on success, %FALSE if the file could not be read
+ */
+gboolean
+mate_ui_accel_map_load(MateUiAccelMap  *map,
+                        const gchar     *filename,
+                        GError         **error)
+{
+    g_return_val_if_fail(map != NULL, FALSE);
+    g_return_val_if_fail(filename != NULL, FALSE);
+
+    AccelMapRead *spec = accel_map_read_new(filename);
+    GHashTable *accels = accel_map_read(spec, error);
+    accel_map_read_free(spec);
+
+    if (accels == NULL)
+        return FALSE;
+
+    accel_map_commit(map, accels);
+
+    return TRUE;
+}
+
+static void
+accel_map_load_thread(GTask        *task,
+                      gpointer      source_object G_GNUC_UNUSED,
+                      gpointer      task_data,
+                      GCancellable *cancellable G_GNUC_UNUSED)
+{
+    GError *error = NULL;
+
+    GHashTable *accels = accel_map_read(task_data, &error);
+    if (accels != NULL)
+        g_task_return_pointer(task, accels, (GDestroyNotify) g_hash_table_unref);
+    else
+        g_task_return_error(task, error);
+}
+
+static void
+accel_map_load_cb(GObject      *source G_GNUC_UNUSED,
+                  GAsyncResult *result,
+                  gpointer      user_data)
+{
+    GTask *task = user_data;
+    MateUiAccelMap *map = g_task_get_task_data(task);
+    GError *error = NULL;
+
+    GHashTable *accels = g_task_propagate_pointer(G_TASK(result), &error);
+    if (accels == NULL)
+    {
+        g_task_return_error(task, error);
+        g_object_unref(task);
+        return;
+    }
+
+    if (!g_task_return_error_if_cancelled(task))
+    {
+        accel_map_commit(map, accels);
+        g_task_return_boolean(task, TRUE);
+    }
+    else
+    {
+        g_hash_table_unref(accels);
+    }
+
+    g_object_unref(task);
+}
+
 /**
- * mate_ui_accel_map_new:
- *
- * Creates a new accelerator map.
+ * mate_ui_accel_map_load_async:
+ * @map: A #MateUiAccelMap
+ * @filename: Path to the accelerator file
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the file is loaded
+ * @user_data: User data for @callback
  *
- * Returns: (transfer full): A new #MateUiAccelMap
+ * Asynchronously loads accelerators from a file, like
+ * mate_ui_accel_map_load(). The file is read and parsed in a worker
+ * thread; the map is updated in one step, on the calling thread, just
+ * before @callback runs. @map must stay alive until then. Must be called
+ * on the main thread.
  */
-MateUiAccelMap *
-mate_ui_accel_map_new(void)
+void
+mate_ui_accel_map_load_async(MateUiAccelMap      *map,
+                              const gchar         *filename,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
 {
-    MateUiAccelMap *map = g_new0(MateUiAccelMap, 1);
-    map->accels = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
-    return map;
+    g_return_if_fail(map != NULL);
+    g_return_if_fail(filename != NULL);
+
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, mate_ui_accel_map_load_async);
+    g_task_set_task_data(task, map, NULL);
+
+    GTask *read_task = g_task_new(NULL, cancellable, accel_map_load_cb, task);
+    g_task_set_task_data(read_task, accel_map_read_new(filename), accel_map_read_free);
+    g_task_run_in_thread(read_task, accel_map_load_thread);
+    g_object_unref(read_task);
 }
 
 /**
- * mate_ui_accel_map_free:
- * @map: A #MateUiAccelMap
+ * mate_ui_accel_map_load_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
  *
- * Frees an accelerator map.
+ * Finishes an operation started with mate_ui_accel_map_load_async().
+ *
+ * Returns: %TRUE on success
  */
-void
-mate_ui_accel_map_free(MateUiAccelMap *map)
+gboolean
+mate_ui_accel_map_load_finish(GAsyncResult  *result,
+                               GError       **error)
 {
-    if (map == NULL)
-        return;
+    g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
 
-    g_hash_table_unref(map->accels);
-    g_free(map);
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/* Appends @str, escaping what the parser would otherwise interpret */
+static void
+accel_map_append_escaped(GString     *out,
+                         const gchar *str)
+{
+    for (const gchar *p = str; *p != '\0'; p++)
+    {
+        if (*p == '\\' || *p == '=' || *p == '#' ||
+            (g_ascii_isspace(*p) && (p == str || p[1] == '\0')))
+            g_string_append_c(out, '\\');
+        g_string_append_c(out, *p);
+    }
+}
+
+static gint
+accel_map_entry_compare(gconstpointer a,
+                        gconstpointer b)
+{
+    const AccelMapEntry *x = *(const AccelMapEntry **) a;
+    const AccelMapEntry *y = *(const AccelMapEntry **) b;
+    return strcmp(x->action_name, y->action_name);
+}
+
+/* Serializes the map sorted by action name, so saved files diff cleanly */
+static GBytes *
+accel_map_serialize(MateUiAccelMap *map)
+{
+    GPtrArray *entries = g_ptr_array_sized_new(g_hash_table_size(map->accels));
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, map->accels);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        g_ptr_array_add(entries, value);
+
+    g_ptr_array_sort(entries, accel_map_entry_compare);
+
+    GString *content = g_string_sized_new(64 + entries->len * 32);
+    g_string_append(content, "# MATE UI Accelerator Map\n");
+    g_string_append(content, "# Format: action_name=accelerator\n\n");
+
+    for (guint i = 0; i < entries->len; i++)
+    {
+        AccelMapEntry *entry = g_ptr_array_index(entries, i);
+
+        accel_map_append_escaped(content, entry->action_name);
+        g_string_append_c(content, '=');
+        accel_map_append_escaped(content, entry->accel);
+        g_string_append_c(content, '\n');
+    }
+
+    g_ptr_array_free(entries, TRUE);
+
+    return g_string_free_to_bytes(content);
 }
 
 /**
- * mate_ui_accel_map_add:
+ * mate_ui_accel_map_save:
  * @map: A #MateUiAccelMap
- * @action_name: The action name
- * @accel: The accelerator string
+ * @filename: Path to save to
+ * @error: Return location for error
+ *
+ * Saves accelerators to a file, sorted by action name.
  *
- * Adds an accelerator to the map.
+ * Returns: %TRUE on success
  */
-void
-mate_ui_accel_map_add(MateUiAccelMap *map,
-                       const gchar    *action_name,
-                       const gchar    *accel)
+gboolean
+mate_ui_accel_map_save(MateUiAccelMap  *map,
+                        const gchar     *filename,
+                        GError         **error)
 {
-    g_return_if_fail(map != NULL);
-    g_return_if_fail(action_name != NULL);
-    g_return_if_fail(accel != NULL);
+    g_return_val_if_fail(map != NULL, FALSE);
+    g_return_val_if_fail(filename != NULL, FALSE);
 
-    g_hash_table_insert(map->accels, g_strdup(action_name), g_strdup(accel));
+    GBytes *content = accel_map_serialize(map);
+    gsize length;
+    const gchar *data = g_bytes_get_data(content, &length);
+
+    gboolean result = g_file_set_contents(filename, data, length, error);
+    g_bytes_unref(content);
+
+    return result;
 }
 
-/**
- * mate_ui_accel_map_add_entries:
- * @map: A #MateUiAccelMap
- * @entries: Array of #MateUiAccelEntry structures
- * @n_entries: Number of entries
+/*
+ * Autosave
  *
- * Adds multiple accelerators to the map.
+ * Changes schedule a write after the map has been quiet for the autosave
+ * delay. The contents are serialized on the calling thread, which is
+ * cheap, and written by g_file_replace_contents() in a worker thread,
+ * which replaces the file atomically. Changes made while a write is in
+ * flight schedule another one when it completes.
+ *
+ * The worker signals a condition when it is done, so a flush can wait
+ * for it without running any main context.
  */
-void
-mate_ui_accel_map_add_entries(MateUiAccelMap         *map,
-                               const MateUiAccelEntry *entries,
-                               gsize                   n_entries)
+static void
+accel_map_autosave_free(AccelMapAutosave *save)
 {
-    g_return_if_fail(map != NULL);
-    g_return_if_fail(entries != NULL || n_entries == 0);
+    if (save->timeout_id != 0)
+        g_source_remove(save->timeout_id);
 
-    for (gsize i = 0; i < n_entries; i++)
+    g_mutex_clear(&save->lock);
+    g_cond_clear(&save->done);
+    g_object_unref(save->file);
+    g_free(save);
+}
+
+static void
+accel_map_autosave_thread(GTask        *task,
+                          gpointer      source_object,
+                          gpointer      task_data,
+                          GCancellable *cancellable)
+{
+    AccelMapAutosave *save = task_data;
+    GError *error = NULL;
+    gsize length;
+    const gchar *data = g_bytes_get_data(save->content, &length);
+
+    gboolean result = g_file_replace_contents(G_FILE(source_object), data, length,
+                                              NULL, FALSE, G_FILE_CREATE_NONE,
+                                              NULL, cancellable, &error);
+
+    g_mutex_lock(&save->lock);
+    save->busy = FALSE;
+    g_cond_broadcast(&save->done);
+    g_mutex_unlock(&save->lock);
+
+    if (result)
+        g_task_return_boolean(task, TRUE);
+    else
+        g_task_return_error(task, error);
+}
+
+static void
+accel_map_autosave_written(GObject      *source,
+                           GAsyncResult *result,
+                           gpointer      user_data)
+{
+    AccelMapAutosave *save = user_data;
+    GError *error = NULL;
+
+    save->writing = FALSE;
+    g_bytes_unref(save->content);
+    save->content = NULL;
+    g_clear_object(&save->cancellable);
+
+    if (!g_task_propagate_boolean(G_TASK(result), &error))
     {
-        mate_ui_accel_map_add(map, entries[i].action_name, entries[i].accel);
+        /* A flush cancels the write and rewrites the file itself */
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            gchar *path = g_file_get_parse_name(G_FILE(source));
+            g_warning("Failed to save accelerators to %s: %s", path, error->message);
+            g_free(path);
+        }
+        g_error_free(error);
+    }
+
+    if (save->map == NULL)
+    {
+        accel_map_autosave_free(save);
+        return;
+    }
+
+    if (save->dirty)
+        accel_map_autosave_schedule(save->map);
+}
+
+static gboolean
+accel_map_autosave_timeout(gpointer user_data)
+{
+    AccelMapAutosave *save = user_data;
+
+    save->timeout_id = 0;
+    save->dirty = FALSE;
+    save->writing = TRUE;
+    save->busy = TRUE;
+    save->content = accel_map_serialize(save->map);
+    save->cancellable = g_cancellable_new();
+
+    GTask *task = g_task_new(save->file, save->cancellable,
+                             accel_map_autosave_written, save);
+    g_task_set_task_data(task, save, NULL);
+    g_task_run_in_thread(task, accel_map_autosave_thread);
+    g_object_unref(task);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+accel_map_autosave_schedule(MateUiAccelMap *map)
+{
+    AccelMapAutosave *save = map->autosave;
+    if (save == NULL)
+        return;
+
+    save->dirty = TRUE;
+
+    /* The write callback reschedules */
+    if (save->writing)
+        return;
+
+    if (save->timeout_id != 0)
+        g_source_remove(save->timeout_id);
+
+    save->timeout_id = g_timeout_add(save->delay, accel_map_autosave_timeout, save);
+}
+
+static void
+accel_map_autosave_detach(MateUiAccelMap *map)
+{
+    AccelMapAutosave *save = map->autosave;
+    if (save == NULL)
+        return;
+
+    map->autosave = NULL;
+
+    if (save->timeout_id != 0)
+    {
+        g_source_remove(save->timeout_id);
+        save->timeout_id = 0;
     }
+
+    /* An in-flight write frees the state when it completes */
+    save->map = NULL;
+    if (!save->writing)
+        accel_map_autosave_free(save);
 }
 
 /**
- * mate_ui_accel_map_remove:
+ * mate_ui_accel_map_set_autosave:
  * @map: A #MateUiAccelMap
- * @action_name: The action name to remove
+ * @filename: (nullable): Path to save to, or %NULL to disable autosave
+ * @delay_ms: How long the map must be unchanged before it is saved
  *
- * Removes an accelerator from the map.
+ * Saves the map to @filename whenever it changes. Bursts of changes are
+ * coalesced into one write, made once no change has happened for
+ * @delay_ms milliseconds, so editing shortcuts never blocks on disk I/O.
+ * The file is replaced atomically and sorted by action name.
  */
 void
-mate_ui_accel_map_remove(MateUiAccelMap *map,
-                          const gchar    *action_name)
+mate_ui_accel_map_set_autosave(MateUiAccelMap *map,
+                                const gchar    *filename,
+                                guint           delay_ms)
 {
     g_return_if_fail(map != NULL);
-    g_return_if_fail(action_name != NULL);
 
-    g_hash_table_remove(map->accels, action_name);
+    accel_map_autosave_detach(map);
+
+    if (filename == NULL)
+        return;
+
+    AccelMapAutosave *save = g_new0(AccelMapAutosave, 1);
+    save->map = map;
+    save->file = g_file_new_for_path(filename);
+    save->delay = delay_ms;
+    g_mutex_init(&save->lock);
+    g_cond_init(&save->done);
+
+    map->autosave = save;
 }
 
 /**
- * mate_ui_accel_map_get:
+ * mate_ui_accel_map_flush:
  * @map: A #MateUiAccelMap
- * @action_name: The action name
+ * @error: Return location for error
  *
- * Gets the accelerator for an action.
+ * Writes pending autosave changes now. A write already in progress is
+ * cancelled and waited for without running any main context, then the
+ * file is written synchronously. Call this before exiting so recent
+ * edits are not lost.
  *
- * Returns: (transfer none) (nullable): The accelerator string or %NULL
+ * Returns: %TRUE on success, or if there was nothing to write
  */
-const gchar *
-mate_ui_accel_map_get(MateUiAccelMap *map,
-                       const gchar    *action_name)
+gboolean
+mate_ui_accel_map_flush(MateUiAccelMap  *map,
+                         GError         **error)
 {
-    g_return_val_if_fail(map != NULL, NULL);
-    g_return_val_if_fail(action_name != NULL, NULL);
+    g_return_val_if_fail(map != NULL, FALSE);
+
+    AccelMapAutosave *save = map->autosave;
+    if (save == NULL)
+        return TRUE;
+
+    if (save->timeout_id != 0)
+    {
+        g_source_remove(save->timeout_id);
+        save->timeout_id = 0;
+    }
+
+    /*
+     * The write in flight must not race the one below. Its result is
+     * unknown once cancelled, so the contents are written again; its
+     * callback still runs later and finds nothing left to do.
+     */
+    if (save->writing)
+    {
+        g_cancellable_cancel(save->cancellable);
+
+        g_mutex_lock(&save->lock);
+        while (save->busy)
+            g_cond_wait(&save->done, &save->lock);
+        g_mutex_unlock(&save->lock);
+
+        save->dirty = TRUE;
+    }
+
+    if (!save->dirty)
+        return TRUE;
+
+    GBytes *content = accel_map_serialize(map);
+    gsize length;
+    const gchar *data = g_bytes_get_data(content, &length);
+
+    gboolean result = g_file_replace_contents(save->file, data, length, NULL, FALSE,
+                                              G_FILE_CREATE_NONE, NULL, NULL, error);
+    g_bytes_unref(content);
+
+    if (result)
+        save->dirty = FALSE;
+
+    return result;
+}
+
+/*
+ * Live reload
+ *
+ * File changes are coalesced for ACCEL_MAP_RELOAD_DELAY before the file
+ * is read and parsed in a worker thread. The result is diffed against
+ * the map: unchanged bindings are left alone, so re-applying to attached
+ * applications only touches what was added, changed or removed.
+ */
+#define ACCEL_MAP_RELOAD_DELAY 250
+
+static void accel_map_watch_schedule(AccelMapWatch *watch);
+
+static void
+accel_map_watch_free(AccelMapWatch *watch)
+{
+    if (watch->reload_id != 0)
+        g_source_remove(watch->reload_id);
+
+    if (watch->monitor != NULL)
+    {
+        g_signal_handlers_disconnect_by_data(watch->monitor, watch);
+        g_file_monitor_cancel(watch->monitor);
+        g_object_unref(watch->monitor);
+    }
+
+    g_object_unref(watch->file);
+    g_free(watch->filename);
+    g_free(watch);
+}
+
+/* Takes ownership of @accels */
+static void
+accel_map_watch_apply(AccelMapWatch *watch,
+                      GHashTable    *accels)
+{
+    MateUiAccelMap *map = watch->map;
+    GSList *removed = NULL;
+    GHashTableIter iter;
+    gpointer key;
+    gpointer value;
+
+    /* Writing back what was just read would only trigger another reload */
+    AccelMapAutosave *save = map->autosave;
+    if (save != NULL && g_file_equal(save->file, watch->file))
+        map->autosave = NULL;
+
+    g_hash_table_iter_init(&iter, map->accels);
+    while (g_hash_table_iter_next(&iter, &key, NULL))
+    {
+        if (!g_hash_table_contains(accels, key))
+            removed = g_slist_prepend(removed, key);
+    }
+
+    g_hash_table_iter_init(&iter, accels);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+    {
+        AccelMapEntry *entry = value;
+        AccelMapEntry *old = g_hash_table_lookup(map->accels, key);
+
+        if (old != NULL && strcmp(old->accel, entry->accel) == 0)
+            continue;
+
+        g_hash_table_iter_steal(&iter);
+        accel_map_set_entry(map, entry);
+    }
+
+    for (GSList *l = removed; l != NULL; l = l->next)
+        accel_map_remove_entry(map, l->data);
+
+    map->autosave = save;
+
+    for (GSList *l = map->apps; l != NULL; l = l->next)
+    {
+        AccelMapApp *state = l->data;
+        mate_ui_accel_map_apply_to_app(map, state->app);
+    }
+
+    g_slist_free(removed);
+    g_hash_table_unref(accels);
+}
+
+static void
+accel_map_watch_loaded(GObject      *source G_GNUC_UNUSED,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+    AccelMapWatch *watch = user_data;
+    GError *error = NULL;
+
+    watch->reloading = FALSE;
+
+    GHashTable *accels = g_task_propagate_pointer(G_TASK(result), &error);
+
+    if (watch->map == NULL)
+    {
+        if (accels != NULL)
+            g_hash_table_unref(accels);
+        g_clear_error(&error);
+        accel_map_watch_free(watch);
+        return;
+    }
+
+    if (accels != NULL)
+    {
+        accel_map_watch_apply(watch, accels);
+    }
+    else
+    {
+        /* A deleted file keeps the current bindings */
+        if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            g_warning("Failed to reload accelerators: %s", error->message);
+        g_error_free(error);
+    }
+
+    if (watch->pending)
+        accel_map_watch_schedule(watch);
+}
+
+static gboolean
+accel_map_watch_reload(gpointer user_data)
+{
+    AccelMapWatch *watch = user_data;
+
+    watch->reload_id = 0;
+    watch->pending = FALSE;
+    watch->reloading = TRUE;
+
+    GTask *task = g_task_new(NULL, NULL, accel_map_watch_loaded, watch);
+    g_task_set_task_data(task, accel_map_read_new(watch->filename), accel_map_read_free);
+    g_task_run_in_thread(task, accel_map_load_thread);
+    g_object_unref(task);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+accel_map_watch_schedule(AccelMapWatch *watch)
+{
+    watch->pending = TRUE;
 
-    return g_hash_table_lookup(map->accels, action_name);
+    /* The reload in flight reschedules when it completes */
+    if (watch->reloading)
+        return;
+
+    if (watch->reload_id != 0)
+        g_source_remove(watch->reload_id);
+
+    watch->reload_id = g_timeout_add(ACCEL_MAP_RELOAD_DELAY, accel_map_watch_reload, watch);
+}
+
+static void
+accel_map_watch_changed(GFileMonitor      *monitor G_GNUC_UNUSED,
+                        GFile             *file G_GNUC_UNUSED,
+                        GFile             *other_file G_GNUC_UNUSED,
+                        GFileMonitorEvent  event,
+                        gpointer           user_data)
+{
+    switch (event)
+    {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_CREATED:
+    case G_FILE_MONITOR_EVENT_DELETED:
+    case G_FILE_MONITOR_EVENT_MOVED_IN:
+    case G_FILE_MONITOR_EVENT_RENAMED:
+        accel_map_watch_schedule(user_data);
+        break;
+    default:
+        break;
+    }
 }
 
-/**
- * mate_ui_accel_map_apply_to_app:
- * @map: A #MateUiAccelMap
- * @app: A #GtkApplication
- *
- * Applies the accelerator map to an application.
- */
-void
-mate_ui_accel_map_apply_to_app(MateUiAccelMap *map,
-                                GtkApplication *app)
+static void
+accel_map_watch_detach(MateUiAccelMap *map)
 {
-    g_return_if_fail(map != NULL);
-    g_return_if_fail(GTK_IS_APPLICATION(app));
+    AccelMapWatch *watch = map->watch;
+    if (watch == NULL)
+        return;
 
-    GHashTableIter iter;
-    gpointer key, value;
+    map->watch = NULL;
+    watch->map = NULL;
 
-    g_hash_table_iter_init(&iter, map->accels);
-    while (g_hash_table_iter_next(&iter, &key, &value))
+    /* A reload in flight frees the state when it completes */
+    if (watch->reloading)
     {
-        const gchar *action_name = key;
-        const gchar *accel = value;
-        const gchar *accels[] = { accel, NULL };
+        g_signal_handlers_disconnect_by_data(watch->monitor, watch);
+        g_file_monitor_cancel(watch->monitor);
+        g_clear_object(&watch->monitor);
 
-        gtk_application_set_accels_for_action(app, action_name, accels);
+        if (watch->reload_id != 0)
+        {
+            g_source_remove(watch->reload_id);
+            watch->reload_id = 0;
+        }
+        return;
     }
+
+    accel_map_watch_free(watch);
 }
 
 /**
- * mate_ui_accel_map_load:
+ * mate_ui_accel_map_watch:
  * @map: A #MateUiAccelMap
  * @filename: Path to the accelerator file
  * @error: Return location for error
  *
- * Loads accelerators from a file. File format is one entry per line:
- * action_name=<accelerator>
+ * Reloads the map whenever @filename changes on disk. Bursts of changes
+ * are coalesced into one reload, the file is parsed off the main thread,
+ * and only bindings that were added, changed or removed are applied to
+ * the applications the map was applied to. A file that fails to parse,
+ * or is deleted, leaves the map unchanged.
  *
- * Returns: %TRUE on success
+ * The map is not loaded immediately; use mate_ui_accel_map_load() or
+ * mate_ui_accel_map_load_async() for that.
+ *
+ * Returns: %TRUE if the file is being watched
  */
 gboolean
-mate_ui_accel_map_load(MateUiAccelMap  *map,
-                        const gchar     *filename,
-                        GError         **error)
+mate_ui_accel_map_watch(MateUiAccelMap  *map,
+                         const gchar     *filename,
+                         GError         **error)
 {
     g_return_val_if_fail(map != NULL, FALSE);
     g_return_val_if_fail(filename != NULL, FALSE);
 
-    gchar *contents = NULL;
-    gsize length;
-
-    if (!g_file_get_contents(filename, &contents, &length, error))
-        return FALSE;
-
-    gchar **lines = g_strsplit(contents, "\n", -1);
-    g_free(contents);
+    accel_map_watch_detach(map);
 
-    for (gint i = 0; lines[i] != NULL; i++)
+    GFile *file = g_file_new_for_path(filename);
+    GFileMonitor *monitor = g_file_monitor_file(file, G_FILE_MONITOR_WATCH_MOVES, NULL, error);
+    if (monitor == NULL)
     {
-        gchar *line = g_strstrip(lines[i]);
+        g_object_unref(file);
+        return FALSE;
+    }
 
-        /* Skip empty lines and comments */
-        if (*line == '\0' || *line == '#')
-            continue;
+    AccelMapWatch *watch = g_new0(AccelMapWatch, 1);
+    watch->map = map;
+    watch->file = file;
+    watch->filename = g_strdup(filename);
+    watch->monitor = monitor;
 
-        gchar **parts = g_strsplit(line, "=", 2);
-        if (parts[0] != NULL && parts[1] != NULL)
-        {
-            gchar *action = g_strstrip(parts[0]);
-            gchar *accel = g_strstrip(parts[1]);
+    g_signal_connect(monitor, "changed", G_CALLBACK(accel_map_watch_changed), watch);
 
-            if (*action != '\0' && *accel != '\0')
-            {
-                mate_ui_accel_map_add(map, action, accel);
-            }
-        }
-        g_strfreev(parts);
-    }
+    map->watch = watch;
 
-    g_strfreev(lines);
     return TRUE;
 }
 
 /**
- * mate_ui_accel_map_save:
+ * mate_ui_accel_map_unwatch:
  * @map: A #MateUiAccelMap
- * @filename: Path to save to
- * @error: Return location for error
- *
- * Saves accelerators to a file.
  *
- * Returns: %TRUE on success
+ * Stops reloading the map when its file changes.
  */
-gboolean
-mate_ui_accel_map_save(MateUiAccelMap  *map,
-                        const gchar     *filename,
-                        GError         **error)
+void
+mate_ui_accel_map_unwatch(MateUiAccelMap *map)
 {
-    g_return_val_if_fail(map != NULL, FALSE);
-    g_return_val_if_fail(filename != NULL, FALSE);
-
-    GString *content = g_string_new("# MATE UI Accelerator Map\n");
-    g_string_append(content, "# Format: action_name=accelerator\n\n");
-
-    GHashTableIter iter;
-    gpointer key, value;
-
-    g_hash_table_iter_init(&iter, map->accels);
-    while (g_hash_table_iter_next(&iter, &key, &value))
-    {
-        g_string_append_printf(content, "%s=%s\n", (gchar *)key, (gchar *)value);
-    }
-
-    gboolean result = g_file_set_contents(filename, content->str, content->len, error);
-    g_string_free(content, TRUE);
+    g_return_if_fail(map != NULL);
 
-    return result;
+    accel_map_watch_detach(map);
 }
 
 /**
@@ -260,8 +1978,9 @@ mate_ui_accel_group_new(void)
 /* Callback data for accel group callbacks */
 typedef struct
 {
-    GCallback callback;
-    gpointer  user_data;
+    GCallback      callback;
+    gpointer       user_data;
+    GtkAccelGroup *accel_group;   /* unowned, for the conflict index */
 } AccelCallbackData;
 
 static gboolean
@@ -278,9 +1997,12 @@ accel_callback_wrapper(GtkAccelGroup   *accel_group G_GNUC_UNUSED,
 }
 
 static void
-accel_callback_data_free(gpointer data, GClosure *closure G_GNUC_UNUSED)
+accel_callback_data_free(gpointer data, GClosure *closure)
 {
-    g_free(data);
+    AccelCallbackData *d = data;
+
+    accel_index_remove(d->accel_group, NULL, closure);
+    g_free(d);
 }
 
 /**
@@ -290,7 +2012,9 @@ accel_callback_data_free(gpointer data, GClosure *closure G_GNUC_UNUSED)
  * @callback: Callback function
  * @user_data: User data for callback
  *
- * Adds an accelerator to the group with a callback.
+ * Adds an accelerator to the group with a callback. Windows with many
+ * shortcuts can use mate_ui_key_router_add() instead, which needs no
+ * closure per binding.
  *
  * Returns: %TRUE if successfully added
  */
@@ -305,19 +2029,20 @@ mate_ui_accel_group_add(GtkAccelGroup *accel_group,
 
     guint key;
     GdkModifierType mods;
-    gtk_accelerator_parse(accel, &key, &mods);
 
-    if (key == 0)
+    if (!mate_ui_accel_parse(accel, &key, &mods))
         return FALSE;
 
     AccelCallbackData *data = g_new0(AccelCallbackData, 1);
     data->callback = callback;
     data->user_data = user_data;
+    data->accel_group = accel_group;
 
     GClosure *closure = g_cclosure_new(G_CALLBACK(accel_callback_wrapper),
                                         data, accel_callback_data_free);
 
     gtk_accel_group_connect(accel_group, key, mods, GTK_ACCEL_VISIBLE, closure);
+    accel_index_add(MATE_UI_ACCEL_OWNER_GROUP, accel_group, NULL, closure, key, mods);
 
     return TRUE;
 }
@@ -325,8 +2050,9 @@ mate_ui_accel_group_add(GtkAccelGroup *accel_group,
 /* Action callback data */
 typedef struct
 {
-    GAction  *action;
-    GVariant *parameter;
+    GAction       *action;
+    GVariant      *parameter;
+    GtkAccelGroup *accel_group;   /* unowned, for the conflict index */
 } ActionAccelData;
 
 static gboolean
@@ -342,9 +2068,10 @@ action_accel_callback(GtkAccelGroup   *accel_group G_GNUC_UNUSED,
 }
 
 static void
-action_accel_data_free(gpointer data, GClosure *closure G_GNUC_UNUSED)
+action_accel_data_free(gpointer data, GClosure *closure)
 {
     ActionAccelData *d = data;
+    accel_index_remove(d->accel_group, NULL, closure);
     g_object_unref(d->action);
     if (d->parameter)
         g_variant_unref(d->parameter);
@@ -374,19 +2101,20 @@ mate_ui_accel_group_add_action(GtkAccelGroup *accel_group,
 
     guint key;
     GdkModifierType mods;
-    gtk_accelerator_parse(accel, &key, &mods);
 
-    if (key == 0)
+    if (!mate_ui_accel_parse(accel, &key, &mods))
         return FALSE;
 
     ActionAccelData *data = g_new0(ActionAccelData, 1);
     data->action = g_object_ref(action);
     data->parameter = parameter ? g_variant_ref(parameter) : NULL;
+    data->accel_group = accel_group;
 
     GClosure *closure = g_cclosure_new(G_CALLBACK(action_accel_callback),
                                         data, action_accel_data_free);
 
     gtk_accel_group_connect(accel_group, key, mods, GTK_ACCEL_VISIBLE, closure);
+    accel_index_add(MATE_UI_ACCEL_OWNER_GROUP, accel_group, NULL, closure, key, mods);
 
     return TRUE;
 }
@@ -397,7 +2125,8 @@ mate_ui_accel_group_add_action(GtkAccelGroup *accel_group,
  * @key: (out): Return location for key
  * @mods: (out): Return location for modifiers
  *
- * Parses an accelerator string.
+ * Parses an accelerator string. Like gtk_accelerator_parse(), this must
+ * be called on the main thread, as <Primary> depends on the display.
  *
  * Returns: %TRUE if parsing succeeded
  */
@@ -446,21 +2175,71 @@ mate_ui_accel_label_set_accel(GtkAccelLabel *label,
 
     guint key;
     GdkModifierType mods;
-    gtk_accelerator_parse(accel, &key, &mods);
 
-    if (key != 0)
+    if (mate_ui_accel_parse(accel, &key, &mods))
     {
         gtk_accel_label_set_accel(label, key, mods);
     }
 }
 
+/*
+ * Per-window accel groups
+ *
+ * Widgets connected with mate_ui_accel_connect_to_widget() share one
+ * accel group per toplevel, so GTK checks a single group on each key
+ * press however many widgets have shortcuts.
+ */
+#define ACCEL_WINDOW_GROUP_KEY "mate-ui-accel-group"
+
+static void
+accel_window_destroyed(GtkWidget *window,
+                       gpointer   user_data G_GNUC_UNUSED)
+{
+    GtkAccelGroup *accel_group = g_object_get_data(G_OBJECT(window), ACCEL_WINDOW_GROUP_KEY);
+    if (accel_group == NULL)
+        return;
+
+    gtk_window_remove_accel_group(GTK_WINDOW(window), accel_group);
+    g_object_set_data(G_OBJECT(window), ACCEL_WINDOW_GROUP_KEY, NULL);
+}
+
+/**
+ * mate_ui_accel_group_get_for_window:
+ * @window: A #GtkWindow
+ *
+ * Gets the accel group libmateui manages for @window, creating and
+ * attaching it on first use. It is removed when @window is destroyed.
+ *
+ * Returns: (transfer none): The #GtkAccelGroup for @window
+ */
+GtkAccelGroup *
+mate_ui_accel_group_get_for_window(GtkWindow *window)
+{
+    g_return_val_if_fail(GTK_IS_WINDOW(window), NULL);
+
+    GtkAccelGroup *accel_group = g_object_get_data(G_OBJECT(window), ACCEL_WINDOW_GROUP_KEY);
+    if (accel_group != NULL)
+        return accel_group;
+
+    accel_group = gtk_accel_group_new();
+    gtk_window_add_accel_group(window, accel_group);
+    g_object_set_data_full(G_OBJECT(window), ACCEL_WINDOW_GROUP_KEY,
+                           accel_group, g_object_unref);
+
+    g_signal_connect(window, "destroy", G_CALLBACK(accel_window_destroyed), NULL);
+
+    return accel_group;
+}
+
 /**
  * mate_ui_accel_connect_to_widget:
  * @widget: A widget
  * @accel: The accelerator string
  * @signal_name: Signal to emit
  *
- * Connects an accelerator to emit a signal on a widget.
+ * Connects an accelerator to emit a signal on a widget. The accelerator
+ * is added to the accel group of the widget's toplevel, see
+ * mate_ui_accel_group_get_for_window().
  */
 void
 mate_ui_accel_connect_to_widget(GtkWidget   *widget,
@@ -473,22 +2252,417 @@ mate_ui_accel_connect_to_widget(GtkWidget   *widget,
 
     guint key;
     GdkModifierType mods;
-    gtk_accelerator_parse(accel, &key, &mods);
 
-    if (key == 0)
+    if (!mate_ui_accel_parse(accel, &key, &mods))
         return;
 
     GtkWidget *toplevel = gtk_widget_get_toplevel(widget);
     if (!GTK_IS_WINDOW(toplevel))
         return;
 
-    GtkAccelGroup *accel_group = gtk_accel_group_new();
-    gtk_window_add_accel_group(GTK_WINDOW(toplevel), accel_group);
+    GtkAccelGroup *accel_group = mate_ui_accel_group_get_for_window(GTK_WINDOW(toplevel));
 
     gtk_widget_add_accelerator(widget, signal_name, accel_group,
                                 key, mods, GTK_ACCEL_VISIBLE);
+}
+
+/*
+ * Key router
+ *
+ * Handles key presses on a window directly: one hash lookup on the
+ * normalized key and modifiers, then a plain function call or
+ * g_action_activate(), with no GClosure marshalling and no walk over
+ * accel groups.
+ */
+#define KEY_ROUTER_KEY "mate-ui-key-router"
+
+typedef struct
+{
+    gint64             id;          /* key << 32 | mods, the table key */
+    MateUiKeyRouter   *router;
+    MateUiKeyCallback  callback;
+    gpointer           user_data;
+    GDestroyNotify     destroy;
+    GAction           *action;
+    GVariant          *parameter;
+    const gchar       *action_name; /* interned detailed name, or NULL */
+} KeyRouterBinding;
+
+struct _MateUiKeyRouter
+{
+    GObject               parent_instance;
+
+    GtkWindow            *window;      /* unowned, owns the router */
+    GHashTable           *bindings;    /* &id -> KeyRouterBinding */
+    MateUiKeyRouterStats  stats;
+};
+
+G_DEFINE_TYPE(MateUiKeyRouter, mate_ui_key_router, G_TYPE_OBJECT)
+
+static gint64
+key_router_id(guint           key,
+              GdkModifierType mods)
+{
+    accel_index_normalize(&key, &mods);
+    return ((gint64) key << 32) | (guint32) mods;
+}
+
+static void
+key_router_binding_free(gpointer data)
+{
+    KeyRouterBinding *binding = data;
+
+    accel_index_remove(binding->router, binding->action_name, binding);
+
+    if (binding->destroy != NULL)
+        binding->destroy(binding->user_data);
+    if (binding->action != NULL)
+        g_object_unref(binding->action);
+    if (binding->parameter != NULL)
+        g_variant_unref(binding->parameter);
+    g_free(binding);
+}
+
+static KeyRouterBinding *
+key_router_lookup(MateUiKeyRouter *router,
+                  GdkEventKey     *event)
+{
+    GdkModifierType mods = event->state & gtk_accelerator_get_default_mod_mask();
+    gint64 id = key_router_id(event->keyval, mods);
+    KeyRouterBinding *binding = g_hash_table_lookup(router->bindings, &id);
+
+    if (binding != NULL)
+        return binding;
+
+    /*
+     * Shortcuts like <Control>plus need Shift on most layouts; retry
+     * without the modifiers the keymap consumed to produce the key.
+     */
+    GdkModifierType consumed;
+    guint keyval;
+
+    if (!gdk_keymap_translate_keyboard_state(gdk_keymap_get_for_display(gtk_widget_get_display(GTK_WIDGET(router->window))),
+                                             event->hardware_keycode, event->state, event->group,
+                                             &keyval, NULL, NULL, &consumed))
+        return NULL;
+
+    if ((mods & consumed) == 0)
+        return NULL;
+
+    id = key_router_id(keyval, mods & ~consumed);
+    return g_hash_table_lookup(router->bindings, &id);
+}
+
+static gboolean
+key_router_key_press(GtkWidget   *widget G_GNUC_UNUSED,
+                     GdkEventKey *event,
+                     gpointer     user_data)
+{
+    MateUiKeyRouter *router = user_data;
+    gint64 start = g_get_monotonic_time();
+    gboolean handled = FALSE;
+
+    KeyRouterBinding *binding = key_router_lookup(router, event);
+    if (binding != NULL)
+    {
+        if (binding->action != NULL)
+        {
+            if (g_action_get_enabled(binding->action))
+            {
+                g_action_activate(binding->action, binding->parameter);
+                handled = TRUE;
+            }
+        }
+        else
+        {
+            binding->callback(binding->user_data);
+            handled = TRUE;
+        }
+    }
+
+    gint64 elapsed = g_get_monotonic_time() - start;
+
+    router->stats.n_dispatched++;
+    if (handled)
+        router->stats.n_handled++;
+    router->stats.total_time += elapsed;
+    router->stats.last_time = elapsed;
+    router->stats.max_time = MAX(router->stats.max_time, elapsed);
+
+    return handled;
+}
+
+static void
+mate_ui_key_router_finalize(GObject *object)
+{
+    MateUiKeyRouter *router = MATE_UI_KEY_ROUTER(object);
+
+    g_hash_table_unref(router->bindings);
+
+    G_OBJECT_CLASS(mate_ui_key_router_parent_class)->finalize(object);
+}
+
+static void
+mate_ui_key_router_class_init(MateUiKeyRouterClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+    object_class->finalize = mate_ui_key_router_finalize;
+}
+
+static void
+mate_ui_key_router_init(MateUiKeyRouter *router)
+{
+    router->bindings = g_hash_table_new_full(g_int64_hash, g_int64_equal,
+                                             NULL, key_router_binding_free);
+}
+
+static void
+key_router_window_destroyed(GtkWidget *window,
+                            gpointer   user_data)
+{
+    g_signal_handlers_disconnect_by_func(window, key_router_key_press, user_data);
+    g_signal_handlers_disconnect_by_func(window, key_router_window_destroyed, user_data);
+    g_object_set_data(G_OBJECT(window), KEY_ROUTER_KEY, NULL);
+}
+
+/**
+ * mate_ui_key_router_get_for_window:
+ * @window: A #GtkWindow
+ *
+ * Gets the key router of @window, creating it on first use. The router
+ * handles key presses before the focus widget and accel groups, and is
+ * released when @window is destroyed.
+ *
+ * Returns: (transfer none): The #MateUiKeyRouter for @window
+ */
+MateUiKeyRouter *
+mate_ui_key_router_get_for_window(GtkWindow *window)
+{
+    g_return_val_if_fail(GTK_IS_WINDOW(window), NULL);
+
+    MateUiKeyRouter *router = g_object_get_data(G_OBJECT(window), KEY_ROUTER_KEY);
+    if (router != NULL)
+        return router;
+
+    router = g_object_new(MATE_UI_TYPE_KEY_ROUTER, NULL);
+    router->window = window;
+
+    g_object_set_data_full(G_OBJECT(window), KEY_ROUTER_KEY, router, g_object_unref);
+    g_signal_connect(window, "key-press-event", G_CALLBACK(key_router_key_press), router);
+    g_signal_connect(window, "destroy", G_CALLBACK(key_router_window_destroyed), router);
+
+    return router;
+}
+
+static gboolean
+key_router_add(MateUiKeyRouter  *router,
+               const gchar      *accel,
+               KeyRouterBinding *binding)
+{
+    guint key;
+    GdkModifierType mods;
+
+    binding->router = router;
+
+    if (!mate_ui_accel_parse(accel, &key, &mods))
+    {
+        binding->destroy = NULL;
+        key_router_binding_free(binding);
+        return FALSE;
+    }
+
+    binding->id = key_router_id(key, mods);
+    g_hash_table_replace(router->bindings, &binding->id, binding);
+    accel_index_add(MATE_UI_ACCEL_OWNER_ROUTER, router, binding->action_name, binding, key, mods);
+
+    router->stats.n_bindings = g_hash_table_size(router->bindings);
+
+    return TRUE;
+}
+
+/**
+ * mate_ui_key_router_add:
+ * @router: A #MateUiKeyRouter
+ * @accel: The accelerator string
+ * @callback: Function to call when @accel is pressed
+ * @user_data: User data for @callback
+ * @destroy: (nullable): Function to free @user_data when the binding goes
+ *
+ * Binds @accel to @callback, replacing any previous binding of @accel.
+ * If @accel is invalid, nothing is bound and @destroy is not called.
+ *
+ * Returns: %TRUE if @accel was valid and bound
+ */
+gboolean
+mate_ui_key_router_add(MateUiKeyRouter   *router,
+                        const gchar       *accel,
+                        MateUiKeyCallback  callback,
+                        gpointer           user_data,
+                        GDestroyNotify     destroy)
+{
+    g_return_val_if_fail(MATE_UI_IS_KEY_ROUTER(router), FALSE);
+    g_return_val_if_fail(accel != NULL, FALSE);
+    g_return_val_if_fail(callback != NULL, FALSE);
+
+    KeyRouterBinding *binding = g_new0(KeyRouterBinding, 1);
+    binding->callback = callback;
+    binding->user_data = user_data;
+    binding->destroy = destroy;
+
+    return key_router_add(router, accel, binding);
+}
+
+/*
+ * The detailed name @action is activated under from @window, so the
+ * conflict index can match it with other bindings of the same action.
+ * %NULL if @action is in neither the window nor its application.
+ */
+static const gchar *
+key_router_action_name(GtkWindow *window,
+                       GAction   *action,
+                       GVariant  *parameter)
+{
+    const gchar *name = g_action_get_name(action);
+    const gchar *prefix = NULL;
+
+    if (window == NULL)
+        return NULL;
+
+    if (G_IS_ACTION_MAP(window) &&
+        g_action_map_lookup_action(G_ACTION_MAP(window), name) == action)
+    {
+        prefix = "win";
+    }
+    else
+    {
+        GtkApplication *app = gtk_window_get_application(window);
+
+        if (app != NULL && g_action_map_lookup_action(G_ACTION_MAP(app), name) == action)
+            prefix = "app";
+    }
+
+    if (prefix == NULL)
+        return NULL;
+
+    gchar *prefixed = g_strconcat(prefix, ".", name, NULL);
+    gchar *detailed = g_action_print_detailed_name(prefixed, parameter);
+    const gchar *interned = g_intern_string(detailed);
+
+    g_free(detailed);
+    g_free(prefixed);
+
+    return interned;
+}
+
+/**
+ * mate_ui_key_router_add_action:
+ * @router: A #MateUiKeyRouter
+ * @accel: The accelerator string
+ * @action: A #GAction to activate
+ * @parameter: (nullable): Parameter for the action
+ *
+ * Binds @accel to activate @action, replacing any previous binding of
+ * @accel. Key presses are passed on while @action is disabled.
+ * If @action belongs to the window or its application, an accel map or
+ * application binding of the same action is not reported as a conflict.
+ *
+ * Returns: %TRUE if @accel was valid and bound
+ */
+gboolean
+mate_ui_key_router_add_action(MateUiKeyRouter *router,
+                               const gchar     *accel,
+                               GAction         *action,
+                               GVariant        *parameter)
+{
+    g_return_val_if_fail(MATE_UI_IS_KEY_ROUTER(router), FALSE);
+    g_return_val_if_fail(accel != NULL, FALSE);
+    g_return_val_if_fail(G_IS_ACTION(action), FALSE);
+
+    KeyRouterBinding *binding = g_new0(KeyRouterBinding, 1);
+    binding->action = g_object_ref(action);
+    binding->parameter = parameter ? g_variant_ref_sink(parameter) : NULL;
+    binding->action_name = key_router_action_name(router->window, action, binding->parameter);
+
+    return key_router_add(router, accel, binding);
+}
+
+/**
+ * mate_ui_key_router_remove:
+ * @router: A #MateUiKeyRouter
+ * @accel: The accelerator string
+ *
+ * Removes the binding of @accel.
+ *
+ * Returns: %TRUE if @accel was bound
+ */
+gboolean
+mate_ui_key_router_remove(MateUiKeyRouter *router,
+                           const gchar     *accel)
+{
+    g_return_val_if_fail(MATE_UI_IS_KEY_ROUTER(router), FALSE);
+    g_return_val_if_fail(accel != NULL, FALSE);
+
+    guint key;
+    GdkModifierType mods;
+
+    if (!mate_ui_accel_parse(accel, &key, &mods))
+        return FALSE;
+
+    gint64 id = key_router_id(key, mods);
+    gboolean removed = g_hash_table_remove(router->bindings, &id);
+
+    router->stats.n_bindings = g_hash_table_size(router->bindings);
+
+    return removed;
+}
+
+/**
+ * mate_ui_key_router_get_n_bindings:
+ * @router: A #MateUiKeyRouter
+ *
+ * Gets the number of accelerators bound on @router.
+ *
+ * Returns: The number of bindings
+ */
+guint
+mate_ui_key_router_get_n_bindings(MateUiKeyRouter *router)
+{
+    g_return_val_if_fail(MATE_UI_IS_KEY_ROUTER(router), 0);
+
+    return g_hash_table_size(router->bindings);
+}
+
+/**
+ * mate_ui_key_router_get_stats:
+ * @router: A #MateUiKeyRouter
+ * @stats: (out caller-allocates): Return location for the statistics
+ *
+ * Gets the number of bindings and dispatch statistics of @router.
+ */
+void
+mate_ui_key_router_get_stats(MateUiKeyRouter      *router,
+                              MateUiKeyRouterStats *stats)
+{
+    g_return_if_fail(MATE_UI_IS_KEY_ROUTER(router));
+    g_return_if_fail(stats != NULL);
+
+    *stats = router->stats;
+}
+
+/**
+ * mate_ui_key_router_reset_stats:
+ * @router: A #MateUiKeyRouter
+ *
+ * Resets the dispatch statistics of @router.
+ */
+void
+mate_ui_key_router_reset_stats(MateUiKeyRouter *router)
+{
+    g_return_if_fail(MATE_UI_IS_KEY_ROUTER(router));
 
-    g_object_unref(accel_group);
+    memset(&router->stats, 0, sizeof(router->stats));
+    router->stats.n_bindings = g_hash_table_size(router->bindings);
 }
 
 /**
@@ -511,6 +2685,7 @@ mate_ui_accel_set_app_accels(GtkApplication         *app,
     {
         const gchar *accels[] = { entries[i].accel, NULL };
         gtk_application_set_accels_for_action(app, entries[i].action_name, accels);
+        accel_index_add_app(app, entries[i].action_name, entries[i].accel);
     }
 }
 
@@ -530,4 +2705,5 @@ mate_ui_accel_clear_app_accels(GtkApplication *app,
 
     const gchar *accels[] = { NULL };
     gtk_application_set_accels_for_action(app, action_name, accels);
+    accel_index_remove(app, g_intern_string(action_name), NULL);
 }
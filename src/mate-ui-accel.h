@@ -16,6 +16,29 @@
 
 G_BEGIN_DECLS
 
+/**
+ * MATE_UI_ACCEL_ERROR:
+ *
+ * Error domain for accelerator functions. Errors in this domain are from
+ * the #MateUiAccelError enumeration.
+ */
+#define MATE_UI_ACCEL_ERROR (mate_ui_accel_error_quark())
+
+/**
+ * MateUiAccelError:
+ * @MATE_UI_ACCEL_ERROR_INVALID: The accelerator string could not be parsed
+ * @MATE_UI_ACCEL_ERROR_PARSE: An accelerator file is malformed
+ *
+ * Error codes for #MATE_UI_ACCEL_ERROR.
+ */
+typedef enum
+{
+    MATE_UI_ACCEL_ERROR_INVALID,
+    MATE_UI_ACCEL_ERROR_PARSE,
+} MateUiAccelError;
+
+GQuark mate_ui_accel_error_quark(void);
+
 /**
  * MateUiAccelEntry:
  * @action_name: The action name (e.g., "app.quit" or "win.save")
@@ -29,6 +52,54 @@ typedef struct
     const gchar *accel;
 } MateUiAccelEntry;
 
+/**
+ * MateUiCompiledAccel:
+ * @action_name: The action name
+ * @accel: The accelerator string, as written in the source file
+ * @key: The parsed key value
+ * @mods: The parsed modifiers
+ *
+ * An accelerator parsed at build time by mateui-compile-ui.
+ */
+typedef struct
+{
+    const gchar     *action_name;
+    const gchar     *accel;
+    guint            key;
+    GdkModifierType  mods;
+} MateUiCompiledAccel;
+
+/**
+ * MateUiCompiledAccelTable:
+ * @entries: The accelerators, in perfect-hash slot order
+ * @n_entries: Number of entries
+ * @seeds: Per-bucket seeds of the perfect hash
+ * @n_seeds: Number of seeds
+ *
+ * A table of accelerators generated by mateui-compile-ui, indexed by
+ * action name with a perfect hash.
+ */
+typedef struct
+{
+    const MateUiCompiledAccel *entries;
+    gsize                      n_entries;
+    const guint32             *seeds;
+    gsize                      n_seeds;
+} MateUiCompiledAccelTable;
+
+/**
+ * mate_ui_compiled_accel_table_lookup:
+ * @table: A #MateUiCompiledAccelTable
+ * @action_name: The action name
+ *
+ * Finds the accelerator of an action with two hashes and one string
+ * comparison.
+ *
+ * Returns: (transfer none) (nullable): The accelerator, or %NULL
+ */
+const MateUiCompiledAccel *mate_ui_compiled_accel_table_lookup(const MateUiCompiledAccelTable *table,
+                                                               const gchar                    *action_name);
+
 /**
  * MateUiAccelMap:
  *
@@ -49,7 +120,7 @@ MateUiAccelMap *mate_ui_accel_map_new(void);
  * mate_ui_accel_map_free:
  * @map: A #MateUiAccelMap
  *
- * Frees an accelerator map.
+ * Frees an accelerator map. Pending autosave changes are dropped.
  */
 void mate_ui_accel_map_free(MateUiAccelMap *map);
 
@@ -59,12 +130,30 @@ void mate_ui_accel_map_free(MateUiAccelMap *map);
  * @action_name: The action name
  * @accel: The accelerator string
  *
- * Adds an accelerator to the map.
+ * Adds an accelerator to the map. Invalid accelerators are rejected
+ * with a warning.
  */
 void mate_ui_accel_map_add(MateUiAccelMap *map,
                             const gchar    *action_name,
                             const gchar    *accel);
 
+/**
+ * mate_ui_accel_map_try_add:
+ * @map: A #MateUiAccelMap
+ * @action_name: The action name
+ * @accel: The accelerator string
+ * @error: Return location for error
+ *
+ * Adds an accelerator to the map, reporting an invalid accelerator
+ * instead of dropping it later.
+ *
+ * Returns: %TRUE if the accelerator was valid and added
+ */
+gboolean mate_ui_accel_map_try_add(MateUiAccelMap  *map,
+                                    const gchar     *action_name,
+                                    const gchar     *accel,
+                                    GError         **error);
+
 /**
  * mate_ui_accel_map_add_entries:
  * @map: A #MateUiAccelMap
@@ -77,6 +166,16 @@ void mate_ui_accel_map_add_entries(MateUiAccelMap         *map,
                                     const MateUiAccelEntry *entries,
                                     gsize                   n_entries);
 
+/**
+ * mate_ui_accel_map_add_compiled:
+ * @map: A #MateUiAccelMap
+ * @table: A #MateUiCompiledAccelTable
+ *
+ * Adds the accelerators of a compiled table to the map, without parsing.
+ */
+void mate_ui_accel_map_add_compiled(MateUiAccelMap                 *map,
+                                     const MateUiCompiledAccelTable *table);
+
 /**
  * mate_ui_accel_map_remove:
  * @map: A #MateUiAccelMap
@@ -99,12 +198,30 @@ void mate_ui_accel_map_remove(MateUiAccelMap *map,
 const gchar *mate_ui_accel_map_get(MateUiAccelMap *map,
                                     const gchar    *action_name);
 
+/**
+ * mate_ui_accel_map_lookup:
+ * @map: A #MateUiAccelMap
+ * @action_name: The action name
+ * @key: (out) (optional): Return location for the key
+ * @mods: (out) (optional): Return location for the modifiers
+ *
+ * Gets the parsed accelerator for an action.
+ *
+ * Returns: %TRUE if @action_name has an accelerator
+ */
+gboolean mate_ui_accel_map_lookup(MateUiAccelMap  *map,
+                                   const gchar     *action_name,
+                                   guint           *key,
+                                   GdkModifierType *mods);
+
 /**
  * mate_ui_accel_map_apply_to_app:
  * @map: A #MateUiAccelMap
  * @app: A #GtkApplication
  *
- * Applies the accelerator map to an application.
+ * Applies the accelerator map to an application. Applying again only
+ * updates the actions changed since the last apply to @app, including
+ * clearing those removed from the map.
  */
 void mate_ui_accel_map_apply_to_app(MateUiAccelMap *map,
                                      GtkApplication *app);
@@ -115,21 +232,51 @@ void mate_ui_accel_map_apply_to_app(MateUiAccelMap *map,
  * @filename: Path to the accelerator file
  * @error: Return location for error
  *
- * Loads accelerators from a file.
+ * Loads accelerators from a file. Malformed lines and invalid
+ * accelerators are skipped with a warning.
  *
- * Returns: %TRUE on success
+ * Returns: %TRUE on success, %FALSE if the file could not be read
  */
 gboolean mate_ui_accel_map_load(MateUiAccelMap  *map,
                                  const gchar     *filename,
                                  GError         **error);
 
+/**
+ * mate_ui_accel_map_load_async:
+ * @map: A #MateUiAccelMap
+ * @filename: Path to the accelerator file
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the file is loaded
+ * @user_data: User data for @callback
+ *
+ * Asynchronously loads accelerators from a file. The file is parsed in a
+ * worker thread and the map is updated in one step before @callback runs.
+ */
+void mate_ui_accel_map_load_async(MateUiAccelMap      *map,
+                                   const gchar         *filename,
+                                   GCancellable        *cancellable,
+                                   GAsyncReadyCallback  callback,
+                                   gpointer             user_data);
+
+/**
+ * mate_ui_accel_map_load_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_accel_map_load_async().
+ *
+ * Returns: %TRUE on success
+ */
+gboolean mate_ui_accel_map_load_finish(GAsyncResult  *result,
+                                        GError       **error);
+
 /**
  * mate_ui_accel_map_save:
  * @map: A #MateUiAccelMap
  * @filename: Path to save to
  * @error: Return location for error
  *
- * Saves accelerators to a file.
+ * Saves accelerators to a file, sorted by action name.
  *
  * Returns: %TRUE on success
  */
@@ -137,6 +284,54 @@ gboolean mate_ui_accel_map_save(MateUiAccelMap  *map,
                                  const gchar     *filename,
                                  GError         **error);
 
+/**
+ * mate_ui_accel_map_set_autosave:
+ * @map: A #MateUiAccelMap
+ * @filename: (nullable): Path to save to, or %NULL to disable autosave
+ * @delay_ms: How long the map must be unchanged before it is saved
+ *
+ * Saves the map to @filename asynchronously whenever it changes,
+ * coalescing bursts of changes into one atomic write.
+ */
+void mate_ui_accel_map_set_autosave(MateUiAccelMap *map,
+                                     const gchar    *filename,
+                                     guint           delay_ms);
+
+/**
+ * mate_ui_accel_map_flush:
+ * @map: A #MateUiAccelMap
+ * @error: Return location for error
+ *
+ * Writes pending autosave changes now. Call this before exiting.
+ *
+ * Returns: %TRUE on success, or if there was nothing to write
+ */
+gboolean mate_ui_accel_map_flush(MateUiAccelMap  *map,
+                                  GError         **error);
+
+/**
+ * mate_ui_accel_map_watch:
+ * @map: A #MateUiAccelMap
+ * @filename: Path to the accelerator file
+ * @error: Return location for error
+ *
+ * Reloads the map whenever @filename changes on disk, applying only the
+ * bindings that changed to the applications the map was applied to.
+ *
+ * Returns: %TRUE if the file is being watched
+ */
+gboolean mate_ui_accel_map_watch(MateUiAccelMap  *map,
+                                  const gchar     *filename,
+                                  GError         **error);
+
+/**
+ * mate_ui_accel_map_unwatch:
+ * @map: A #MateUiAccelMap
+ *
+ * Stops reloading the map when its file changes.
+ */
+void mate_ui_accel_map_unwatch(MateUiAccelMap *map);
+
 /**
  * mate_ui_accel_group_new:
  *
@@ -214,13 +409,25 @@ gchar *mate_ui_accel_to_string(guint           key,
 void mate_ui_accel_label_set_accel(GtkAccelLabel *label,
                                     const gchar   *accel);
 
+/**
+ * mate_ui_accel_group_get_for_window:
+ * @window: A #GtkWindow
+ *
+ * Gets the accel group libmateui manages for @window, creating it on
+ * first use. It is removed when @window is destroyed.
+ *
+ * Returns: (transfer none): The #GtkAccelGroup for @window
+ */
+GtkAccelGroup *mate_ui_accel_group_get_for_window(GtkWindow *window);
+
 /**
  * mate_ui_accel_connect_to_widget:
  * @widget: A widget
  * @accel: The accelerator string
  * @signal_name: Signal to emit (e.g., "clicked")
  *
- * Connects an accelerator to emit a signal on a widget.
+ * Connects an accelerator to emit a signal on a widget, using the
+ * shared accel group of its toplevel.
  */
 void mate_ui_accel_connect_to_widget(GtkWidget   *widget,
                                       const gchar *accel,
@@ -248,6 +455,232 @@ void mate_ui_accel_set_app_accels(GtkApplication         *app,
 void mate_ui_accel_clear_app_accels(GtkApplication *app,
                                      const gchar    *action_name);
 
+/**
+ * MateUiAccelOwnerKind:
+ * @MATE_UI_ACCEL_OWNER_MAP: Bound by a #MateUiAccelMap
+ * @MATE_UI_ACCEL_OWNER_APP: Bound on a #GtkApplication
+ * @MATE_UI_ACCEL_OWNER_GROUP: Bound in a #GtkAccelGroup
+ * @MATE_UI_ACCEL_OWNER_ROUTER: Bound on a #MateUiKeyRouter
+ *
+ * What kind of object owns an indexed accelerator.
+ */
+typedef enum
+{
+    MATE_UI_ACCEL_OWNER_MAP,
+    MATE_UI_ACCEL_OWNER_APP,
+    MATE_UI_ACCEL_OWNER_GROUP,
+    MATE_UI_ACCEL_OWNER_ROUTER,
+} MateUiAccelOwnerKind;
+
+/**
+ * MateUiAccelOwner:
+ * @kind: The kind of @instance
+ * @instance: The #MateUiAccelMap, #GtkApplication, #GtkAccelGroup or
+ *   #MateUiKeyRouter
+ * @action_name: (nullable): The detailed action bound, or %NULL for accel
+ *   group bindings, key router callbacks, and key router actions found
+ *   in neither the window nor its application
+ *
+ * Something that binds an accelerator.
+ */
+typedef struct
+{
+    MateUiAccelOwnerKind  kind;
+    gpointer              instance;
+    const gchar          *action_name;
+} MateUiAccelOwner;
+
+/**
+ * MateUiAccelConflict:
+ * @key: The normalized key value
+ * @mods: The normalized modifiers
+ * @owners: (element-type MateUiAccelOwner): Everything binding @key and @mods
+ *
+ * An accelerator bound by more than one action or callback.
+ */
+typedef struct
+{
+    guint            key;
+    GdkModifierType  mods;
+    GPtrArray       *owners;
+} MateUiAccelConflict;
+
+#define MATE_UI_TYPE_ACCEL_INDEX (mate_ui_accel_index_get_type())
+G_DECLARE_FINAL_TYPE(MateUiAccelIndex, mate_ui_accel_index, MATE_UI, ACCEL_INDEX, GObject)
+
+/**
+ * mate_ui_accel_index_get_default:
+ *
+ * Gets the index of every accelerator bound through accelerator maps,
+ * mate_ui_accel_set_app_accels(), mate_ui_accel_group_add() and key
+ * routers.
+ *
+ * Returns: (transfer none): The default #MateUiAccelIndex
+ */
+MateUiAccelIndex *mate_ui_accel_index_get_default(void);
+
+/**
+ * mate_ui_accel_index_lookup:
+ * @index: A #MateUiAccelIndex
+ * @key: The key value
+ * @mods: The modifier mask
+ *
+ * Gets everything that binds an accelerator.
+ *
+ * Returns: (transfer none) (nullable) (element-type MateUiAccelOwner):
+ *   The owners, or %NULL if the accelerator is unbound
+ */
+GPtrArray *mate_ui_accel_index_lookup(MateUiAccelIndex *index,
+                                       guint             key,
+                                       GdkModifierType   mods);
+
+/**
+ * mate_ui_accel_index_has_conflict:
+ * @index: A #MateUiAccelIndex
+ * @key: The key value
+ * @mods: The modifier mask
+ *
+ * Checks whether more than one action or callback binds an accelerator.
+ *
+ * Returns: %TRUE if the accelerator is in conflict
+ */
+gboolean mate_ui_accel_index_has_conflict(MateUiAccelIndex *index,
+                                           guint             key,
+                                           GdkModifierType   mods);
+
+/**
+ * mate_ui_accel_index_list_conflicts:
+ * @index: A #MateUiAccelIndex
+ *
+ * Lists every accelerator that is currently in conflict.
+ *
+ * Returns: (transfer container) (element-type MateUiAccelConflict):
+ *   The conflicts
+ */
+GPtrArray *mate_ui_accel_index_list_conflicts(MateUiAccelIndex *index);
+
+/**
+ * MateUiKeyCallback:
+ * @user_data: User data passed when the binding was added
+ *
+ * Called when a key router binding is pressed.
+ */
+typedef void (*MateUiKeyCallback)(gpointer user_data);
+
+/**
+ * MateUiKeyRouterStats:
+ * @n_bindings: Number of accelerators bound
+ * @n_dispatched: Number of key presses seen
+ * @n_handled: Number of key presses that matched a binding
+ * @total_time: Time spent dispatching, in microseconds
+ * @last_time: Time spent on the last key press, in microseconds
+ * @max_time: Longest time spent on one key press, in microseconds
+ *
+ * Dispatch statistics of a #MateUiKeyRouter. Times include the bound
+ * callbacks and actions.
+ */
+typedef struct
+{
+    guint   n_bindings;
+    guint64 n_dispatched;
+    guint64 n_handled;
+    gint64  total_time;
+    gint64  last_time;
+    gint64  max_time;
+} MateUiKeyRouterStats;
+
+#define MATE_UI_TYPE_KEY_ROUTER (mate_ui_key_router_get_type())
+G_DECLARE_FINAL_TYPE(MateUiKeyRouter, mate_ui_key_router, MATE_UI, KEY_ROUTER, GObject)
+
+/**
+ * mate_ui_key_router_get_for_window:
+ * @window: A #GtkWindow
+ *
+ * Gets the key router of @window, creating it on first use. The router
+ * dispatches key presses with a single hash lookup, before the focus
+ * widget and accel groups see them.
+ *
+ * Returns: (transfer none): The #MateUiKeyRouter for @window
+ */
+MateUiKeyRouter *mate_ui_key_router_get_for_window(GtkWindow *window);
+
+/**
+ * mate_ui_key_router_add:
+ * @router: A #MateUiKeyRouter
+ * @accel: The accelerator string
+ * @callback: Function to call when @accel is pressed
+ * @user_data: User data for @callback
+ * @destroy: (nullable): Function to free @user_data when the binding goes
+ *
+ * Binds @accel to @callback, replacing any previous binding of @accel.
+ *
+ * Returns: %TRUE if @accel was valid and bound
+ */
+gboolean mate_ui_key_router_add(MateUiKeyRouter   *router,
+                                 const gchar       *accel,
+                                 MateUiKeyCallback  callback,
+                                 gpointer           user_data,
+                                 GDestroyNotify     destroy);
+
+/**
+ * mate_ui_key_router_add_action:
+ * @router: A #MateUiKeyRouter
+ * @accel: The accelerator string
+ * @action: A #GAction to activate
+ * @parameter: (nullable): Parameter for the action
+ *
+ * Binds @accel to activate @action, replacing any previous binding of
+ * @accel. If @action belongs to the window or its application, an accel
+ * map or application binding of the same action is not reported as a
+ * conflict.
+ *
+ * Returns: %TRUE if @accel was valid and bound
+ */
+gboolean mate_ui_key_router_add_action(MateUiKeyRouter *router,
+                                        const gchar     *accel,
+                                        GAction         *action,
+                                        GVariant        *parameter);
+
+/**
+ * mate_ui_key_router_remove:
+ * @router: A #MateUiKeyRouter
+ * @accel: The accelerator string
+ *
+ * Removes the binding of @accel.
+ *
+ * Returns: %TRUE if @accel was bound
+ */
+gboolean mate_ui_key_router_remove(MateUiKeyRouter *router,
+                                    const gchar     *accel);
+
+/**
+ * mate_ui_key_router_get_n_bindings:
+ * @router: A #MateUiKeyRouter
+ *
+ * Gets the number of accelerators bound on @router.
+ *
+ * Returns: The number of bindings
+ */
+guint mate_ui_key_router_get_n_bindings(MateUiKeyRouter *router);
+
+/**
+ * mate_ui_key_router_get_stats:
+ * @router: A #MateUiKeyRouter
+ * @stats: (out caller-allocates): Return location for the statistics
+ *
+ * Gets the number of bindings and dispatch statistics of @router.
+ */
+void mate_ui_key_router_get_stats(MateUiKeyRouter      *router,
+                                   MateUiKeyRouterStats *stats);
+
+/**
+ * mate_ui_key_router_reset_stats:
+ * @router: A #MateUiKeyRouter
+ *
+ * Resets the dispatch statistics of @router.
+ */
+void mate_ui_key_router_reset_stats(MateUiKeyRouter *router);
+
 G_END_DECLS
 
 #endif /* MATE_UI_ACCEL_H */
@@ -12,6 +12,7 @@
 #include "config.h"
 #include "mate-ui-application.h"
 #include "mate-ui-dialogs.h"
+#include "mate-ui-private.h"
 
 typedef struct
 {
@@ -196,6 +197,9 @@ mate_ui_application_startup(GApplication *application)
 
     G_APPLICATION_CLASS(mate_ui_application_parent_class)->startup(application);
 
+    /* Connect to the session manager without blocking the first window */
+    _mate_ui_session_init();
+
     /* Set window icon if specified */
     if (priv->icon_name != NULL)
     {
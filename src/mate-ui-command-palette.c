@@ -0,0 +1,948 @@
+/*
+ * mate-ui-command-palette.c - Searchable list of menu commands
+ *
+ * Copyright (C) 2024 MATE Desktop Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#include "config.h"
+#include "mate-ui-command-palette.h"
+
+#include <string.h>
+
+#define COMMAND_PALETTE_MAX_RESULTS 50
+
+/*
+ * Command index
+ *
+ * Built once per descriptor table. Labels are stored without mnemonics
+ * and case folded, and every trigram of their words maps to the sorted
+ * list of entries containing it. A query only scores the entries that
+ * share enough trigrams with its longest word. Abbreviations share no
+ * trigrams, so when that leaves room in the results, the entries with a
+ * word starting like the longest word are tried as well, from a second
+ * list per initial. Only queries too short for any trigram scan every
+ * entry.
+ */
+
+typedef struct
+{
+    const gchar     *label;          /* without mnemonic */
+    const gchar     *path;           /* submenu label, without mnemonic */
+    const gchar     *label_folded;
+    const gchar     *path_folded;
+    const gchar     *action_name;    /* detailed name from the table */
+    const gchar     *prefix;         /* "app", "win", ... */
+    const gchar     *action;         /* name within the prefix group */
+    GVariant        *target;
+    const gchar     *accel_label;    /* NULL without an accelerator */
+    guint            key;
+    GdkModifierType  mods;
+} CommandEntry;
+
+typedef struct
+{
+    GArray       *entries;      /* CommandEntry */
+    GHashTable   *postings;     /* trigram or initial -> GArray of guint32 entry indices */
+    GStringChunk *strings;
+    guint16      *hits;         /* per entry, zero between queries */
+    GArray       *candidates;   /* guint32 entry indices with hits */
+} CommandIndex;
+
+typedef struct
+{
+    guint32 index;
+    gint    score;
+} CommandMatch;
+
+static inline guint32
+command_trigram(const gchar *p)
+{
+    return ((guint32) (guchar) p[0] << 16) | ((guint32) (guchar) p[1] << 8) | (guchar) p[2];
+}
+
+/* Word initials share the postings table, above every trigram */
+static inline guint32
+command_initial(const gchar *p)
+{
+    return (1u << 24) | (guchar) p[0];
+}
+
+static void
+command_posting_free(gpointer data)
+{
+    g_array_free(data, TRUE);
+}
+
+/* Inserts @label without its mnemonic underscores; "__" is a literal one */
+static const gchar *
+command_index_insert_plain(CommandIndex *index,
+                           const gchar  *label)
+{
+    gsize length = strlen(label);
+    gchar *plain = g_alloca(length + 1);
+    gchar *q = plain;
+
+    for (const gchar *p = label; *p != '\0'; p++)
+    {
+        if (*p == '_')
+        {
+            if (p[1] != '_')
+                continue;
+            p++;
+        }
+        *q++ = *p;
+    }
+    *q = '\0';
+
+    return g_string_chunk_insert_const(index->strings, plain);
+}
+
+static const gchar *
+command_index_insert_folded(CommandIndex *index,
+                            const gchar  *text)
+{
+    gchar *folded = g_utf8_casefold(text, -1);
+    const gchar *result = g_string_chunk_insert_const(index->strings, folded);
+
+    g_free(folded);
+
+    return result;
+}
+
+static void
+command_index_post(CommandIndex *index,
+                   guint32       key,
+                   guint32       entry)
+{
+    GArray *posting = g_hash_table_lookup(index->postings, GUINT_TO_POINTER(key));
+
+    if (posting == NULL)
+    {
+        posting = g_array_new(FALSE, FALSE, sizeof(guint32));
+        g_hash_table_insert(index->postings, GUINT_TO_POINTER(key), posting);
+    }
+
+    /* Entries are added in order, so a repeat is always the last one */
+    if (posting->len == 0 || g_array_index(posting, guint32, posting->len - 1) != entry)
+        g_array_append_val(posting, entry);
+}
+
+static void
+command_index_add_trigrams(CommandIndex *index,
+                           const gchar  *text,
+                           guint32       entry)
+{
+    for (const gchar *p = text; p[0] != '\0' && p[1] != '\0' && p[2] != '\0'; p++)
+    {
+        if (p[0] == ' ' || p[1] == ' ' || p[2] == ' ')
+            continue;
+
+        command_index_post(index, command_trigram(p), entry);
+    }
+}
+
+static void
+command_index_add_initials(CommandIndex *index,
+                           const gchar  *text,
+                           guint32       entry)
+{
+    for (const gchar *p = text; *p != '\0'; p++)
+    {
+        if (*p != ' ' && (p == text || p[-1] == ' '))
+            command_index_post(index, command_initial(p), entry);
+    }
+}
+
+static void
+command_entry_set_accel(CommandIndex    *index,
+                        CommandEntry    *entry,
+                        guint            key,
+                        GdkModifierType  mods)
+{
+    entry->key = key;
+    entry->mods = mods;
+    entry->accel_label = NULL;
+
+    if (key != 0)
+    {
+        gchar *label = gtk_accelerator_get_label(key, mods);
+        entry->accel_label = g_string_chunk_insert_const(index->strings, label);
+        g_free(label);
+    }
+}
+
+/* Picks up accelerators changed in @accel_map since the index was built */
+static void
+command_entry_refresh_accel(CommandIndex   *index,
+                            CommandEntry   *entry,
+                            MateUiAccelMap *accel_map)
+{
+    guint key = 0;
+    GdkModifierType mods = 0;
+
+    if (!mate_ui_accel_map_lookup(accel_map, entry->action_name, &key, &mods))
+    {
+        key = 0;
+        mods = 0;
+    }
+
+    if (key != entry->key || mods != entry->mods)
+        command_entry_set_accel(index, entry, key, mods);
+}
+
+static gboolean
+command_entry_init(CommandIndex          *index,
+                   CommandEntry          *entry,
+                   const MateUiMenuEntry *menu_entry,
+                   MateUiAccelMap        *accel_map)
+{
+    gchar *name = NULL;
+    GVariant *target = NULL;
+
+    if (!g_action_parse_detailed_name(menu_entry->action_name, &name, &target, NULL))
+        return FALSE;
+
+    const gchar *dot = strchr(name, '.');
+    if (dot == NULL)
+    {
+        g_free(name);
+        if (target != NULL)
+            g_variant_unref(target);
+        return FALSE;
+    }
+
+    entry->prefix = g_string_chunk_insert_len(index->strings, name, dot - name);
+    entry->action = g_string_chunk_insert_const(index->strings, dot + 1);
+    entry->target = target;
+    entry->action_name = menu_entry->action_name;
+    g_free(name);
+
+    entry->label = command_index_insert_plain(index, menu_entry->label);
+    entry->label_folded = command_index_insert_folded(index, entry->label);
+
+    guint key = 0;
+    GdkModifierType mods = 0;
+
+    if (accel_map != NULL)
+        mate_ui_accel_map_lookup(accel_map, entry->action_name, &key, &mods);
+    else if (menu_entry->accel != NULL)
+        mate_ui_accel_parse(menu_entry->accel, &key, &mods);
+
+    command_entry_set_accel(index, entry, key, mods);
+
+    return TRUE;
+}
+
+static void
+command_index_free(CommandIndex *index)
+{
+    if (index == NULL)
+        return;
+
+    for (guint i = 0; i < index->entries->len; i++)
+    {
+        CommandEntry *entry = &g_array_index(index->entries, CommandEntry, i);
+        if (entry->target != NULL)
+            g_variant_unref(entry->target);
+    }
+
+    g_array_free(index->entries, TRUE);
+    g_hash_table_destroy(index->postings);
+    g_string_chunk_free(index->strings);
+    g_array_free(index->candidates, TRUE);
+    g_free(index->hits);
+    g_free(index);
+}
+
+static CommandIndex *
+command_index_new(const MateUiSubmenu *submenus,
+                  gsize                n_submenus,
+                  MateUiAccelMap      *accel_map)
+{
+    CommandIndex *index = g_new0(CommandIndex, 1);
+
+    index->entries = g_array_new(FALSE, TRUE, sizeof(CommandEntry));
+    index->postings = g_hash_table_new_full(NULL, NULL, NULL, command_posting_free);
+    index->strings = g_string_chunk_new(4096);
+    index->candidates = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+    for (gsize i = 0; i < n_submenus; i++)
+    {
+        const MateUiSubmenu *submenu = &submenus[i];
+        const gchar *path = command_index_insert_plain(index, submenu->label);
+        const gchar *path_folded = command_index_insert_folded(index, path);
+
+        for (gsize j = 0; j < submenu->n_entries; j++)
+        {
+            const MateUiMenuEntry *menu_entry = &submenu->entries[j];
+            CommandEntry entry = { 0 };
+
+            if (menu_entry->label == NULL || menu_entry->action_name == NULL)
+                continue;
+
+            if (!command_entry_init(index, &entry, menu_entry, accel_map))
+                continue;
+
+            entry.path = path;
+            entry.path_folded = path_folded;
+
+            guint32 n = index->entries->len;
+            g_array_append_val(index->entries, entry);
+
+            command_index_add_trigrams(index, entry.label_folded, n);
+            command_index_add_trigrams(index, entry.path_folded, n);
+            command_index_add_initials(index, entry.label_folded, n);
+        }
+    }
+
+    index->hits = g_new0(guint16, MAX(index->entries->len, 1));
+
+    return index;
+}
+
+static gboolean
+command_is_subsequence(const gchar *text,
+                       const gchar *word)
+{
+    for (; *text != '\0' && *word != '\0'; text++)
+    {
+        if (*text == *word)
+            word++;
+    }
+
+    return *word == '\0';
+}
+
+/* Scores one query word against an entry; 0 means no match */
+static gint
+command_score_word(const CommandEntry *entry,
+                   const gchar        *word)
+{
+    const gchar *found = strstr(entry->label_folded, word);
+
+    if (found == entry->label_folded)
+        return 100;
+    if (found != NULL)
+        return found[-1] == ' ' ? 80 : 60;
+    if (strstr(entry->path_folded, word) != NULL)
+        return 40;
+    if (command_is_subsequence(entry->label_folded, word))
+        return 20;
+
+    return 0;
+}
+
+/*
+ * Scores an entry against every word of the query. @hits is the number
+ * of trigrams of @primary the entry shares, which lets a misspelt
+ * primary word still match when nothing else does.
+ */
+static gint
+command_score_entry(const CommandEntry  *entry,
+                    gchar              **words,
+                    const gchar         *primary,
+                    guint                hits,
+                    guint                n_trigrams)
+{
+    gint score = 0;
+
+    for (gchar **w = words; *w != NULL; w++)
+    {
+        if (**w == '\0')
+            continue;
+
+        gint word_score = command_score_word(entry, *w);
+
+        if (word_score == 0 && *w == primary && n_trigrams > 0 && hits * 2 >= n_trigrams)
+            word_score = 5 + (gint) (10 * hits / n_trigrams);
+
+        if (word_score == 0)
+            return 0;
+
+        score += word_score;
+    }
+
+    return score;
+}
+
+static gint
+command_match_compare(gconstpointer a,
+                      gconstpointer b,
+                      gpointer      user_data)
+{
+    const CommandMatch *ma = a;
+    const CommandMatch *mb = b;
+    CommandIndex *index = user_data;
+
+    if (ma->score != mb->score)
+        return mb->score - ma->score;
+
+    gsize la = strlen(g_array_index(index->entries, CommandEntry, ma->index).label);
+    gsize lb = strlen(g_array_index(index->entries, CommandEntry, mb->index).label);
+
+    if (la != lb)
+        return la < lb ? -1 : 1;
+
+    return ma->index < mb->index ? -1 : 1;
+}
+
+static void
+command_index_add_match(CommandIndex *index,
+                        GArray       *matches,
+                        guint32       n,
+                        gint          score)
+{
+    if (score > 0)
+    {
+        CommandMatch match = { n, score };
+        g_array_append_val(matches, match);
+    }
+}
+
+/* Fills @matches with the best entries for the case folded @query */
+static void
+command_index_query(CommandIndex *index,
+                    const gchar  *query,
+                    GArray       *matches)
+{
+    gchar **words = g_strsplit(query, " ", -1);
+    const gchar *primary = NULL;
+    gsize primary_length = 0;
+
+    g_array_set_size(matches, 0);
+
+    for (gchar **w = words; *w != NULL; w++)
+    {
+        gsize length = strlen(*w);
+        if (length > primary_length)
+        {
+            primary = *w;
+            primary_length = length;
+        }
+    }
+
+    if (primary == NULL)
+    {
+        g_strfreev(words);
+        return;
+    }
+
+    guint n_trigrams = 0;
+
+    for (gsize i = 0; i + 2 < primary_length; i++)
+    {
+        const gchar *p = primary + i;
+        gboolean repeated = FALSE;
+
+        for (gsize j = 0; j < i && !repeated; j++)
+            repeated = memcmp(primary + j, p, 3) == 0;
+        if (repeated)
+            continue;
+
+        n_trigrams++;
+
+        GArray *posting = g_hash_table_lookup(index->postings, GUINT_TO_POINTER(command_trigram(p)));
+        if (posting == NULL)
+            continue;
+
+        for (guint k = 0; k < posting->len; k++)
+        {
+            guint32 n = g_array_index(posting, guint32, k);
+            if (index->hits[n]++ == 0)
+                g_array_append_val(index->candidates, n);
+        }
+    }
+
+    if (n_trigrams > 0)
+    {
+        /* Every substring match shares all trigrams of the word */
+        for (guint k = 0; k < index->candidates->len; k++)
+        {
+            guint32 n = g_array_index(index->candidates, guint32, k);
+
+            if (index->hits[n] * 2 < n_trigrams)
+                continue;
+
+            const CommandEntry *entry = &g_array_index(index->entries, CommandEntry, n);
+            command_index_add_match(index, matches, n,
+                                    command_score_entry(entry, words, primary, index->hits[n], n_trigrams));
+        }
+    }
+
+    if (n_trigrams == 0)
+    {
+        for (guint32 n = 0; n < index->entries->len; n++)
+        {
+            const CommandEntry *entry = &g_array_index(index->entries, CommandEntry, n);
+            command_index_add_match(index, matches, n,
+                                    command_score_entry(entry, words, NULL, 0, 0));
+        }
+    }
+    else if (matches->len < COMMAND_PALETTE_MAX_RESULTS)
+    {
+        /*
+         * Abbreviations such as "svas" share no trigrams with their
+         * label; they are only looked for at the start of a word.
+         */
+        GArray *posting = g_hash_table_lookup(index->postings, GUINT_TO_POINTER(command_initial(primary)));
+        guint length = posting != NULL ? posting->len : 0;
+
+        for (guint k = 0; k < length; k++)
+        {
+            guint32 n = g_array_index(posting, guint32, k);
+
+            if (index->hits[n] * 2 >= n_trigrams)
+                continue;
+
+            const CommandEntry *entry = &g_array_index(index->entries, CommandEntry, n);
+            command_index_add_match(index, matches, n,
+                                    command_score_entry(entry, words, NULL, 0, 0));
+        }
+    }
+
+    for (guint k = 0; k < index->candidates->len; k++)
+        index->hits[g_array_index(index->candidates, guint32, k)] = 0;
+    g_array_set_size(index->candidates, 0);
+
+    g_array_sort_with_data(matches, command_match_compare, index);
+    if (matches->len > COMMAND_PALETTE_MAX_RESULTS)
+        g_array_set_size(matches, COMMAND_PALETTE_MAX_RESULTS);
+
+    g_strfreev(words);
+}
+
+/*
+ * Palette widget
+ */
+
+typedef struct
+{
+    GtkWidget *row;
+    GtkWidget *label;
+    GtkWidget *path;
+    GtkWidget *accel;
+} CommandRow;
+
+struct _MateUiCommandPalette
+{
+    GtkBox               parent_instance;
+
+    GtkWidget           *entry;
+    GtkWidget           *scrolled;
+    GtkWidget           *list;
+    CommandRow           rows[COMMAND_PALETTE_MAX_RESULTS];
+    guint32              row_entries[COMMAND_PALETTE_MAX_RESULTS];
+    guint                n_rows;
+
+    const MateUiSubmenu *submenus;
+    gsize                n_submenus;
+    MateUiAccelMap      *accel_map;
+    CommandIndex        *index;
+    GArray              *matches;    /* CommandMatch, reused across queries */
+};
+
+enum
+{
+    SIGNAL_ACTIVATED,
+    N_SIGNALS
+};
+
+static guint palette_signals[N_SIGNALS];
+
+G_DEFINE_TYPE(MateUiCommandPalette, mate_ui_command_palette, GTK_TYPE_BOX)
+
+static GActionGroup *
+command_palette_find_group(MateUiCommandPalette *palette,
+                           const gchar          *prefix)
+{
+    GActionGroup *group = gtk_widget_get_action_group(GTK_WIDGET(palette), prefix);
+    if (group != NULL)
+        return group;
+
+    if (g_str_equal(prefix, "win"))
+    {
+        GtkWidget *toplevel = gtk_widget_get_toplevel(GTK_WIDGET(palette));
+        if (G_IS_ACTION_GROUP(toplevel))
+            return G_ACTION_GROUP(toplevel);
+    }
+    else if (g_str_equal(prefix, "app"))
+    {
+        GApplication *app = g_application_get_default();
+        if (app != NULL)
+            return G_ACTION_GROUP(app);
+    }
+
+    return NULL;
+}
+
+/* Rows are built once and only relabelled by later queries */
+static void
+command_palette_ensure_rows(MateUiCommandPalette *palette)
+{
+    if (palette->rows[0].row != NULL)
+        return;
+
+    for (guint i = 0; i < COMMAND_PALETTE_MAX_RESULTS; i++)
+    {
+        CommandRow *row = &palette->rows[i];
+        GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 12);
+
+        row->label = gtk_label_new(NULL);
+        gtk_label_set_xalign(GTK_LABEL(row->label), 0.0);
+        gtk_label_set_ellipsize(GTK_LABEL(row->label), PANGO_ELLIPSIZE_END);
+        gtk_widget_set_hexpand(row->label, TRUE);
+
+        row->path = gtk_label_new(NULL);
+        gtk_style_context_add_class(gtk_widget_get_style_context(row->path), GTK_STYLE_CLASS_DIM_LABEL);
+
+        row->accel = gtk_label_new(NULL);
+        gtk_style_context_add_class(gtk_widget_get_style_context(row->accel), GTK_STYLE_CLASS_DIM_LABEL);
+
+        gtk_box_pack_start(GTK_BOX(box), row->label, TRUE, TRUE, 0);
+        gtk_box_pack_start(GTK_BOX(box), row->path, FALSE, FALSE, 0);
+        gtk_box_pack_start(GTK_BOX(box), row->accel, FALSE, FALSE, 0);
+        gtk_widget_show_all(box);
+
+        row->row = gtk_list_box_row_new();
+        gtk_container_add(GTK_CONTAINER(row->row), box);
+        gtk_widget_set_no_show_all(row->row, TRUE);
+        gtk_container_add(GTK_CONTAINER(palette->list), row->row);
+    }
+}
+
+static void
+command_palette_clear_rows(MateUiCommandPalette *palette)
+{
+    for (guint i = 0; i < palette->n_rows; i++)
+        gtk_widget_hide(palette->rows[i].row);
+
+    palette->n_rows = 0;
+}
+
+static void
+command_palette_update(MateUiCommandPalette *palette)
+{
+    const gchar *text = gtk_entry_get_text(GTK_ENTRY(palette->entry));
+
+    if (*text == '\0')
+    {
+        command_palette_clear_rows(palette);
+        return;
+    }
+
+    if (palette->index == NULL)
+        palette->index = command_index_new(palette->submenus, palette->n_submenus, palette->accel_map);
+
+    command_palette_ensure_rows(palette);
+
+    gchar *query = g_utf8_casefold(text, -1);
+    command_index_query(palette->index, query, palette->matches);
+    g_free(query);
+
+    guint n_rows = palette->matches->len;
+
+    for (guint i = 0; i < COMMAND_PALETTE_MAX_RESULTS; i++)
+    {
+        CommandRow *row = &palette->rows[i];
+
+        if (i >= n_rows)
+        {
+            if (i >= palette->n_rows)
+                break;
+            gtk_widget_hide(row->row);
+            continue;
+        }
+
+        guint32 n = g_array_index(palette->matches, CommandMatch, i).index;
+        CommandEntry *entry = &g_array_index(palette->index->entries, CommandEntry, n);
+
+        if (palette->accel_map != NULL)
+            command_entry_refresh_accel(palette->index, entry, palette->accel_map);
+
+        GActionGroup *group = command_palette_find_group(palette, entry->prefix);
+        gboolean enabled = group != NULL && g_action_group_get_action_enabled(group, entry->action);
+
+        gtk_label_set_text(GTK_LABEL(row->label), entry->label);
+        gtk_label_set_text(GTK_LABEL(row->path), entry->path);
+        gtk_label_set_text(GTK_LABEL(row->accel), entry->accel_label ? entry->accel_label : "");
+        gtk_widget_set_sensitive(row->row, enabled);
+        gtk_widget_show(row->row);
+
+        palette->row_entries[i] = n;
+    }
+
+    palette->n_rows = n_rows;
+
+    gtk_list_box_select_row(GTK_LIST_BOX(palette->list),
+                            n_rows > 0 ? GTK_LIST_BOX_ROW(palette->rows[0].row) : NULL);
+    gtk_adjustment_set_value(gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(palette->scrolled)), 0.0);
+}
+
+static void
+command_palette_activate_row(MateUiCommandPalette *palette,
+                             GtkListBoxRow        *row)
+{
+    if (row == NULL || !gtk_widget_is_sensitive(GTK_WIDGET(row)))
+        return;
+
+    gint i = gtk_list_box_row_get_index(row);
+    if (i < 0 || (guint) i >= palette->n_rows)
+        return;
+
+    const CommandEntry *entry = &g_array_index(palette->index->entries, CommandEntry, palette->row_entries[i]);
+    GActionGroup *group = command_palette_find_group(palette, entry->prefix);
+
+    if (group == NULL || !g_action_group_get_action_enabled(group, entry->action))
+        return;
+
+    gchar *action_name = g_strdup(entry->action_name);
+    gchar *action = g_strdup(entry->action);
+    GVariant *target = entry->target ? g_variant_ref(entry->target) : NULL;
+
+    /* Reset first, the action may well destroy the palette */
+    gtk_entry_set_text(GTK_ENTRY(palette->entry), "");
+
+    g_object_ref(palette);
+    g_object_ref(group);
+
+    g_action_group_activate_action(group, action, target);
+    g_signal_emit(palette, palette_signals[SIGNAL_ACTIVATED], 0, action_name);
+
+    g_object_unref(group);
+    g_object_unref(palette);
+
+    if (target != NULL)
+        g_variant_unref(target);
+    g_free(action);
+    g_free(action_name);
+}
+
+static void
+command_palette_select(MateUiCommandPalette *palette,
+                       gint                  step)
+{
+    if (palette->n_rows == 0)
+        return;
+
+    GtkListBoxRow *selected = gtk_list_box_get_selected_row(GTK_LIST_BOX(palette->list));
+    gint i = selected != NULL ? gtk_list_box_row_get_index(selected) + step : 0;
+
+    i = CLAMP(i, 0, (gint) palette->n_rows - 1);
+
+    GtkWidget *row = palette->rows[i].row;
+    gtk_list_box_select_row(GTK_LIST_BOX(palette->list), GTK_LIST_BOX_ROW(row));
+
+    /* The entry keeps the focus, so scroll the selection into view here */
+    gint y = 0;
+    if (gtk_widget_translate_coordinates(row, palette->list, 0, 0, NULL, &y))
+    {
+        GtkAdjustment *adjustment = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(palette->scrolled));
+        gtk_adjustment_clamp_page(adjustment, y, y + gtk_widget_get_allocated_height(row));
+    }
+}
+
+static void
+command_palette_entry_changed(GtkEditable *editable G_GNUC_UNUSED,
+                              gpointer     user_data)
+{
+    command_palette_update(MATE_UI_COMMAND_PALETTE(user_data));
+}
+
+static void
+command_palette_entry_activated(GtkEntry *entry G_GNUC_UNUSED,
+                                gpointer  user_data)
+{
+    MateUiCommandPalette *palette = MATE_UI_COMMAND_PALETTE(user_data);
+
+    command_palette_activate_row(palette, gtk_list_box_get_selected_row(GTK_LIST_BOX(palette->list)));
+}
+
+static gboolean
+command_palette_entry_key_press(GtkWidget   *widget G_GNUC_UNUSED,
+                                GdkEventKey *event,
+                                gpointer     user_data)
+{
+    MateUiCommandPalette *palette = MATE_UI_COMMAND_PALETTE(user_data);
+
+    switch (event->keyval)
+    {
+    case GDK_KEY_Down:
+    case GDK_KEY_KP_Down:
+        command_palette_select(palette, 1);
+        return GDK_EVENT_STOP;
+    case GDK_KEY_Up:
+    case GDK_KEY_KP_Up:
+        command_palette_select(palette, -1);
+        return GDK_EVENT_STOP;
+    default:
+        return GDK_EVENT_PROPAGATE;
+    }
+}
+
+static void
+command_palette_row_activated(GtkListBox    *list G_GNUC_UNUSED,
+                              GtkListBoxRow *row,
+                              gpointer       user_data)
+{
+    command_palette_activate_row(MATE_UI_COMMAND_PALETTE(user_data), row);
+}
+
+static void
+mate_ui_command_palette_finalize(GObject *object)
+{
+    MateUiCommandPalette *palette = MATE_UI_COMMAND_PALETTE(object);
+
+    command_index_free(palette->index);
+    g_array_free(palette->matches, TRUE);
+
+    G_OBJECT_CLASS(mate_ui_command_palette_parent_class)->finalize(object);
+}
+
+static void
+mate_ui_command_palette_class_init(MateUiCommandPaletteClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS(klass);
+
+    object_class->finalize = mate_ui_command_palette_finalize;
+
+    /**
+     * MateUiCommandPalette::activated:
+     * @palette: The #MateUiCommandPalette
+     * @action_name: The detailed action name of the activated command
+     *
+     * Emitted after a command was activated from the palette.
+     */
+    palette_signals[SIGNAL_ACTIVATED] =
+        g_signal_new("activated",
+                     G_TYPE_FROM_CLASS(klass),
+                     G_SIGNAL_RUN_LAST,
+                     0,
+                     NULL, NULL,
+                     NULL,
+                     G_TYPE_NONE, 1,
+                     G_TYPE_STRING);
+}
+
+static void
+mate_ui_command_palette_init(MateUiCommandPalette *palette)
+{
+    gtk_orientable_set_orientation(GTK_ORIENTABLE(palette), GTK_ORIENTATION_VERTICAL);
+    gtk_box_set_spacing(GTK_BOX(palette), 6);
+
+    palette->matches = g_array_new(FALSE, FALSE, sizeof(CommandMatch));
+
+    palette->entry = gtk_search_entry_new();
+    palette->list = gtk_list_box_new();
+    gtk_list_box_set_selection_mode(GTK_LIST_BOX(palette->list), GTK_SELECTION_SINGLE);
+
+    palette->scrolled = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(palette->scrolled),
+                                   GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_scrolled_window_set_max_content_height(GTK_SCROLLED_WINDOW(palette->scrolled), 360);
+    gtk_scrolled_window_set_propagate_natural_height(GTK_SCROLLED_WINDOW(palette->scrolled), TRUE);
+    gtk_container_add(GTK_CONTAINER(palette->scrolled), palette->list);
+
+    gtk_box_pack_start(GTK_BOX(palette), palette->entry, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(palette), palette->scrolled, TRUE, TRUE, 0);
+    gtk_widget_show(palette->entry);
+    gtk_widget_show(palette->list);
+    gtk_widget_show(palette->scrolled);
+
+    /* "search-changed" is delayed, results should follow every keystroke */
+    g_signal_connect(palette->entry, "changed", G_CALLBACK(command_palette_entry_changed), palette);
+    g_signal_connect(palette->entry, "activate", G_CALLBACK(command_palette_entry_activated), palette);
+    g_signal_connect(palette->entry, "key-press-event", G_CALLBACK(command_palette_entry_key_press), palette);
+    g_signal_connect(palette->list, "row-activated", G_CALLBACK(command_palette_row_activated), palette);
+}
+
+/**
+ * mate_ui_command_palette_new:
+ *
+ * Creates a command palette: a search entry above a list of the menu
+ * commands matching it. Activating a result activates its action and
+ * emits #MateUiCommandPalette::activated, so a containing popover or
+ * dialog can close.
+ *
+ * Returns: (transfer full): A new #MateUiCommandPalette
+ */
+GtkWidget *
+mate_ui_command_palette_new(void)
+{
+    return g_object_new(MATE_UI_TYPE_COMMAND_PALETTE, NULL);
+}
+
+/**
+ * mate_ui_command_palette_set_entries:
+ * @palette: A #MateUiCommandPalette
+ * @submenus: (array length=n_submenus): Array of #MateUiSubmenu
+ * @n_submenus: Number of submenus
+ * @accel_map: (nullable): A #MateUiAccelMap for accelerator labels, or %NULL
+ *   to use the accelerators of the entries
+ *
+ * Sets the commands of the palette. The search index is rebuilt lazily,
+ * and only when @submenus, @n_submenus or @accel_map differ from the
+ * previous call; tables edited in place need
+ * mate_ui_command_palette_invalidate(). @submenus and @accel_map must
+ * outlive the palette or be replaced first.
+ */
+void
+mate_ui_command_palette_set_entries(MateUiCommandPalette *palette,
+                                     const MateUiSubmenu  *submenus,
+                                     gsize                 n_submenus,
+                                     MateUiAccelMap       *accel_map)
+{
+    g_return_if_fail(MATE_UI_IS_COMMAND_PALETTE(palette));
+    g_return_if_fail(submenus != NULL || n_submenus == 0);
+
+    if (submenus == palette->submenus &&
+        n_submenus == palette->n_submenus &&
+        accel_map == palette->accel_map)
+        return;
+
+    palette->submenus = submenus;
+    palette->n_submenus = n_submenus;
+    palette->accel_map = accel_map;
+
+    mate_ui_command_palette_invalidate(palette);
+}
+
+/**
+ * mate_ui_command_palette_invalidate:
+ * @palette: A #MateUiCommandPalette
+ *
+ * Drops the search index, so it is rebuilt from the current tables on
+ * the next query.
+ */
+void
+mate_ui_command_palette_invalidate(MateUiCommandPalette *palette)
+{
+    g_return_if_fail(MATE_UI_IS_COMMAND_PALETTE(palette));
+
+    /* Shown rows refer to entries of the old index */
+    command_palette_clear_rows(palette);
+    command_index_free(palette->index);
+    palette->index = NULL;
+
+    command_palette_update(palette);
+}
+
+/**
+ * mate_ui_command_palette_get_entry:
+ * @palette: A #MateUiCommandPalette
+ *
+ * Gets the search entry of the palette, e.g. to focus it.
+ *
+ * Returns: (transfer none): The #GtkSearchEntry
+ */
+GtkWidget *
+mate_ui_command_palette_get_entry(MateUiCommandPalette *palette)
+{
+    g_return_val_if_fail(MATE_UI_IS_COMMAND_PALETTE(palette), NULL);
+
+    return palette->entry;
+}
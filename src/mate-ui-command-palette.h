@@ -0,0 +1,77 @@
+/*
+ * mate-ui-command-palette.h - Searchable list of menu commands
+ *
+ * Copyright (C) 2024 MATE Desktop Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#ifndef MATE_UI_COMMAND_PALETTE_H
+#define MATE_UI_COMMAND_PALETTE_H
+
+#include <gtk/gtk.h>
+
+#include "mate-ui-menu.h"
+#include "mate-ui-accel.h"
+
+G_BEGIN_DECLS
+
+#define MATE_UI_TYPE_COMMAND_PALETTE (mate_ui_command_palette_get_type())
+G_DECLARE_FINAL_TYPE(MateUiCommandPalette, mate_ui_command_palette, MATE_UI, COMMAND_PALETTE, GtkBox)
+
+/**
+ * mate_ui_command_palette_new:
+ *
+ * Creates a command palette: a search entry above a list of the menu
+ * commands matching it. Activating a result activates its action and
+ * emits #MateUiCommandPalette::activated, so a containing popover or
+ * dialog can close.
+ *
+ * Returns: (transfer full): A new #MateUiCommandPalette
+ */
+GtkWidget *mate_ui_command_palette_new(void);
+
+/**
+ * mate_ui_command_palette_set_entries:
+ * @palette: A #MateUiCommandPalette
+ * @submenus: (array length=n_submenus): Array of #MateUiSubmenu
+ * @n_submenus: Number of submenus
+ * @accel_map: (nullable): A #MateUiAccelMap for accelerator labels, or %NULL
+ *   to use the accelerators of the entries
+ *
+ * Sets the commands of the palette. The search index is rebuilt lazily,
+ * and only when @submenus, @n_submenus or @accel_map differ from the
+ * previous call; tables edited in place need
+ * mate_ui_command_palette_invalidate(). @submenus and @accel_map must
+ * outlive the palette or be replaced first.
+ */
+void mate_ui_command_palette_set_entries(MateUiCommandPalette *palette,
+                                          const MateUiSubmenu  *submenus,
+                                          gsize                 n_submenus,
+                                          MateUiAccelMap       *accel_map);
+
+/**
+ * mate_ui_command_palette_invalidate:
+ * @palette: A #MateUiCommandPalette
+ *
+ * Drops the search index, so it is rebuilt from the current tables on
+ * the next query.
+ */
+void mate_ui_command_palette_invalidate(MateUiCommandPalette *palette);
+
+/**
+ * mate_ui_command_palette_get_entry:
+ * @palette: A #MateUiCommandPalette
+ *
+ * Gets the search entry of the palette, e.g. to focus it.
+ *
+ * Returns: (transfer none): The #GtkSearchEntry
+ */
+GtkWidget *mate_ui_command_palette_get_entry(MateUiCommandPalette *palette);
+
+G_END_DECLS
+
+#endif /* MATE_UI_COMMAND_PALETTE_H */
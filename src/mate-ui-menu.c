@@ -11,6 +11,9 @@
 
 #include "config.h"
 #include "mate-ui-menu.h"
+#include "mate-ui-accel.h"
+
+#include <string.h>
 
 
 /**
@@ -40,8 +43,7 @@ mate_ui_menu_item_new_with_action(const gchar   *label,
     {
         guint key;
         GdkModifierType mods;
-        gtk_accelerator_parse(accel, &key, &mods);
-        if (key != 0)
+        if (mate_ui_accel_parse(accel, &key, &mods))
         {
             gtk_widget_add_accelerator(item, "activate", accel_group,
                                         key, mods, GTK_ACCEL_VISIBLE);
@@ -51,6 +53,465 @@ mate_ui_menu_item_new_with_action(const gchar   *label,
     return item;
 }
 
+/*
+ * Icon warmup
+ *
+ * Menu icons are looked up and decoded the first time a menu is drawn,
+ * which makes the first open of a large menu stutter. The warmup
+ * functions resolve every icon of the descriptor tables once the next
+ * frame of the widget has been painted, and decode them on a worker
+ * thread. The resulting surfaces are cached per scale factor and shared
+ * by all menu items built afterwards; an item whose scale has no
+ * surface uses the themed icon. Symbolic icons are left to GtkImage,
+ * which recolors them for the current style.
+ */
+
+#define MENU_ICON_NAME_KEY "mate-ui-menu-icon-name"
+
+typedef struct
+{
+    gint          refcount;
+    GtkIconTheme *theme;
+    GPtrArray    *names;        /* interned icon names */
+    gint          size;
+    gint          scale;
+    guint         generation;
+} MenuIconWarmup;
+
+typedef struct
+{
+    const gchar *name;          /* interned */
+    gint         scale;
+} MenuIconKey;
+
+typedef struct
+{
+    MenuIconKey key;
+    guint       generation;
+} MenuIconLoad;
+
+static GtkIconTheme *menu_icon_theme = NULL;
+static GHashTable *menu_icon_surfaces = NULL;   /* MenuIconKey -> cairo_surface_t */
+static GHashTable *menu_icon_pending = NULL;    /* MenuIconKey being loaded */
+static guint menu_icon_generation = 0;
+
+static MenuIconKey *
+menu_icon_key_new(const gchar *name,
+                  gint         scale)
+{
+    MenuIconKey *key = g_new(MenuIconKey, 1);
+    key->name = name;
+    key->scale = scale;
+
+    return key;
+}
+
+static guint
+menu_icon_key_hash(gconstpointer data)
+{
+    const MenuIconKey *key = data;
+
+    return g_direct_hash(key->name) ^ (guint) key->scale;
+}
+
+static gboolean
+menu_icon_key_equal(gconstpointer a,
+                    gconstpointer b)
+{
+    const MenuIconKey *ka = a;
+    const MenuIconKey *kb = b;
+
+    return ka->name == kb->name && ka->scale == kb->scale;
+}
+
+static void
+menu_icon_surface_free(gpointer data)
+{
+    cairo_surface_destroy(data);
+}
+
+static void
+menu_icon_theme_changed(GtkIconTheme *theme G_GNUC_UNUSED,
+                        gpointer      user_data G_GNUC_UNUSED)
+{
+    /* Loads still in flight belong to the old theme */
+    menu_icon_generation++;
+    g_hash_table_remove_all(menu_icon_surfaces);
+    g_hash_table_remove_all(menu_icon_pending);
+}
+
+static void
+menu_icon_set_theme(GtkIconTheme *theme)
+{
+    if (menu_icon_surfaces == NULL)
+    {
+        menu_icon_surfaces = g_hash_table_new_full(menu_icon_key_hash, menu_icon_key_equal,
+                                                   g_free, menu_icon_surface_free);
+        menu_icon_pending = g_hash_table_new_full(menu_icon_key_hash, menu_icon_key_equal,
+                                                  g_free, NULL);
+    }
+
+    if (theme == menu_icon_theme)
+        return;
+
+    if (menu_icon_theme != NULL)
+    {
+        g_signal_handlers_disconnect_by_func(menu_icon_theme, menu_icon_theme_changed, NULL);
+        g_object_unref(menu_icon_theme);
+    }
+
+    menu_icon_theme = g_object_ref(theme);
+    g_signal_connect(menu_icon_theme, "changed", G_CALLBACK(menu_icon_theme_changed), NULL);
+    menu_icon_theme_changed(theme, NULL);
+}
+
+static cairo_surface_t *
+menu_icon_lookup_surface(GtkWidget   *image,
+                         const gchar *icon_name)
+{
+    if (menu_icon_surfaces == NULL)
+        return NULL;
+
+    MenuIconKey key = { icon_name, gtk_widget_get_scale_factor(image) };
+
+    return g_hash_table_lookup(menu_icon_surfaces, &key);
+}
+
+static void
+menu_icon_image_scale_changed(GtkWidget  *image,
+                              GParamSpec *pspec G_GNUC_UNUSED,
+                              gpointer    user_data G_GNUC_UNUSED)
+{
+    const gchar *icon_name = g_object_get_data(G_OBJECT(image), MENU_ICON_NAME_KEY);
+    cairo_surface_t *surface = menu_icon_lookup_surface(image, icon_name);
+
+    /* A surface of another scale would be drawn blurry or oversized */
+    if (surface != NULL)
+        gtk_image_set_from_surface(GTK_IMAGE(image), surface);
+    else
+        gtk_image_set_from_icon_name(GTK_IMAGE(image), icon_name, GTK_ICON_SIZE_MENU);
+}
+
+static void
+menu_icon_image_theme_changed(GtkIconTheme *theme,
+                              gpointer      user_data)
+{
+    GtkImage *image = GTK_IMAGE(user_data);
+    const gchar *icon_name = g_object_get_data(G_OBJECT(image), MENU_ICON_NAME_KEY);
+
+    /* Back to a themed icon, which follows later changes by itself */
+    g_signal_handlers_disconnect_by_func(theme, menu_icon_image_theme_changed, image);
+    g_signal_handlers_disconnect_by_func(image, menu_icon_image_scale_changed, NULL);
+    gtk_image_set_from_icon_name(image, icon_name, GTK_ICON_SIZE_MENU);
+}
+
+/* Uses the warmed up surface of @icon_name at the image's scale when there is one */
+static GtkWidget *
+menu_icon_image_new(const gchar *icon_name)
+{
+    if (menu_icon_surfaces == NULL || g_hash_table_size(menu_icon_surfaces) == 0)
+        return gtk_image_new_from_icon_name(icon_name, GTK_ICON_SIZE_MENU);
+
+    GtkWidget *image = gtk_image_new();
+    const gchar *interned = g_intern_string(icon_name);
+
+    /* Until realized, this is the scale of the screen's first monitor */
+    cairo_surface_t *surface = menu_icon_lookup_surface(image, interned);
+    if (surface == NULL)
+    {
+        gtk_image_set_from_icon_name(GTK_IMAGE(image), icon_name, GTK_ICON_SIZE_MENU);
+        return image;
+    }
+
+    gtk_image_set_from_surface(GTK_IMAGE(image), surface);
+    g_object_set_data(G_OBJECT(image), MENU_ICON_NAME_KEY, (gpointer) interned);
+    g_signal_connect(image, "notify::scale-factor",
+                     G_CALLBACK(menu_icon_image_scale_changed), NULL);
+    g_signal_connect_object(menu_icon_theme, "changed",
+                            G_CALLBACK(menu_icon_image_theme_changed), image, 0);
+
+    return image;
+}
+
+static void
+menu_icon_loaded(GObject      *source,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+    GtkIconInfo *info = GTK_ICON_INFO(source);
+    MenuIconLoad *load = user_data;
+    GdkPixbuf *pixbuf = gtk_icon_info_load_icon_finish(info, result, NULL);
+
+    if (load->generation == menu_icon_generation)
+    {
+        g_hash_table_remove(menu_icon_pending, &load->key);
+
+        if (pixbuf != NULL)
+        {
+            cairo_surface_t *surface = gdk_cairo_surface_create_from_pixbuf(pixbuf, load->key.scale, NULL);
+            g_hash_table_replace(menu_icon_surfaces,
+                                 menu_icon_key_new(load->key.name, load->key.scale),
+                                 surface);
+        }
+    }
+
+    if (pixbuf != NULL)
+        g_object_unref(pixbuf);
+    g_free(load);
+}
+
+static MenuIconWarmup *
+menu_icon_warmup_ref(MenuIconWarmup *warmup)
+{
+    warmup->refcount++;
+    return warmup;
+}
+
+static void
+menu_icon_warmup_unref(MenuIconWarmup *warmup)
+{
+    if (--warmup->refcount > 0)
+        return;
+
+    g_object_unref(warmup->theme);
+    g_ptr_array_free(warmup->names, TRUE);
+    g_free(warmup);
+}
+
+static void
+menu_icon_warmup_closure_unref(gpointer  data,
+                               GClosure *closure G_GNUC_UNUSED)
+{
+    menu_icon_warmup_unref(data);
+}
+
+static void
+menu_icon_warmup_run(MenuIconWarmup *warmup)
+{
+    if (warmup->generation != menu_icon_generation || warmup->theme != menu_icon_theme)
+        return;
+
+    for (guint i = 0; i < warmup->names->len; i++)
+    {
+        const gchar *name = g_ptr_array_index(warmup->names, i);
+        MenuIconKey key = { name, warmup->scale };
+
+        if (g_hash_table_contains(menu_icon_surfaces, &key) ||
+            g_hash_table_contains(menu_icon_pending, &key))
+            continue;
+
+        GtkIconInfo *info = gtk_icon_theme_lookup_icon_for_scale(warmup->theme, name,
+                                                                 warmup->size, warmup->scale,
+                                                                 GTK_ICON_LOOKUP_FORCE_SIZE);
+        if (info == NULL)
+            continue;
+
+        if (gtk_icon_info_is_symbolic(info))
+        {
+            g_object_unref(info);
+            continue;
+        }
+
+        MenuIconLoad *load = g_new0(MenuIconLoad, 1);
+        load->key = key;
+        load->generation = warmup->generation;
+
+        g_hash_table_add(menu_icon_pending, menu_icon_key_new(name, warmup->scale));
+        gtk_icon_info_load_icon_async(info, NULL, menu_icon_loaded, load);
+        g_object_unref(info);
+    }
+}
+
+static gboolean
+menu_icon_warmup_idle(gpointer user_data)
+{
+    menu_icon_warmup_run(user_data);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+menu_icon_warmup_after_paint(GdkFrameClock *clock,
+                             gpointer       user_data)
+{
+    MenuIconWarmup *warmup = user_data;
+
+    menu_icon_warmup_run(warmup);
+
+    /* One frame is enough; drops the reference held by the handler */
+    g_signal_handlers_disconnect_by_func(clock, menu_icon_warmup_after_paint, warmup);
+}
+
+static void
+menu_icon_warmup_hook(MenuIconWarmup *warmup,
+                      GdkFrameClock  *clock)
+{
+    g_signal_connect_data(clock, "after-paint",
+                          G_CALLBACK(menu_icon_warmup_after_paint),
+                          menu_icon_warmup_ref(warmup),
+                          menu_icon_warmup_closure_unref, 0);
+
+    /* Runs even if nothing else is being redrawn */
+    gdk_frame_clock_request_phase(clock, GDK_FRAME_CLOCK_PHASE_AFTER_PAINT);
+}
+
+static void
+menu_icon_warmup_realized(GtkWidget *widget,
+                          gpointer   user_data)
+{
+    MenuIconWarmup *warmup = user_data;
+    GdkFrameClock *clock = gtk_widget_get_frame_clock(widget);
+
+    /* The scale is only final once the widget is on its monitor */
+    warmup->scale = gtk_widget_get_scale_factor(widget);
+
+    if (clock != NULL)
+        menu_icon_warmup_hook(warmup, clock);
+
+    g_signal_handlers_disconnect_by_func(widget, menu_icon_warmup_realized, warmup);
+}
+
+static void
+menu_icon_warmup_add(GPtrArray   *names,
+                     GHashTable  *seen,
+                     const gchar *icon_name)
+{
+    if (icon_name == NULL)
+        return;
+
+    const gchar *interned = g_intern_string(icon_name);
+    if (g_hash_table_add(seen, (gpointer) interned))
+        g_ptr_array_add(names, (gpointer) interned);
+}
+
+static MenuIconWarmup *
+menu_icon_warmup_new(GtkWidget *widget)
+{
+    MenuIconWarmup *warmup = g_new0(MenuIconWarmup, 1);
+    GtkIconTheme *theme;
+    gint width = 16;
+    gint height = 16;
+
+    if (widget != NULL)
+    {
+        theme = gtk_icon_theme_get_for_screen(gtk_widget_get_screen(widget));
+        warmup->scale = gtk_widget_get_scale_factor(widget);
+    }
+    else
+    {
+        theme = gtk_icon_theme_get_default();
+        warmup->scale = 1;
+    }
+
+    gtk_icon_size_lookup(GTK_ICON_SIZE_MENU, &width, &height);
+
+    menu_icon_set_theme(theme);
+
+    warmup->refcount = 1;
+    warmup->theme = g_object_ref(theme);
+    warmup->names = g_ptr_array_new();
+    warmup->size = MIN(width, height);
+    warmup->generation = menu_icon_generation;
+
+    return warmup;
+}
+
+/* Runs @warmup once the next frame of @widget is out; consumes @warmup */
+static void
+menu_icon_warmup_start(MenuIconWarmup *warmup,
+                       GtkWidget      *widget)
+{
+    if (warmup->names->len == 0)
+    {
+        menu_icon_warmup_unref(warmup);
+        return;
+    }
+
+    if (widget == NULL)
+    {
+        /* No frame to wait for; stay below the redraw priority */
+        g_idle_add_full(G_PRIORITY_LOW, menu_icon_warmup_idle, warmup,
+                        (GDestroyNotify) menu_icon_warmup_unref);
+        return;
+    }
+
+    GdkFrameClock *clock = gtk_widget_get_frame_clock(widget);
+
+    if (clock != NULL)
+        menu_icon_warmup_hook(warmup, clock);
+    else
+        g_signal_connect_data(widget, "realize",
+                              G_CALLBACK(menu_icon_warmup_realized),
+                              menu_icon_warmup_ref(warmup),
+                              menu_icon_warmup_closure_unref, G_CONNECT_AFTER);
+
+    menu_icon_warmup_unref(warmup);
+}
+
+/**
+ * mate_ui_menu_warm_icons:
+ * @widget: (nullable): A widget on the screen the menus will show on, or %NULL
+ * @submenus: (array length=n_submenus): Array of #MateUiSubmenu
+ * @n_submenus: Number of submenus
+ *
+ * Resolves and decodes the icons of @submenus at menu size and at the
+ * scale factor of @widget, on a worker thread, once the next frame of
+ * @widget has been painted; without @widget, once the main loop is
+ * idle. Menu items built afterwards use the decoded icons, so the
+ * first open of a menu does not wait for them. Items at another scale
+ * use the themed icons instead. Icons already cached are skipped, and
+ * the cache is dropped when the icon theme changes.
+ */
+void
+mate_ui_menu_warm_icons(GtkWidget           *widget,
+                        const MateUiSubmenu *submenus,
+                        gsize                n_submenus)
+{
+    g_return_if_fail(widget == NULL || GTK_IS_WIDGET(widget));
+    g_return_if_fail(submenus != NULL || n_submenus == 0);
+
+    MenuIconWarmup *warmup = menu_icon_warmup_new(widget);
+    GHashTable *seen = g_hash_table_new(NULL, NULL);
+
+    for (gsize i = 0; i < n_submenus; i++)
+    {
+        for (gsize j = 0; j < submenus[i].n_entries; j++)
+            menu_icon_warmup_add(warmup->names, seen, submenus[i].entries[j].icon_name);
+    }
+
+    g_hash_table_destroy(seen);
+    menu_icon_warmup_start(warmup, widget);
+}
+
+/**
+ * mate_ui_menu_warm_compiled_icons:
+ * @widget: (nullable): A widget on the screen the menus will show on, or %NULL
+ * @submenus: (array length=n_submenus): Array of #MateUiCompiledSubmenu
+ * @n_submenus: Number of submenus
+ *
+ * Like mate_ui_menu_warm_icons(), for tables generated by
+ * mateui-compile-ui.
+ */
+void
+mate_ui_menu_warm_compiled_icons(GtkWidget                   *widget,
+                                 const MateUiCompiledSubmenu *submenus,
+                                 gsize                        n_submenus)
+{
+    g_return_if_fail(widget == NULL || GTK_IS_WIDGET(widget));
+    g_return_if_fail(submenus != NULL || n_submenus == 0);
+
+    MenuIconWarmup *warmup = menu_icon_warmup_new(widget);
+    GHashTable *seen = g_hash_table_new(NULL, NULL);
+
+    for (gsize i = 0; i < n_submenus; i++)
+    {
+        for (gsize j = 0; j < submenus[i].n_entries; j++)
+            menu_icon_warmup_add(warmup->names, seen, submenus[i].entries[j].icon_name);
+    }
+
+    g_hash_table_destroy(seen);
+    menu_icon_warmup_start(warmup, widget);
+}
+
 /**
  * mate_ui_menu_item_new_with_icon:
  * @label: The menu item label
@@ -77,7 +538,7 @@ mate_ui_menu_item_new_with_icon(const gchar *label,
 
     if (icon_name != NULL)
     {
-        GtkWidget *image = gtk_image_new_from_icon_name(icon_name, GTK_ICON_SIZE_MENU);
+        GtkWidget *image = menu_icon_image_new(icon_name);
         gtk_box_pack_start(GTK_BOX(box), image, FALSE, FALSE, 0);
         gtk_widget_set_valign(image, GTK_ALIGN_CENTER);
         gtk_widget_set_margin_start(image, 0);
@@ -102,6 +563,64 @@ mate_ui_menu_item_new_with_icon(const gchar *label,
     return item;
 }
 
+static GtkWidget *
+menu_new(void)
+{
+    GtkWidget *menu = gtk_menu_new();
+#if GTK_CHECK_VERSION(4,0,0)
+#else
+    gtk_menu_set_reserve_toggle_size(GTK_MENU(menu), FALSE);
+#endif
+    return menu;
+}
+
+/* Builds one item of a menu; @key is 0 for items without an accelerator */
+static GtkWidget *
+menu_item_new_for_entry(const gchar     *label,
+                        const gchar     *action_name,
+                        const gchar     *icon_name,
+                        GtkAccelGroup   *accel_group,
+                        guint            key,
+                        GdkModifierType  mods)
+{
+    GtkWidget *item;
+
+    /* Check for separator */
+    if (label == NULL && action_name == NULL)
+        return gtk_separator_menu_item_new();
+
+    if (icon_name != NULL)
+        item = mate_ui_menu_item_new_with_icon(label, icon_name, action_name);
+    else
+        item = mate_ui_menu_item_new_with_action(label, action_name, NULL, NULL);
+
+    if (key != 0 && accel_group != NULL)
+    {
+        gtk_widget_add_accelerator(item, "activate", accel_group,
+                                    key, mods, GTK_ACCEL_VISIBLE);
+    }
+
+    return item;
+}
+
+static GtkWidget *
+menu_item_new_from_entry(const MateUiMenuEntry *entry,
+                         GtkAccelGroup         *accel_group)
+{
+    guint key = 0;
+    GdkModifierType mods = 0;
+
+    if (entry->accel != NULL && accel_group != NULL &&
+        !mate_ui_accel_parse(entry->accel, &key, &mods))
+        key = 0;
+
+    return menu_item_new_for_entry(entry->label,
+                                   entry->action_name,
+                                   entry->icon_name,
+                                   accel_group,
+                                   key, mods);
+}
+
 /**
  * mate_ui_menu_new_from_entries:
  * @entries: Array of #MateUiMenuEntry structures
@@ -119,46 +638,11 @@ mate_ui_menu_new_from_entries(const MateUiMenuEntry *entries,
 {
     g_return_val_if_fail(entries != NULL || n_entries == 0, NULL);
 
-    GtkWidget *menu = gtk_menu_new();
-#if GTK_CHECK_VERSION(4,0,0)
-#else
-    gtk_menu_set_reserve_toggle_size(GTK_MENU(menu), FALSE);
-#endif
+    GtkWidget *menu = menu_new();
 
     for (gsize i = 0; i < n_entries; i++)
     {
-        const MateUiMenuEntry *entry = &entries[i];
-        GtkWidget *item;
-
-        /* Check for separator */
-        if (entry->label == NULL && entry->action_name == NULL)
-        {
-            item = gtk_separator_menu_item_new();
-        }
-        else if (entry->icon_name != NULL)
-        {
-            item = mate_ui_menu_item_new_with_icon(entry->label,
-                                                    entry->icon_name,
-                                                    entry->action_name);
-            if (entry->accel != NULL && accel_group != NULL)
-            {
-                guint key;
-                GdkModifierType mods;
-                gtk_accelerator_parse(entry->accel, &key, &mods);
-                if (key != 0)
-                {
-                    gtk_widget_add_accelerator(item, "activate", accel_group,
-                                                key, mods, GTK_ACCEL_VISIBLE);
-                }
-            }
-        }
-        else
-        {
-            item = mate_ui_menu_item_new_with_action(entry->label,
-                                                      entry->action_name,
-                                                      accel_group,
-                                                      entry->accel);
-        }
+        GtkWidget *item = menu_item_new_from_entry(&entries[i], accel_group);
 
         gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
         gtk_widget_show(item);
@@ -203,138 +687,1578 @@ mate_ui_menu_bar_new_from_entries(const MateUiSubmenu *submenus,
     return menubar;
 }
 
-/**
- * mate_ui_menu_model_new_from_entries:
- * @submenus: Array of #MateUiSubmenu structures
- * @n_submenus: Number of submenus
+/*
+ * Incremental updates
  *
- * Creates a GMenuModel from an array of submenu definitions.
+ * Old and new descriptor tables are matched by key: the action name of
+ * an entry (or its label if it has none), the label of a submenu, and
+ * position order for separators. Matched items that did not change are
+ * left alone, with their accelerators and action bindings; everything
+ * else is inserted, replaced or removed in place.
  *
- * Returns: (transfer full): A new #GMenuModel
+ * Lazily built menubars are not supported. Their unopened submenus and
+ * their accelerator closures stay bound to the table they were built
+ * from, so they are marked and rejected.
  */
-GMenuModel *
-mate_ui_menu_model_new_from_entries(const MateUiSubmenu *submenus,
-                                     gsize                n_submenus)
-{
-    g_return_val_if_fail(submenus != NULL || n_submenus == 0, NULL);
+#define MENU_SEPARATOR_KEY "\n"
+#define MENU_LAZY_KEY "mate-ui-lazy-menubar"
 
-    GMenu *menubar = g_menu_new();
+/*
+ * Maps each new key to the first unused old position with that key.
+ * Returns an array of n_new old positions, -1 where nothing matched.
+ */
+static gint *
+menu_diff_match(const gchar **old_keys,
+                gsize         n_old,
+                const gchar **new_keys,
+                gsize         n_new)
+{
+    GHashTable *heads = g_hash_table_new(g_str_hash, g_str_equal);
+    gint *next = g_new(gint, MAX(n_old, 1));
+    gint *match = g_new(gint, MAX(n_new, 1));
 
-    for (gsize i = 0; i < n_submenus; i++)
+    /* Chains old positions with the same key, in order */
+    for (gsize i = n_old; i-- > 0; )
     {
-        const MateUiSubmenu *submenu = &submenus[i];
-        GMenu *menu = g_menu_new();
-
-        for (gsize j = 0; j < submenu->n_entries; j++)
-        {
-            const MateUiMenuEntry *entry = &submenu->entries[j];
+        gpointer head;
+        next[i] = g_hash_table_lookup_extended(heads, old_keys[i], NULL, &head) ?
+                  GPOINTER_TO_INT(head) - 1 : -1;
+        g_hash_table_insert(heads, (gpointer) old_keys[i], GINT_TO_POINTER(i + 1));
+    }
 
-            /* Check for separator */
-            if (entry->label == NULL && entry->action_name == NULL)
-            {
-                /* GMenu doesn't have explicit separators; create a section break */
-                GMenu *section = g_menu_new();
-                g_menu_append_section(menu, NULL, G_MENU_MODEL(section));
-                g_object_unref(section);
-            }
-            else
-            {
-                /* Remove mnemonic underscore for GMenu */
-                gchar *label = g_strdup(entry->label);
-                gchar *p = label;
-                gchar *q = label;
-                while (*p)
-                {
-                    if (*p != '_')
-                        *q++ = *p;
-                    p++;
-                }
-                *q = '\0';
-
-                GMenuItem *item = g_menu_item_new(label, entry->action_name);
-                g_free(label);
-
-                if (entry->icon_name != NULL)
-                {
-                    GIcon *icon = g_themed_icon_new(entry->icon_name);
-                    g_menu_item_set_icon(item, icon);
-                    g_object_unref(icon);
-                }
-
-                if (entry->accel != NULL)
-                {
-                    g_menu_item_set_attribute(item, "accel", "s", entry->accel);
-                }
-
-                g_menu_append_item(menu, item);
-                g_object_unref(item);
-            }
-        }
+    for (gsize i = 0; i < n_new; i++)
+    {
+        gpointer head;
 
-        /* Remove mnemonic underscore from submenu label */
-        gchar *sublabel = g_strdup(submenu->label);
-        gchar *p = sublabel;
-        gchar *q = sublabel;
-        while (*p)
+        match[i] = -1;
+        if (g_hash_table_lookup_extended(heads, new_keys[i], NULL, &head))
         {
-            if (*p != '_')
-                *q++ = *p;
-            p++;
+            match[i] = GPOINTER_TO_INT(head) - 1;
+            if (match[i] >= 0)
+                g_hash_table_insert(heads, (gpointer) new_keys[i],
+                                    GINT_TO_POINTER(next[match[i]] + 1));
         }
-        *q = '\0';
-
-        g_menu_append_submenu(menubar, sublabel, G_MENU_MODEL(menu));
-        g_free(sublabel);
-        g_object_unref(menu);
     }
 
-    return G_MENU_MODEL(menubar);
+    g_free(next);
+    g_hash_table_unref(heads);
+
+    return match;
 }
 
-/**
- * mate_ui_menu_add_recent_chooser:
- * @menu: A #GtkMenu
- * @label: The submenu label
- * @filter: (nullable): A #GtkRecentFilter or %NULL
- * @callback: Callback when a recent item is activated
- * @user_data: User data for callback
- *
- * Adds a recent files submenu to the given menu.
- *
- * Returns: (transfer none): The recent chooser menu item
- */
-GtkWidget *
-mate_ui_menu_add_recent_chooser(GtkMenu         *menu,
-                                 const gchar     *label,
-                                 GtkRecentFilter *filter,
-                                 GCallback        callback,
-                                 gpointer         user_data)
+static const gchar *
+menu_entry_key(const MateUiMenuEntry *entry)
 {
-    g_return_val_if_fail(GTK_IS_MENU(menu), NULL);
-    g_return_val_if_fail(label != NULL, NULL);
+    if (entry->action_name != NULL)
+        return entry->action_name;
+
+    return entry->label ? entry->label : MENU_SEPARATOR_KEY;
+}
+
+static void
+menu_item_disconnect_accels(GtkWidget *item)
+{
+    GList *closures = gtk_widget_list_accel_closures(item);
+
+    for (GList *l = closures; l != NULL; l = l->next)
+    {
+        GtkAccelGroup *accel_group = gtk_accel_group_from_accel_closure(l->data);
+        if (accel_group != NULL)
+            gtk_accel_group_disconnect(accel_group, l->data);
+    }
+
+    g_list_free(closures);
+}
+
+static void
+menu_item_disconnect_accels_cb(GtkWidget *item,
+                               gpointer   user_data G_GNUC_UNUSED)
+{
+    menu_item_disconnect_accels(item);
+}
+
+static void
+menu_item_destroy(GtkWidget *item)
+{
+    menu_item_disconnect_accels(item);
+    gtk_widget_destroy(item);
+}
+
+/* Moves or inserts @child at @position, keeping @current in step */
+static void
+menu_shell_place(GtkMenuShell *shell,
+                 GPtrArray    *current,
+                 GtkWidget    *child,
+                 guint         position)
+{
+    if (position < current->len && g_ptr_array_index(current, position) == child)
+        return;
+
+    if (g_ptr_array_remove(current, child))
+    {
+        if (GTK_IS_MENU(shell))
+        {
+            gtk_menu_reorder_child(GTK_MENU(shell), child, position);
+        }
+        else
+        {
+            g_object_ref(child);
+            gtk_container_remove(GTK_CONTAINER(shell), child);
+            gtk_menu_shell_insert(shell, child, position);
+            g_object_unref(child);
+        }
+    }
+    else
+    {
+        gtk_menu_shell_insert(shell, child, position);
+        gtk_widget_show(child);
+    }
+
+    g_ptr_array_insert(current, position, child);
+}
+
+static GPtrArray *
+menu_shell_get_items(GtkMenuShell *shell,
+                     gsize         n_expected)
+{
+    GList *children = gtk_container_get_children(GTK_CONTAINER(shell));
+    GPtrArray *items = g_ptr_array_sized_new(n_expected);
+
+    for (GList *l = children; l != NULL; l = l->next)
+        g_ptr_array_add(items, l->data);
+    g_list_free(children);
+
+    if (items->len != n_expected)
+    {
+        g_warning("Menu has %u items but its old descriptor table has %" G_GSIZE_FORMAT
+                  "; it was not built from that table", items->len, n_expected);
+        g_ptr_array_free(items, TRUE);
+        return NULL;
+    }
+
+    return items;
+}
+
+/* Updates @item for @entry in place if only the accelerator changed */
+static gboolean
+menu_item_update(GtkWidget             *item,
+                 const MateUiMenuEntry *old_entry,
+                 const MateUiMenuEntry *new_entry,
+                 GtkAccelGroup         *accel_group)
+{
+    if (g_strcmp0(old_entry->label, new_entry->label) != 0 ||
+        g_strcmp0(old_entry->action_name, new_entry->action_name) != 0 ||
+        g_strcmp0(old_entry->icon_name, new_entry->icon_name) != 0)
+        return FALSE;
+
+    if (g_strcmp0(old_entry->accel, new_entry->accel) == 0)
+        return TRUE;
+
+    guint key;
+    GdkModifierType mods;
+
+    menu_item_disconnect_accels(item);
+
+    if (new_entry->accel != NULL && accel_group != NULL &&
+        mate_ui_accel_parse(new_entry->accel, &key, &mods))
+        gtk_widget_add_accelerator(item, "activate", accel_group,
+                                    key, mods, GTK_ACCEL_VISIBLE);
+
+    return TRUE;
+}
+
+static void
+menu_update_entries(GtkMenuShell          *menu,
+                    const MateUiMenuEntry *old_entries,
+                    gsize                  n_old,
+                    const MateUiMenuEntry *new_entries,
+                    gsize                  n_new,
+                    GtkAccelGroup         *accel_group)
+{
+    if (old_entries == new_entries && n_old == n_new)
+        return;
+
+    GPtrArray *current = menu_shell_get_items(menu, n_old);
+    if (current == NULL)
+        return;
+
+    const gchar **old_keys = g_new(const gchar *, MAX(n_old, 1));
+    const gchar **new_keys = g_new(const gchar *, MAX(n_new, 1));
+
+    for (gsize i = 0; i < n_old; i++)
+        old_keys[i] = menu_entry_key(&old_entries[i]);
+    for (gsize i = 0; i < n_new; i++)
+        new_keys[i] = menu_entry_key(&new_entries[i]);
+
+    gint *match = menu_diff_match(old_keys, n_old, new_keys, n_new);
+    GtkWidget **items = g_new0(GtkWidget *, MAX(n_new, 1));
+    gboolean *kept = g_new0(gboolean, MAX(n_old, 1));
+
+    for (gsize i = 0; i < n_new; i++)
+    {
+        if (match[i] < 0)
+            continue;
+
+        GtkWidget *item = g_ptr_array_index(current, match[i]);
+        if (menu_item_update(item, &old_entries[match[i]], &new_entries[i], accel_group))
+        {
+            items[i] = item;
+            kept[match[i]] = TRUE;
+        }
+    }
+
+    for (gsize i = 0; i < n_old; i++)
+    {
+        if (kept[i])
+            continue;
+
+        GtkWidget *item = g_ptr_array_index(current, i);
+        g_ptr_array_remove(current, item);
+        menu_item_destroy(item);
+    }
+
+    for (gsize i = 0; i < n_new; i++)
+    {
+        if (items[i] == NULL)
+            items[i] = menu_item_new_from_entry(&new_entries[i], accel_group);
+
+        menu_shell_place(menu, current, items[i], i);
+    }
+
+    g_free(kept);
+    g_free(items);
+    g_free(match);
+    g_free(new_keys);
+    g_free(old_keys);
+    g_ptr_array_free(current, TRUE);
+}
+
+/**
+ * mate_ui_menu_bar_update_from_entries:
+ * @menubar: A #GtkMenuBar built by mate_ui_menu_bar_new_from_entries()
+ * @old_submenus: The table @menubar currently reflects
+ * @n_old: Number of old submenus
+ * @new_submenus: The table to update @menubar to
+ * @n_new: Number of new submenus
+ * @accel_group: (nullable): The accelerator group @menubar was built with
+ *
+ * Updates a menubar in place from @old_submenus to @new_submenus. Only
+ * the items that differ are inserted, removed or rebuilt; unchanged
+ * items keep their widgets, accelerators and action bindings, and an
+ * item whose accelerator alone changed only has that accelerator
+ * replaced. Entries are matched by action name, submenus by label.
+ *
+ * Submenus whose entry table pointer and size are unchanged are skipped
+ * without being compared.
+ *
+ * Menubars from mate_ui_menu_bar_new_from_entries_lazy() cannot be
+ * updated; build a new one and replace the old one instead.
+ */
+void
+mate_ui_menu_bar_update_from_entries(GtkWidget           *menubar,
+                                      const MateUiSubmenu *old_submenus,
+                                      gsize                n_old,
+                                      const MateUiSubmenu *new_submenus,
+                                      gsize                n_new,
+                                      GtkAccelGroup       *accel_group)
+{
+    g_return_if_fail(GTK_IS_MENU_BAR(menubar));
+    g_return_if_fail(g_object_get_data(G_OBJECT(menubar), MENU_LAZY_KEY) == NULL);
+    g_return_if_fail(old_submenus != NULL || n_old == 0);
+    g_return_if_fail(new_submenus != NULL || n_new == 0);
+
+    GtkMenuShell *shell = GTK_MENU_SHELL(menubar);
+    GPtrArray *current = menu_shell_get_items(shell, n_old);
+    if (current == NULL)
+        return;
+
+    const gchar **old_keys = g_new(const gchar *, MAX(n_old, 1));
+    const gchar **new_keys = g_new(const gchar *, MAX(n_new, 1));
+
+    for (gsize i = 0; i < n_old; i++)
+        old_keys[i] = old_submenus[i].label;
+    for (gsize i = 0; i < n_new; i++)
+        new_keys[i] = new_submenus[i].label;
+
+    gint *match = menu_diff_match(old_keys, n_old, new_keys, n_new);
+    GtkWidget **items = g_new0(GtkWidget *, MAX(n_new, 1));
+    gboolean *kept = g_new0(gboolean, MAX(n_old, 1));
+
+    for (gsize i = 0; i < n_new; i++)
+    {
+        if (match[i] < 0)
+            continue;
+
+        const MateUiSubmenu *old_submenu = &old_submenus[match[i]];
+        const MateUiSubmenu *new_submenu = &new_submenus[i];
+        GtkWidget *item = g_ptr_array_index(current, match[i]);
+
+        menu_update_entries(GTK_MENU_SHELL(gtk_menu_item_get_submenu(GTK_MENU_ITEM(item))),
+                            old_submenu->entries, old_submenu->n_entries,
+                            new_submenu->entries, new_submenu->n_entries,
+                            accel_group);
+
+        items[i] = item;
+        kept[match[i]] = TRUE;
+    }
+
+    for (gsize i = 0; i < n_old; i++)
+    {
+        if (kept[i])
+            continue;
+
+        GtkWidget *item = g_ptr_array_index(current, i);
+        GtkWidget *menu = gtk_menu_item_get_submenu(GTK_MENU_ITEM(item));
+
+        if (menu != NULL)
+            gtk_container_foreach(GTK_CONTAINER(menu), menu_item_disconnect_accels_cb, NULL);
+
+        g_ptr_array_remove(current, item);
+        menu_item_destroy(item);
+    }
+
+    for (gsize i = 0; i < n_new; i++)
+    {
+        if (items[i] == NULL)
+        {
+            const MateUiSubmenu *submenu = &new_submenus[i];
+
+            items[i] = gtk_menu_item_new_with_mnemonic(submenu->label);
+            gtk_menu_item_set_submenu(GTK_MENU_ITEM(items[i]),
+                                      mate_ui_menu_new_from_entries(submenu->entries,
+                                                                    submenu->n_entries,
+                                                                    accel_group));
+        }
+
+        menu_shell_place(shell, current, items[i], i);
+    }
+
+    g_free(kept);
+    g_free(items);
+    g_free(match);
+    g_free(new_keys);
+    g_free(old_keys);
+    g_ptr_array_free(current, TRUE);
+}
+
+/*
+ * Lazy menubars
+ *
+ * Each top-level item starts with an empty menu and keeps a pointer to
+ * its descriptor; the items are built the first time the menu is
+ * selected or shown. Accelerators are connected up front, one closure
+ * each, so shortcuts work before any menu has been opened. The menubar
+ * owns those closures and disconnects them when it is destroyed.
+ */
+#define LAZY_SUBMENU_KEY "mate-ui-lazy-submenu"
+#define LAZY_ACCELS_KEY "mate-ui-lazy-accels"
+
+typedef struct
+{
+    GtkAccelGroup *accel_group;
+    GPtrArray     *closures;
+} LazyAccels;
+
+static void
+menu_lazy_accels_free(gpointer data)
+{
+    LazyAccels *accels = data;
+
+    for (guint i = 0; i < accels->closures->len; i++)
+        gtk_accel_group_disconnect(accels->accel_group, g_ptr_array_index(accels->closures, i));
+
+    g_ptr_array_free(accels->closures, TRUE);
+    g_object_unref(accels->accel_group);
+    g_free(accels);
+}
+
+static void
+menu_lazy_menubar_destroyed(GtkWidget *menubar,
+                            gpointer   user_data G_GNUC_UNUSED)
+{
+    g_object_set_data(G_OBJECT(menubar), LAZY_ACCELS_KEY, NULL);
+}
+
+/* Finds the action group for the "app." or "win." prefix of @action_name */
+static GActionGroup *
+menu_find_action_group(GObject      *acceleratable,
+                       const gchar  *action_name,
+                       const gchar **name)
+{
+    const gchar *dot = strchr(action_name, '.');
+    if (dot == NULL || !GTK_IS_WINDOW(acceleratable))
+        return NULL;
+
+    *name = dot + 1;
+
+    if (dot - action_name == 3 && strncmp(action_name, "win", 3) == 0 &&
+        GTK_IS_APPLICATION_WINDOW(acceleratable))
+        return G_ACTION_GROUP(acceleratable);
+
+    if (dot - action_name == 3 && strncmp(action_name, "app", 3) == 0)
+    {
+        GtkApplication *app = gtk_window_get_application(GTK_WINDOW(acceleratable));
+        return app ? G_ACTION_GROUP(app) : NULL;
+    }
+
+    gchar *prefix = g_strndup(action_name, dot - action_name);
+    GActionGroup *group = gtk_widget_get_action_group(GTK_WIDGET(acceleratable), prefix);
+    g_free(prefix);
+
+    return group;
+}
+
+static gboolean
+menu_lazy_accel_activate(GtkAccelGroup   *accel_group G_GNUC_UNUSED,
+                         GObject         *acceleratable,
+                         guint            keyval G_GNUC_UNUSED,
+                         GdkModifierType  modifier G_GNUC_UNUSED,
+                         gpointer         user_data)
+{
+    const gchar *name;
+    GActionGroup *group = menu_find_action_group(acceleratable, user_data, &name);
+
+    if (group == NULL || !g_action_group_get_action_enabled(group, name))
+        return FALSE;
+
+    g_action_group_activate_action(group, name, NULL);
+    return TRUE;
+}
+
+static void
+menu_lazy_populate(GtkMenuItem *menu_item)
+{
+    const MateUiSubmenu *submenu = g_object_get_data(G_OBJECT(menu_item), LAZY_SUBMENU_KEY);
+    if (submenu == NULL)
+        return;
+
+    g_object_set_data(G_OBJECT(menu_item), LAZY_SUBMENU_KEY, NULL);
+
+    GtkWidget *menu = gtk_menu_item_get_submenu(menu_item);
+
+    for (gsize i = 0; i < submenu->n_entries; i++)
+    {
+        const MateUiMenuEntry *entry = &submenu->entries[i];
+        GtkWidget *item = menu_item_new_for_entry(entry->label,
+                                                  entry->action_name,
+                                                  entry->icon_name,
+                                                  NULL, 0, 0);
+
+        /* The accelerator is already connected; only show it */
+        GtkWidget *child = gtk_bin_get_child(GTK_BIN(item));
+        guint key;
+        GdkModifierType mods;
+
+        if (entry->accel != NULL && GTK_IS_ACCEL_LABEL(child) &&
+            mate_ui_accel_parse(entry->accel, &key, &mods))
+            gtk_accel_label_set_accel(GTK_ACCEL_LABEL(child), key, mods);
+
+        gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+        gtk_widget_show(item);
+    }
+}
+
+static void
+menu_lazy_selected(GtkMenuItem *menu_item,
+                   gpointer     user_data G_GNUC_UNUSED)
+{
+    menu_lazy_populate(menu_item);
+}
+
+static void
+menu_lazy_shown(GtkWidget *menu G_GNUC_UNUSED,
+                gpointer   user_data)
+{
+    menu_lazy_populate(user_data);
+}
+
+/**
+ * mate_ui_menu_bar_new_from_entries_lazy:
+ * @submenus: Array of #MateUiSubmenu structures
+ * @n_submenus: Number of submenus
+ * @accel_group: (nullable): Accelerator group to attach, or %NULL
+ *
+ * Creates a GtkMenuBar like mate_ui_menu_bar_new_from_entries(), but
+ * only builds each submenu when it is first opened. Accelerators are
+ * added to @accel_group immediately and activate their action on the
+ * window @accel_group is attached to. They are removed from
+ * @accel_group again when the menubar is destroyed.
+ *
+ * @submenus and the entries they point to are used after this returns,
+ * so they must outlive the menubar; static tables do.
+ *
+ * Returns: (transfer full): A new #GtkMenuBar
+ */
+GtkWidget *
+mate_ui_menu_bar_new_from_entries_lazy(const MateUiSubmenu *submenus,
+                                        gsize                n_submenus,
+                                        GtkAccelGroup       *accel_group)
+{
+    g_return_val_if_fail(submenus != NULL || n_submenus == 0, NULL);
+
+    GtkWidget *menubar = gtk_menu_bar_new();
+    LazyAccels *accels = NULL;
+
+    g_object_set_data(G_OBJECT(menubar), MENU_LAZY_KEY, GINT_TO_POINTER(TRUE));
+
+    if (accel_group != NULL)
+    {
+        accels = g_new0(LazyAccels, 1);
+        accels->accel_group = g_object_ref(accel_group);
+        accels->closures = g_ptr_array_new_with_free_func((GDestroyNotify) g_closure_unref);
+
+        g_object_set_data_full(G_OBJECT(menubar), LAZY_ACCELS_KEY, accels, menu_lazy_accels_free);
+        g_signal_connect(menubar, "destroy", G_CALLBACK(menu_lazy_menubar_destroyed), NULL);
+    }
+
+    for (gsize i = 0; i < n_submenus; i++)
+    {
+        const MateUiSubmenu *submenu = &submenus[i];
+
+        GtkWidget *menu_item = gtk_menu_item_new_with_mnemonic(submenu->label);
+        GtkWidget *menu = menu_new();
+
+        g_object_set_data(G_OBJECT(menu_item), LAZY_SUBMENU_KEY, (gpointer) submenu);
+        g_signal_connect(menu_item, "select", G_CALLBACK(menu_lazy_selected), NULL);
+        g_signal_connect(menu, "show", G_CALLBACK(menu_lazy_shown), menu_item);
+
+        for (gsize j = 0; accel_group != NULL && j < submenu->n_entries; j++)
+        {
+            const MateUiMenuEntry *entry = &submenu->entries[j];
+            guint key;
+            GdkModifierType mods;
+
+            if (entry->accel == NULL || entry->action_name == NULL ||
+                !mate_ui_accel_parse(entry->accel, &key, &mods))
+                continue;
+
+            GClosure *closure = g_cclosure_new(G_CALLBACK(menu_lazy_accel_activate),
+                                               (gpointer) g_intern_string(entry->action_name),
+                                               NULL);
+            g_ptr_array_add(accels->closures, g_closure_ref(closure));
+            gtk_accel_group_connect(accel_group, key, mods, GTK_ACCEL_VISIBLE, closure);
+        }
+
+        gtk_menu_item_set_submenu(GTK_MENU_ITEM(menu_item), menu);
+        gtk_menu_shell_append(GTK_MENU_SHELL(menubar), menu_item);
+        gtk_widget_show(menu_item);
+    }
+
+    return menubar;
+}
+
+/*
+ * Menu models
+ *
+ * Shared models are built once per descriptor table: every call for the
+ * same table returns the same frozen GMenu. The cache is keyed by the
+ * table address and checked against a hash of the table contents, so a
+ * table freed and reallocated at the same address is rebuilt. Separators
+ * start a new section, labels are interned and icons are shared by name.
+ */
+typedef struct
+{
+    gsize       n_submenus;
+    guint64     hash;
+    GMenuModel *model;
+} MenuModelCacheEntry;
+
+static GHashTable *menu_model_cache = NULL;   /* descriptor table -> MenuModelCacheEntry */
+static GHashTable *menu_icon_cache = NULL;    /* interned icon name -> GIcon */
+
+static void
+menu_model_cache_entry_free(gpointer data)
+{
+    MenuModelCacheEntry *entry = data;
+
+    g_object_unref(entry->model);
+    g_free(entry);
+}
+
+/* FNV-1a over @str, with NULL distinct from "" */
+static guint64
+menu_model_hash_string(guint64      hash,
+                       const gchar *str)
+{
+    if (str == NULL)
+        return (hash ^ 0xff) * G_GUINT64_CONSTANT(1099511628211);
+
+    for (; *str != '\0'; str++)
+        hash = (hash ^ (guchar) *str) * G_GUINT64_CONSTANT(1099511628211);
+
+    return (hash ^ 0xfe) * G_GUINT64_CONSTANT(1099511628211);
+}
+
+static guint64
+menu_model_hash_entries(const MateUiSubmenu *submenus,
+                        gsize                n_submenus)
+{
+    guint64 hash = G_GUINT64_CONSTANT(14695981039346656037);
+
+    for (gsize i = 0; i < n_submenus; i++)
+    {
+        hash = menu_model_hash_string(hash, submenus[i].label);
+
+        for (gsize j = 0; j < submenus[i].n_entries; j++)
+        {
+            const MateUiMenuEntry *entry = &submenus[i].entries[j];
+
+            hash = menu_model_hash_string(hash, entry->label);
+            hash = menu_model_hash_string(hash, entry->action_name);
+            hash = menu_model_hash_string(hash, entry->accel);
+            hash = menu_model_hash_string(hash, entry->icon_name);
+        }
+    }
+
+    return hash;
+}
+
+static guint64
+menu_model_hash_compiled(const MateUiCompiledSubmenu *submenus,
+                         gsize                        n_submenus)
+{
+    guint64 hash = G_GUINT64_CONSTANT(14695981039346656037);
+
+    for (gsize i = 0; i < n_submenus; i++)
+    {
+        hash = menu_model_hash_string(hash, submenus[i].plain_label);
+
+        for (gsize j = 0; j < submenus[i].n_entries; j++)
+        {
+            const MateUiCompiledMenuEntry *entry = &submenus[i].entries[j];
+
+            hash = menu_model_hash_string(hash, entry->plain_label);
+            hash = menu_model_hash_string(hash, entry->action_name);
+            hash = menu_model_hash_string(hash, entry->accel);
+            hash = menu_model_hash_string(hash, entry->icon_name);
+        }
+    }
+
+    return hash;
+}
+
+static GMenuModel *
+menu_model_cache_lookup(gconstpointer table,
+                        gsize         n_submenus,
+                        guint64       hash)
+{
+    if (menu_model_cache == NULL)
+        return NULL;
+
+    MenuModelCacheEntry *entry = g_hash_table_lookup(menu_model_cache, table);
+    if (entry == NULL || entry->n_submenus != n_submenus || entry->hash != hash)
+        return NULL;
+
+    return g_object_ref(entry->model);
+}
+
+/* Replaces any stale model of @table */
+static GMenuModel *
+menu_model_cache_insert(gconstpointer  table,
+                        gsize          n_submenus,
+                        guint64        hash,
+                        GMenu         *menubar)
+{
+    if (menu_model_cache == NULL)
+        menu_model_cache = g_hash_table_new_full(NULL, NULL, NULL, menu_model_cache_entry_free);
+
+    g_menu_freeze(menubar);
+
+    MenuModelCacheEntry *entry = g_new0(MenuModelCacheEntry, 1);
+    entry->n_submenus = n_submenus;
+    entry->hash = hash;
+    entry->model = g_object_ref(G_MENU_MODEL(menubar));
+    g_hash_table_replace(menu_model_cache, (gpointer) table, entry);
+
+    return G_MENU_MODEL(menubar);
+}
+
+static GIcon *
+menu_model_get_icon(const gchar *icon_name)
+{
+    const gchar *interned = g_intern_string(icon_name);
+
+    if (menu_icon_cache == NULL)
+        menu_icon_cache = g_hash_table_new_full(NULL, NULL, NULL, g_object_unref);
+
+    GIcon *icon = g_hash_table_lookup(menu_icon_cache, interned);
+    if (icon == NULL)
+    {
+        icon = g_themed_icon_new(interned);
+        g_hash_table_insert(menu_icon_cache, (gpointer) interned, icon);
+    }
+
+    return icon;
+}
+
+/* Interns @label without its mnemonic underscores; "__" is a literal one */
+static const gchar *
+menu_model_intern_label(const gchar *label)
+{
+    gsize length = strlen(label);
+    gchar *plain = g_alloca(length + 1);
+    gchar *q = plain;
+
+    for (const gchar *p = label; *p != '\0'; p++)
+    {
+        if (*p == '_')
+        {
+            if (p[1] != '_')
+                continue;
+            p++;
+        }
+        *q++ = *p;
+    }
+    *q = '\0';
+
+    return g_intern_string(plain);
+}
+
+/*
+ * Builds submenus as a sequence of sections, so each separator becomes a
+ * section boundary instead of an empty section between items
+ */
+typedef struct
+{
+    GMenu    *menu;
+    GMenu    *section;
+    gboolean  freeze;
+} MenuModelBuilder;
+
+static void
+menu_model_builder_start(MenuModelBuilder *builder,
+                         gboolean          freeze)
+{
+    builder->menu = g_menu_new();
+    builder->section = NULL;
+    builder->freeze = freeze;
+}
+
+static void
+menu_model_builder_flush(MenuModelBuilder *builder)
+{
+    if (builder->section == NULL)
+        return;
+
+    if (builder->freeze)
+        g_menu_freeze(builder->section);
+    g_menu_append_section(builder->menu, NULL, G_MENU_MODEL(builder->section));
+    g_object_unref(builder->section);
+    builder->section = NULL;
+}
+
+static void
+menu_model_builder_add(MenuModelBuilder *builder,
+                       const gchar      *label,
+                       const gchar      *action_name,
+                       const gchar      *accel,
+                       const gchar      *icon_name)
+{
+    /* Check for separator */
+    if (label == NULL && action_name == NULL)
+    {
+        menu_model_builder_flush(builder);
+        return;
+    }
+
+    if (builder->section == NULL)
+        builder->section = g_menu_new();
+
+    GMenuItem *item = g_menu_item_new(label, action_name);
+
+    if (icon_name != NULL)
+        g_menu_item_set_icon(item, menu_model_get_icon(icon_name));
+
+    if (accel != NULL)
+        g_menu_item_set_attribute(item, "accel", "s", accel);
+
+    g_menu_append_item(builder->section, item);
+    g_object_unref(item);
+}
+
+static void
+menu_model_builder_finish(MenuModelBuilder *builder,
+                          GMenu            *menubar,
+                          const gchar      *label)
+{
+    menu_model_builder_flush(builder);
+    if (builder->freeze)
+        g_menu_freeze(builder->menu);
+    g_menu_append_submenu(menubar, label, G_MENU_MODEL(builder->menu));
+    g_object_unref(builder->menu);
+}
+
+static GMenu *
+menu_model_build_from_entries(const MateUiSubmenu *submenus,
+                              gsize                n_submenus,
+                              gboolean             freeze)
+{
+    GMenu *menubar = g_menu_new();
+
+    for (gsize i = 0; i < n_submenus; i++)
+    {
+        const MateUiSubmenu *submenu = &submenus[i];
+        MenuModelBuilder builder;
+
+        menu_model_builder_start(&builder, freeze);
+
+        for (gsize j = 0; j < submenu->n_entries; j++)
+        {
+            const MateUiMenuEntry *entry = &submenu->entries[j];
+
+            menu_model_builder_add(&builder,
+                                   entry->label ? menu_model_intern_label(entry->label) : NULL,
+                                   entry->action_name,
+                                   entry->accel,
+                                   entry->icon_name);
+        }
+
+        menu_model_builder_finish(&builder, menubar, menu_model_intern_label(submenu->label));
+    }
+
+    return menubar;
+}
+
+/**
+ * mate_ui_menu_model_new_from_entries:
+ * @submenus: Array of #MateUiSubmenu structures
+ * @n_submenus: Number of submenus
+ *
+ * Creates a GMenuModel from an array of submenu definitions. Separators
+ * split a submenu into sections.
+ *
+ * Returns: (transfer full): A new #GMenuModel
+ */
+GMenuModel *
+mate_ui_menu_model_new_from_entries(const MateUiSubmenu *submenus,
+                                     gsize                n_submenus)
+{
+    g_return_val_if_fail(submenus != NULL || n_submenus == 0, NULL);
+
+    return G_MENU_MODEL(menu_model_build_from_entries(submenus, n_submenus, FALSE));
+}
+
+/**
+ * mate_ui_menu_model_get_shared:
+ * @submenus: Array of #MateUiSubmenu structures
+ * @n_submenus: Number of submenus
+ *
+ * Gets a GMenuModel for @submenus like
+ * mate_ui_menu_model_new_from_entries(), but builds it only once and
+ * shares it with later calls for the same table, as long as the table
+ * contents are unchanged. The model is frozen and must not be modified.
+ *
+ * Returns: (transfer full): A shared #GMenuModel
+ */
+GMenuModel *
+mate_ui_menu_model_get_shared(const MateUiSubmenu *submenus,
+                              gsize                n_submenus)
+{
+    g_return_val_if_fail(submenus != NULL || n_submenus == 0, NULL);
+
+    guint64 hash = menu_model_hash_entries(submenus, n_submenus);
+    GMenuModel *model = menu_model_cache_lookup(submenus, n_submenus, hash);
+    if (model != NULL)
+        return model;
+
+    return menu_model_cache_insert(submenus, n_submenus, hash,
+                                   menu_model_build_from_entries(submenus, n_submenus, TRUE));
+}
+
+/**
+ * mate_ui_menu_model_invalidate:
+ * @submenus: (nullable): A table passed to mate_ui_menu_model_get_shared()
+ *   or mate_ui_menu_model_new_from_compiled(), or %NULL for all tables
+ *
+ * Drops the shared model of @submenus, so the next call builds a new
+ * one. Models already handed out stay valid.
+ */
+void
+mate_ui_menu_model_invalidate(gconstpointer submenus)
+{
+    if (menu_model_cache == NULL)
+        return;
+
+    if (submenus == NULL)
+        g_hash_table_remove_all(menu_model_cache);
+    else
+        g_hash_table_remove(menu_model_cache, submenus);
+}
+
+/**
+ * mate_ui_menu_bar_new_from_compiled:
+ * @submenus: Array of #MateUiCompiledSubmenu generated by mateui-compile-ui
+ * @n_submenus: Number of submenus
+ * @accel_group: (nullable): Accelerator group to attach, or %NULL
+ *
+ * Creates a GtkMenuBar from compiled submenus. Accelerators were parsed
+ * at build time, so none are parsed here.
+ *
+ * Returns: (transfer full): A new #GtkMenuBar
+ */
+GtkWidget *
+mate_ui_menu_bar_new_from_compiled(const MateUiCompiledSubmenu *submenus,
+                                    gsize                        n_submenus,
+                                    GtkAccelGroup               *accel_group)
+{
+    g_return_val_if_fail(submenus != NULL || n_submenus == 0, NULL);
+
+    GtkWidget *menubar = gtk_menu_bar_new();
+
+    for (gsize i = 0; i < n_submenus; i++)
+    {
+        const MateUiCompiledSubmenu *submenu = &submenus[i];
+
+        if (submenu->label == NULL)
+            continue;
+
+        GtkWidget *menu_item = gtk_menu_item_new_with_mnemonic(submenu->label);
+        GtkWidget *menu = menu_new();
+
+        for (gsize j = 0; j < submenu->n_entries; j++)
+        {
+            const MateUiCompiledMenuEntry *entry = &submenu->entries[j];
+            GtkWidget *item = menu_item_new_for_entry(entry->label,
+                                                      entry->action_name,
+                                                      entry->icon_name,
+                                                      accel_group,
+                                                      entry->key, entry->mods);
+
+            gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+            gtk_widget_show(item);
+        }
+
+        gtk_menu_item_set_submenu(GTK_MENU_ITEM(menu_item), menu);
+        gtk_menu_shell_append(GTK_MENU_SHELL(menubar), menu_item);
+        gtk_widget_show(menu_item);
+    }
+
+    return menubar;
+}
+
+/**
+ * mate_ui_menu_model_new_from_compiled:
+ * @submenus: Array of #MateUiCompiledSubmenu generated by mateui-compile-ui
+ * @n_submenus: Number of submenus
+ *
+ * Creates a GMenuModel from compiled submenus, using the labels the
+ * compiler already stripped of mnemonics. Like
+ * mate_ui_menu_model_get_shared(), the model is shared and frozen.
+ *
+ * Returns: (transfer full): A #GMenuModel
+ */
+GMenuModel *
+mate_ui_menu_model_new_from_compiled(const MateUiCompiledSubmenu *submenus,
+                                      gsize                        n_submenus)
+{
+    g_return_val_if_fail(submenus != NULL || n_submenus == 0, NULL);
+
+    guint64 hash = menu_model_hash_compiled(submenus, n_submenus);
+    GMenuModel *model = menu_model_cache_lookup(submenus, n_submenus, hash);
+    if (model != NULL)
+        return model;
+
+    GMenu *menubar = g_menu_new();
+
+    for (gsize i = 0; i < n_submenus; i++)
+    {
+        const MateUiCompiledSubmenu *submenu = &submenus[i];
+        MenuModelBuilder builder;
+
+        if (submenu->label == NULL)
+            continue;
+
+        menu_model_builder_start(&builder, TRUE);
+
+        for (gsize j = 0; j < submenu->n_entries; j++)
+        {
+            const MateUiCompiledMenuEntry *entry = &submenu->entries[j];
+
+            menu_model_builder_add(&builder,
+                                   entry->plain_label ? g_intern_static_string(entry->plain_label) : NULL,
+                                   entry->action_name,
+                                   entry->accel,
+                                   entry->icon_name);
+        }
+
+        menu_model_builder_finish(&builder, menubar, g_intern_static_string(submenu->plain_label));
+    }
+
+    return menu_model_cache_insert(submenus, n_submenus, hash, menubar);
+}
+
+/**
+ * mate_ui_menu_add_recent_chooser:
+ * @menu: A #GtkMenu
+ * @label: The submenu label
+ * @filter: (nullable): A #GtkRecentFilter or %NULL
+ * @callback: Callback when a recent item is activated
+ * @user_data: User data for callback
+ *
+ * Adds a recent files submenu to the given menu. This uses the default
+ * #GtkRecentManager, which parses the whole recent items file on the
+ * calling thread; mate_ui_menu_add_recent_items() does not.
+ *
+ * Returns: (transfer none): The recent chooser menu item
+ */
+GtkWidget *
+mate_ui_menu_add_recent_chooser(GtkMenu         *menu,
+                                 const gchar     *label,
+                                 GtkRecentFilter *filter,
+                                 GCallback        callback,
+                                 gpointer         user_data)
+{
+    g_return_val_if_fail(GTK_IS_MENU(menu), NULL);
+    g_return_val_if_fail(label != NULL, NULL);
 
     GtkWidget *item = gtk_menu_item_new_with_mnemonic(label);
 
-    GtkRecentManager *manager = gtk_recent_manager_get_default();
-    GtkWidget *recent_menu = gtk_recent_chooser_menu_new_for_manager(manager);
+    GtkRecentManager *manager = gtk_recent_manager_get_default();
+    GtkWidget *recent_menu = gtk_recent_chooser_menu_new_for_manager(manager);
+
+    gtk_recent_chooser_set_show_tips(GTK_RECENT_CHOOSER(recent_menu), TRUE);
+    gtk_recent_chooser_set_sort_type(GTK_RECENT_CHOOSER(recent_menu),
+                                      GTK_RECENT_SORT_MRU);
+    gtk_recent_chooser_set_limit(GTK_RECENT_CHOOSER(recent_menu), 10);
+    gtk_recent_chooser_set_local_only(GTK_RECENT_CHOOSER(recent_menu), FALSE);
+
+    if (filter != NULL)
+    {
+        gtk_recent_chooser_add_filter(GTK_RECENT_CHOOSER(recent_menu), filter);
+        gtk_recent_chooser_set_filter(GTK_RECENT_CHOOSER(recent_menu), filter);
+    }
+
+    if (callback != NULL)
+    {
+        g_signal_connect(recent_menu, "item-activated", callback, user_data);
+    }
+
+    gtk_menu_item_set_submenu(GTK_MENU_ITEM(item), recent_menu);
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+    gtk_widget_show(item);
+
+    return item;
+}
+
+/*
+ * Recent items
+ *
+ * A bounded replacement for GtkRecentChooserMenu. The bookmark file is
+ * parsed on a worker thread and only the newest @limit items that pass
+ * the filter are kept. The file is watched; a reload only invalidates
+ * the menu if those items changed, and the menu's items are built when
+ * it is opened.
+ */
+#define RECENT_RELOAD_DELAY 500
+#define RECENT_URI_KEY "mate-ui-recent-uri"
+
+typedef struct
+{
+    gchar  *uri;
+    gchar  *display_name;
+    gint64  modified;
+} RecentItem;
+
+typedef struct
+{
+    GtkWidget                *menu;        /* NULL once destroyed */
+    GtkRecentFilter          *filter;
+    guint                     limit;
+    gchar                    *filename;
+    GArray                   *items;       /* RecentItem */
+    GFileMonitor             *monitor;
+    guint                     reload_id;
+    gboolean                  loading;
+    gboolean                  pending;     /* changed during a load */
+    gboolean                  loaded;
+    gboolean                  stale;       /* menu does not show items */
+    MateUiRecentActivateFunc  callback;
+    gpointer                  user_data;
+} RecentModel;
+
+typedef struct
+{
+    gchar           *filename;
+    GtkRecentFilter *filter;
+    guint            limit;
+} RecentLoad;
+
+static void recent_model_load(RecentModel *model);
+
+static void
+recent_item_clear(gpointer data)
+{
+    RecentItem *item = data;
+
+    g_free(item->uri);
+    g_free(item->display_name);
+}
+
+static GArray *
+recent_items_new(void)
+{
+    GArray *items = g_array_new(FALSE, FALSE, sizeof(RecentItem));
+    g_array_set_clear_func(items, recent_item_clear);
+    return items;
+}
+
+static void
+recent_load_free(gpointer data)
+{
+    RecentLoad *load = data;
+
+    g_free(load->filename);
+    if (load->filter != NULL)
+        g_object_unref(load->filter);
+    g_free(load);
+}
+
+static gint
+recent_item_compare(gconstpointer a,
+                    gconstpointer b)
+{
+    const RecentItem *x = a;
+    const RecentItem *y = b;
+
+    /* Newest first */
+    return (x->modified < y->modified) - (x->modified > y->modified);
+}
+
+static gboolean
+recent_load_accept(RecentLoad    *load,
+                   GBookmarkFile *bookmarks,
+                   const gchar   *uri,
+                   const gchar   *display_name,
+                   gint64         modified,
+                   gint64         now)
+{
+    if (load->filter == NULL)
+        return TRUE;
+
+    GtkRecentFilterInfo info = { 0 };
+    GtkRecentFilterFlags needed = gtk_recent_filter_get_needed(load->filter);
+    gchar *mime_type = NULL;
+    gchar **applications = NULL;
+    gchar **groups = NULL;
+
+    info.contains = GTK_RECENT_FILTER_URI | GTK_RECENT_FILTER_DISPLAY_NAME | GTK_RECENT_FILTER_AGE;
+    info.uri = uri;
+    info.display_name = display_name;
+    info.age = (gint) ((now - modified) / (60 * 60 * 24));
+
+    if (needed & GTK_RECENT_FILTER_MIME_TYPE)
+    {
+        mime_type = g_bookmark_file_get_mime_type(bookmarks, uri, NULL);
+        info.mime_type = mime_type;
+        info.contains |= GTK_RECENT_FILTER_MIME_TYPE;
+    }
+
+    if (needed & GTK_RECENT_FILTER_APPLICATION)
+    {
+        applications = g_bookmark_file_get_applications(bookmarks, uri, NULL, NULL);
+        info.applications = (const gchar **) applications;
+        info.contains |= GTK_RECENT_FILTER_APPLICATION;
+    }
+
+    if (needed & GTK_RECENT_FILTER_GROUP)
+    {
+        groups = g_bookmark_file_get_groups(bookmarks, uri, NULL, NULL);
+        info.groups = (const gchar **) groups;
+        info.contains |= GTK_RECENT_FILTER_GROUP;
+    }
+
+    gboolean accepted = gtk_recent_filter_filter(load->filter, &info);
+
+    g_free(mime_type);
+    g_strfreev(applications);
+    g_strfreev(groups);
+
+    return accepted;
+}
+
+static gchar *
+recent_display_name(GBookmarkFile *bookmarks,
+                    const gchar   *uri)
+{
+    gchar *title = g_bookmark_file_get_title(bookmarks, uri, NULL);
+    if (title != NULL && *title != '\0')
+        return title;
+    g_free(title);
+
+    gchar *path = g_filename_from_uri(uri, NULL, NULL);
+    if (path != NULL)
+    {
+        gchar *name = g_filename_display_basename(path);
+        g_free(path);
+        return name;
+    }
+
+    gchar *unescaped = g_uri_unescape_string(uri, NULL);
+    gchar *name = g_path_get_basename(unescaped ? unescaped : uri);
+    g_free(unescaped);
+
+    return name;
+}
+
+static void
+recent_load_thread(GTask        *task,
+                   gpointer      source_object G_GNUC_UNUSED,
+                   gpointer      task_data,
+                   GCancellable *cancellable G_GNUC_UNUSED)
+{
+    RecentLoad *load = task_data;
+    GBookmarkFile *bookmarks = g_bookmark_file_new();
+    GArray *items = recent_items_new();
+    GError *error = NULL;
 
-    gtk_recent_chooser_set_show_tips(GTK_RECENT_CHOOSER(recent_menu), TRUE);
-    gtk_recent_chooser_set_sort_type(GTK_RECENT_CHOOSER(recent_menu),
-                                      GTK_RECENT_SORT_MRU);
-    gtk_recent_chooser_set_limit(GTK_RECENT_CHOOSER(recent_menu), 10);
-    gtk_recent_chooser_set_local_only(GTK_RECENT_CHOOSER(recent_menu), FALSE);
+    if (!g_bookmark_file_load_from_file(bookmarks, load->filename, &error))
+    {
+        /* No file yet just means no recent items */
+        if (!g_error_matches(error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            g_warning("Failed to read recent items from %s: %s", load->filename, error->message);
+        g_error_free(error);
+        g_bookmark_file_free(bookmarks);
+        g_task_return_pointer(task, items, (GDestroyNotify) g_array_unref);
+        return;
+    }
 
-    if (filter != NULL)
+    gsize n_uris;
+    gchar **uris = g_bookmark_file_get_uris(bookmarks, &n_uris);
+    gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+
+    for (gsize i = 0; i < n_uris; i++)
     {
-        gtk_recent_chooser_add_filter(GTK_RECENT_CHOOSER(recent_menu), filter);
-        gtk_recent_chooser_set_filter(GTK_RECENT_CHOOSER(recent_menu), filter);
+        const gchar *uri = uris[i];
+
+        if (g_bookmark_file_get_is_private(bookmarks, uri, NULL))
+            continue;
+
+#if GLIB_CHECK_VERSION(2, 66, 0)
+        GDateTime *date = g_bookmark_file_get_modified_date_time(bookmarks, uri, NULL);
+        gint64 modified = date ? g_date_time_to_unix(date) : 0;
+#else
+        gint64 modified = g_bookmark_file_get_modified(bookmarks, uri, NULL);
+#endif
+
+        /* Cheap check before anything is allocated for this item */
+        if (items->len == load->limit &&
+            modified <= g_array_index(items, RecentItem, items->len - 1).modified)
+            continue;
+
+        gchar *display_name = recent_display_name(bookmarks, uri);
+
+        if (!recent_load_accept(load, bookmarks, uri, display_name, modified, now))
+        {
+            g_free(display_name);
+            continue;
+        }
+
+        RecentItem item = { g_strdup(uri), display_name, modified };
+
+        /* Keep the newest items, sorted, never more than the limit */
+        if (items->len == load->limit)
+            g_array_remove_index(items, items->len - 1);
+
+        guint position = items->len;
+        while (position > 0 && g_array_index(items, RecentItem, position - 1).modified < modified)
+            position--;
+
+        g_array_insert_val(items, position, item);
     }
 
-    if (callback != NULL)
+    g_strfreev(uris);
+    g_bookmark_file_free(bookmarks);
+
+    g_task_return_pointer(task, items, (GDestroyNotify) g_array_unref);
+}
+
+/* Doubles underscores so file names are not taken as mnemonics */
+static gchar *
+recent_escape_mnemonic(const gchar *text)
+{
+    GString *escaped = g_string_sized_new(strlen(text) + 4);
+
+    for (const gchar *p = text; *p != '\0'; p++)
     {
-        g_signal_connect(recent_menu, "item-activated", callback, user_data);
+        if (*p == '_')
+            g_string_append_c(escaped, '_');
+        g_string_append_c(escaped, *p);
+    }
+
+    return g_string_free(escaped, FALSE);
+}
+
+static gboolean
+recent_items_equal(GArray *a,
+                   GArray *b)
+{
+    if (a->len != b->len)
+        return FALSE;
+
+    for (guint i = 0; i < a->len; i++)
+    {
+        RecentItem *x = &g_array_index(a, RecentItem, i);
+        RecentItem *y = &g_array_index(b, RecentItem, i);
+
+        if (strcmp(x->uri, y->uri) != 0 || strcmp(x->display_name, y->display_name) != 0)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+recent_model_free(RecentModel *model)
+{
+    if (model->reload_id != 0)
+        g_source_remove(model->reload_id);
+
+    if (model->monitor != NULL)
+    {
+        g_signal_handlers_disconnect_by_data(model->monitor, model);
+        g_file_monitor_cancel(model->monitor);
+        g_object_unref(model->monitor);
+    }
+
+    if (model->filter != NULL)
+        g_object_unref(model->filter);
+
+    g_array_unref(model->items);
+    g_free(model->filename);
+    g_free(model);
+}
+
+static void
+recent_item_activated(GtkMenuItem *item,
+                      gpointer     user_data)
+{
+    RecentModel *model = user_data;
+    const gchar *uri = g_object_get_data(G_OBJECT(item), RECENT_URI_KEY);
+
+    if (model->callback != NULL && uri != NULL)
+        model->callback(uri, model->user_data);
+}
+
+static void
+recent_model_populate(RecentModel *model)
+{
+    if (model->menu == NULL || !model->loaded || !model->stale)
+        return;
+
+    model->stale = FALSE;
+
+    GList *children = gtk_container_get_children(GTK_CONTAINER(model->menu));
+    for (GList *l = children; l != NULL; l = l->next)
+        gtk_widget_destroy(l->data);
+    g_list_free(children);
+
+    for (guint i = 0; i < model->items->len; i++)
+    {
+        RecentItem *recent = &g_array_index(model->items, RecentItem, i);
+        gchar *escaped = recent_escape_mnemonic(recent->display_name);
+        gchar *label = i < 9 ? g_strdup_printf("_%u. %s", i + 1, escaped)
+                             : g_strdup_printf("%u. %s", i + 1, escaped);
+
+        GtkWidget *item = gtk_menu_item_new_with_mnemonic(label);
+        gchar *path = g_filename_from_uri(recent->uri, NULL, NULL);
+        gtk_widget_set_tooltip_text(item, path ? path : recent->uri);
+
+        g_object_set_data_full(G_OBJECT(item), RECENT_URI_KEY, g_strdup(recent->uri), g_free);
+        g_signal_connect(item, "activate", G_CALLBACK(recent_item_activated), model);
+
+        gtk_menu_shell_append(GTK_MENU_SHELL(model->menu), item);
+        gtk_widget_show(item);
+
+        g_free(path);
+        g_free(label);
+        g_free(escaped);
+    }
+
+    if (model->items->len == 0)
+    {
+        GtkWidget *item = gtk_menu_item_new_with_label("No items found");
+        gtk_widget_set_sensitive(item, FALSE);
+        gtk_menu_shell_append(GTK_MENU_SHELL(model->menu), item);
+        gtk_widget_show(item);
+    }
+}
+
+static void
+recent_model_loaded(GObject      *source G_GNUC_UNUSED,
+                    GAsyncResult *result,
+                    gpointer      user_data)
+{
+    RecentModel *model = user_data;
+    GArray *items = g_task_propagate_pointer(G_TASK(result), NULL);
+
+    model->loading = FALSE;
+
+    if (model->menu == NULL)
+    {
+        g_array_unref(items);
+        recent_model_free(model);
+        return;
+    }
+
+    if (!model->loaded || !recent_items_equal(model->items, items))
+    {
+        g_array_unref(model->items);
+        model->items = g_array_ref(items);
+        model->loaded = TRUE;
+        model->stale = TRUE;
+
+        /* Otherwise the items are built when the menu is next opened */
+        if (gtk_widget_get_visible(model->menu))
+            recent_model_populate(model);
+    }
+
+    g_array_unref(items);
+
+    if (model->pending)
+        recent_model_load(model);
+}
+
+static void
+recent_model_load(RecentModel *model)
+{
+    model->pending = FALSE;
+
+    if (model->loading)
+    {
+        model->pending = TRUE;
+        return;
+    }
+
+    model->loading = TRUE;
+
+    RecentLoad *load = g_new0(RecentLoad, 1);
+    load->filename = g_strdup(model->filename);
+    load->filter = model->filter ? g_object_ref(model->filter) : NULL;
+    load->limit = model->limit;
+
+    GTask *task = g_task_new(NULL, NULL, recent_model_loaded, model);
+    g_task_set_task_data(task, load, recent_load_free);
+    g_task_run_in_thread(task, recent_load_thread);
+    g_object_unref(task);
+}
+
+static gboolean
+recent_model_reload(gpointer user_data)
+{
+    RecentModel *model = user_data;
+
+    model->reload_id = 0;
+    recent_model_load(model);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+recent_model_changed(GFileMonitor      *monitor G_GNUC_UNUSED,
+                     GFile             *file G_GNUC_UNUSED,
+                     GFile             *other_file G_GNUC_UNUSED,
+                     GFileMonitorEvent  event,
+                     gpointer           user_data)
+{
+    RecentModel *model = user_data;
+
+    if (event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
+        event != G_FILE_MONITOR_EVENT_CREATED &&
+        event != G_FILE_MONITOR_EVENT_DELETED &&
+        event != G_FILE_MONITOR_EVENT_RENAMED &&
+        event != G_FILE_MONITOR_EVENT_MOVED_IN)
+        return;
+
+    if (model->reload_id != 0)
+        g_source_remove(model->reload_id);
+
+    model->reload_id = g_timeout_add(RECENT_RELOAD_DELAY, recent_model_reload, model);
+}
+
+static void
+recent_menu_shown(GtkWidget *menu G_GNUC_UNUSED,
+                  gpointer   user_data)
+{
+    recent_model_populate(user_data);
+}
+
+static void
+recent_menu_destroyed(GtkWidget *menu G_GNUC_UNUSED,
+                      gpointer   user_data)
+{
+    RecentModel *model = user_data;
+
+    model->menu = NULL;
+
+    if (model->reload_id != 0)
+    {
+        g_source_remove(model->reload_id);
+        model->reload_id = 0;
     }
 
+    /* A load in flight frees the model when it completes */
+    if (!model->loading)
+        recent_model_free(model);
+}
+
+/**
+ * mate_ui_menu_add_recent_items:
+ * @menu: A #GtkMenu
+ * @label: The submenu label (e.g., "Open _Recent")
+ * @filter: (nullable): A #GtkRecentFilter or %NULL
+ * @limit: Maximum number of items to show
+ * @callback: (nullable): Called with the URI of an activated item
+ * @user_data: User data for @callback
+ *
+ * Adds a recent files submenu to the given menu. Unlike
+ * mate_ui_menu_add_recent_chooser(), nothing is read on the calling
+ * thread: the recent items file is parsed on a worker thread, only the
+ * newest @limit items that pass @filter are kept, and the submenu's
+ * items are built when it is opened. Changes to the file are picked up
+ * automatically.
+ *
+ * @filter is evaluated on the worker thread, so it must not be changed
+ * afterwards and custom filter functions must be thread-safe.
+ *
+ * Returns: (transfer none): The recent items menu item
+ */
+GtkWidget *
+mate_ui_menu_add_recent_items(GtkMenu                  *menu,
+                               const gchar              *label,
+                               GtkRecentFilter          *filter,
+                               guint                     limit,
+                               MateUiRecentActivateFunc  callback,
+                               gpointer                  user_data)
+{
+    g_return_val_if_fail(GTK_IS_MENU(menu), NULL);
+    g_return_val_if_fail(label != NULL, NULL);
+    g_return_val_if_fail(filter == NULL || GTK_IS_RECENT_FILTER(filter), NULL);
+    g_return_val_if_fail(limit > 0, NULL);
+
+    GtkWidget *item = gtk_menu_item_new_with_mnemonic(label);
+    GtkWidget *recent_menu = menu_new();
+
+    RecentModel *model = g_new0(RecentModel, 1);
+    model->menu = recent_menu;
+    model->filter = filter ? g_object_ref_sink(filter) : NULL;
+    model->limit = limit;
+    model->filename = g_build_filename(g_get_user_data_dir(), "recently-used.xbel", NULL);
+    model->items = recent_items_new();
+    model->callback = callback;
+    model->user_data = user_data;
+
+    GFile *file = g_file_new_for_path(model->filename);
+    model->monitor = g_file_monitor_file(file, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+    g_object_unref(file);
+
+    if (model->monitor != NULL)
+        g_signal_connect(model->monitor, "changed", G_CALLBACK(recent_model_changed), model);
+
+    g_signal_connect(recent_menu, "show", G_CALLBACK(recent_menu_shown), model);
+    g_signal_connect(recent_menu, "destroy", G_CALLBACK(recent_menu_destroyed), model);
+
+    recent_model_load(model);
+
     gtk_menu_item_set_submenu(GTK_MENU_ITEM(item), recent_menu);
     gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
     gtk_widget_show(item);
@@ -382,7 +2306,8 @@ mate_ui_popup_menu_at_widget(GtkMenu    *menu,
 /**
  * mate_ui_context_menu_new:
  *
- * Creates a new context menu (GtkMenu).
+ * Creates a new context menu (GtkMenu). Menus shown repeatedly should
+ * use a #MateUiContextMenuTemplate instead.
  *
  * Returns: (transfer full): A new #GtkMenu
  */
@@ -440,3 +2365,311 @@ mate_ui_context_menu_add_separator(GtkMenu *menu)
     gtk_menu_shell_append(GTK_MENU_SHELL(menu), sep);
     gtk_widget_show(sep);
 }
+
+/*
+ * Context menu templates
+ *
+ * A template owns one GtkMenu whose items are built once. Each popup
+ * only asks the state function which items to show and enable for the
+ * given context, and every item dispatches through the one activate
+ * closure of the template, which reads the item id from the item.
+ */
+
+#define CONTEXT_MENU_ITEM_ID_KEY "mate-ui-context-menu-item-id"
+
+typedef struct
+{
+    GtkWidget *widget;
+    guint      id;
+    gboolean   separator;
+} ContextMenuItem;
+
+struct _MateUiContextMenuTemplate
+{
+    GtkWidget                     *menu;
+    GArray                        *items;
+    GClosure                      *activated;
+    MateUiContextMenuActivateFunc  activate;
+    MateUiContextMenuStateFunc     state;
+    gpointer                       user_data;
+    GDestroyNotify                 destroy;
+    gpointer                       context;
+    GDestroyNotify                 context_destroy;
+};
+
+static void
+context_menu_template_set_context(MateUiContextMenuTemplate *tmpl,
+                                  gpointer                   context,
+                                  GDestroyNotify             context_destroy)
+{
+    gpointer old_context = tmpl->context;
+    GDestroyNotify old_destroy = tmpl->context_destroy;
+
+    tmpl->context = context;
+    tmpl->context_destroy = context_destroy;
+
+    if (old_destroy != NULL && old_context != NULL)
+        old_destroy(old_context);
+}
+
+static void
+context_menu_item_activated(GtkMenuItem *item,
+                            gpointer     user_data)
+{
+    MateUiContextMenuTemplate *tmpl = user_data;
+
+    if (tmpl->activate == NULL)
+        return;
+
+    guint id = GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(item), CONTEXT_MENU_ITEM_ID_KEY));
+    tmpl->activate(id, tmpl->context, tmpl->user_data);
+}
+
+/*
+ * Applies the state of every item for the current context. Separators
+ * are only shown between two visible items. Returns whether any item
+ * is visible.
+ */
+static gboolean
+context_menu_template_update(MateUiContextMenuTemplate *tmpl)
+{
+    GtkWidget *pending_separator = NULL;
+    gboolean any_visible = FALSE;
+
+    for (guint i = 0; i < tmpl->items->len; i++)
+    {
+        ContextMenuItem *item = &g_array_index(tmpl->items, ContextMenuItem, i);
+
+        if (item->separator)
+        {
+            gtk_widget_hide(item->widget);
+            if (any_visible && pending_separator == NULL)
+                pending_separator = item->widget;
+            continue;
+        }
+
+        MateUiContextMenuItemState state = MATE_UI_CONTEXT_MENU_ITEM_VISIBLE |
+                                           MATE_UI_CONTEXT_MENU_ITEM_SENSITIVE;
+        if (tmpl->state != NULL)
+            state = tmpl->state(item->id, tmpl->context, tmpl->user_data);
+
+        if (!(state & MATE_UI_CONTEXT_MENU_ITEM_VISIBLE))
+        {
+            gtk_widget_hide(item->widget);
+            continue;
+        }
+
+        gtk_widget_set_sensitive(item->widget, (state & MATE_UI_CONTEXT_MENU_ITEM_SENSITIVE) != 0);
+        gtk_widget_show(item->widget);
+
+        if (pending_separator != NULL)
+        {
+            gtk_widget_show(pending_separator);
+            pending_separator = NULL;
+        }
+        any_visible = TRUE;
+    }
+
+    return any_visible;
+}
+
+static gboolean
+context_menu_template_prepare(MateUiContextMenuTemplate *tmpl,
+                              gpointer                   context,
+                              GDestroyNotify             context_destroy)
+{
+    context_menu_template_set_context(tmpl, context, context_destroy);
+
+    return context_menu_template_update(tmpl);
+}
+
+/**
+ * mate_ui_context_menu_template_new:
+ * @activate: (nullable): Called when an item is activated
+ * @state: (nullable): Called for each item before the menu is shown
+ * @user_data: User data for @activate and @state
+ * @destroy: (nullable): Destroy notify for @user_data
+ *
+ * Creates a context menu template. Its menu is built once and reused
+ * for every popup.
+ *
+ * Returns: (transfer full): A new #MateUiContextMenuTemplate
+ */
+MateUiContextMenuTemplate *
+mate_ui_context_menu_template_new(MateUiContextMenuActivateFunc activate,
+                                  MateUiContextMenuStateFunc    state,
+                                  gpointer                      user_data,
+                                  GDestroyNotify                destroy)
+{
+    MateUiContextMenuTemplate *tmpl = g_new0(MateUiContextMenuTemplate, 1);
+
+    tmpl->menu = g_object_ref_sink(gtk_menu_new());
+    tmpl->items = g_array_new(FALSE, FALSE, sizeof(ContextMenuItem));
+    tmpl->activated = g_cclosure_new(G_CALLBACK(context_menu_item_activated), tmpl, NULL);
+    g_closure_ref(tmpl->activated);
+    g_closure_sink(tmpl->activated);
+    tmpl->activate = activate;
+    tmpl->state = state;
+    tmpl->user_data = user_data;
+    tmpl->destroy = destroy;
+
+    return tmpl;
+}
+
+/**
+ * mate_ui_context_menu_template_free:
+ * @tmpl: A #MateUiContextMenuTemplate
+ *
+ * Destroys the menu of a template and frees it, releasing the context
+ * of the last popup.
+ */
+void
+mate_ui_context_menu_template_free(MateUiContextMenuTemplate *tmpl)
+{
+    if (tmpl == NULL)
+        return;
+
+    gtk_widget_destroy(tmpl->menu);
+    g_object_unref(tmpl->menu);
+    g_array_free(tmpl->items, TRUE);
+    g_closure_invalidate(tmpl->activated);
+    g_closure_unref(tmpl->activated);
+
+    context_menu_template_set_context(tmpl, NULL, NULL);
+
+    if (tmpl->destroy != NULL)
+        tmpl->destroy(tmpl->user_data);
+
+    g_free(tmpl);
+}
+
+/**
+ * mate_ui_context_menu_template_add_item:
+ * @tmpl: A #MateUiContextMenuTemplate
+ * @id: An application defined item id
+ * @label: The item label
+ *
+ * Appends an item to the template. @id is passed to the state and
+ * activate functions of the template.
+ *
+ * Returns: (transfer none): The new menu item
+ */
+GtkWidget *
+mate_ui_context_menu_template_add_item(MateUiContextMenuTemplate *tmpl,
+                                       guint                      id,
+                                       const gchar               *label)
+{
+    g_return_val_if_fail(tmpl != NULL, NULL);
+    g_return_val_if_fail(label != NULL, NULL);
+
+    ContextMenuItem item = { 0 };
+    item.widget = gtk_menu_item_new_with_mnemonic(label);
+    item.id = id;
+
+    g_object_set_data(G_OBJECT(item.widget), CONTEXT_MENU_ITEM_ID_KEY, GUINT_TO_POINTER(id));
+    g_signal_connect_closure(item.widget, "activate", tmpl->activated, FALSE);
+
+    gtk_menu_shell_append(GTK_MENU_SHELL(tmpl->menu), item.widget);
+    gtk_widget_show(item.widget);
+    g_array_append_val(tmpl->items, item);
+
+    return item.widget;
+}
+
+/**
+ * mate_ui_context_menu_template_add_separator:
+ * @tmpl: A #MateUiContextMenuTemplate
+ *
+ * Appends a separator to the template. It is only shown when visible
+ * items precede and follow it.
+ */
+void
+mate_ui_context_menu_template_add_separator(MateUiContextMenuTemplate *tmpl)
+{
+    g_return_if_fail(tmpl != NULL);
+
+    ContextMenuItem item = { 0 };
+    item.widget = gtk_separator_menu_item_new();
+    item.separator = TRUE;
+
+    gtk_menu_shell_append(GTK_MENU_SHELL(tmpl->menu), item.widget);
+    g_array_append_val(tmpl->items, item);
+}
+
+/**
+ * mate_ui_context_menu_template_get_menu:
+ * @tmpl: A #MateUiContextMenuTemplate
+ *
+ * Gets the menu of a template.
+ *
+ * Returns: (transfer none): The #GtkMenu of the template
+ */
+GtkWidget *
+mate_ui_context_menu_template_get_menu(MateUiContextMenuTemplate *tmpl)
+{
+    g_return_val_if_fail(tmpl != NULL, NULL);
+
+    return tmpl->menu;
+}
+
+/**
+ * mate_ui_context_menu_template_popup_at_pointer:
+ * @tmpl: A #MateUiContextMenuTemplate
+ * @context: (nullable): Context passed to the state and activate functions
+ * @context_destroy: (nullable): Destroy notify for @context
+ * @event: (nullable): The triggering event or %NULL
+ *
+ * Updates the items of the template for @context and shows its menu at
+ * the pointer position. @context is kept until the next popup or until
+ * the template is freed. Nothing is shown if no item is visible.
+ *
+ * Returns: %TRUE if the menu was shown
+ */
+gboolean
+mate_ui_context_menu_template_popup_at_pointer(MateUiContextMenuTemplate *tmpl,
+                                               gpointer                   context,
+                                               GDestroyNotify             context_destroy,
+                                               const GdkEvent            *event)
+{
+    g_return_val_if_fail(tmpl != NULL, FALSE);
+
+    if (!context_menu_template_prepare(tmpl, context, context_destroy))
+        return FALSE;
+
+    gtk_menu_popup_at_pointer(GTK_MENU(tmpl->menu), event);
+
+    return TRUE;
+}
+
+/**
+ * mate_ui_context_menu_template_popup_at_widget:
+ * @tmpl: A #MateUiContextMenuTemplate
+ * @context: (nullable): Context passed to the state and activate functions
+ * @context_destroy: (nullable): Destroy notify for @context
+ * @widget: The widget to popup at
+ * @widget_anchor: Anchor point on widget
+ * @menu_anchor: Anchor point on menu
+ *
+ * Like mate_ui_context_menu_template_popup_at_pointer(), but anchors
+ * the menu to a widget.
+ *
+ * Returns: %TRUE if the menu was shown
+ */
+gboolean
+mate_ui_context_menu_template_popup_at_widget(MateUiContextMenuTemplate *tmpl,
+                                              gpointer                   context,
+                                              GDestroyNotify             context_destroy,
+                                              GtkWidget                 *widget,
+                                              GdkGravity                 widget_anchor,
+                                              GdkGravity                 menu_anchor)
+{
+    g_return_val_if_fail(tmpl != NULL, FALSE);
+    g_return_val_if_fail(GTK_IS_WIDGET(widget), FALSE);
+
+    if (!context_menu_template_prepare(tmpl, context, context_destroy))
+        return FALSE;
+
+    gtk_menu_popup_at_widget(GTK_MENU(tmpl->menu), widget, widget_anchor, menu_anchor, NULL);
+
+    return TRUE;
+}
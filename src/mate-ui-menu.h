@@ -55,6 +55,53 @@ typedef struct
  */
 #define MATE_UI_MENU_SEPARATOR { NULL, NULL, NULL, NULL }
 
+/**
+ * MateUiCompiledMenuEntry:
+ * @label: The menu item label, with mnemonic
+ * @plain_label: @label without the mnemonic, for #GMenu
+ * @action_name: The action name
+ * @accel: (nullable): The accelerator string
+ * @icon_name: (nullable): An icon name
+ * @key: The parsed key value of @accel, or 0
+ * @mods: The parsed modifiers of @accel
+ *
+ * A menu item generated by mateui-compile-ui.
+ */
+typedef struct
+{
+    const gchar     *label;
+    const gchar     *plain_label;
+    const gchar     *action_name;
+    const gchar     *accel;
+    const gchar     *icon_name;
+    guint            key;
+    GdkModifierType  mods;
+} MateUiCompiledMenuEntry;
+
+/**
+ * MateUiCompiledSubmenu:
+ * @label: The submenu label, with mnemonic
+ * @plain_label: @label without the mnemonic, for #GMenu
+ * @entries: Array of #MateUiCompiledMenuEntry items
+ * @n_entries: Number of entries
+ *
+ * A submenu generated by mateui-compile-ui.
+ */
+typedef struct
+{
+    const gchar                    *label;
+    const gchar                    *plain_label;
+    const MateUiCompiledMenuEntry  *entries;
+    gsize                           n_entries;
+} MateUiCompiledSubmenu;
+
+/**
+ * MATE_UI_COMPILED_MENU_SEPARATOR:
+ *
+ * A separator in a compiled menu.
+ */
+#define MATE_UI_COMPILED_MENU_SEPARATOR { NULL, NULL, NULL, NULL, NULL, 0, 0 }
+
 /**
  * mate_ui_menu_bar_new_from_entries:
  * @submenus: Array of #MateUiSubmenu structures
@@ -69,6 +116,43 @@ GtkWidget *mate_ui_menu_bar_new_from_entries(const MateUiSubmenu *submenus,
                                               gsize                n_submenus,
                                               GtkAccelGroup       *accel_group);
 
+/**
+ * mate_ui_menu_bar_update_from_entries:
+ * @menubar: A #GtkMenuBar built by mate_ui_menu_bar_new_from_entries()
+ * @old_submenus: The table @menubar currently reflects
+ * @n_old: Number of old submenus
+ * @new_submenus: The table to update @menubar to
+ * @n_new: Number of new submenus
+ * @accel_group: (nullable): The accelerator group @menubar was built with
+ *
+ * Updates a menubar in place, inserting, removing or rebuilding only
+ * the items that differ between the two tables. Menubars built with
+ * mate_ui_menu_bar_new_from_entries_lazy() are not supported.
+ */
+void mate_ui_menu_bar_update_from_entries(GtkWidget           *menubar,
+                                           const MateUiSubmenu *old_submenus,
+                                           gsize                n_old,
+                                           const MateUiSubmenu *new_submenus,
+                                           gsize                n_new,
+                                           GtkAccelGroup       *accel_group);
+
+/**
+ * mate_ui_menu_bar_new_from_entries_lazy:
+ * @submenus: Array of #MateUiSubmenu structures, which must outlive the menubar
+ * @n_submenus: Number of submenus
+ * @accel_group: (nullable): Accelerator group to attach, or %NULL
+ *
+ * Creates a GtkMenuBar whose submenus are built when first opened.
+ * Accelerators are added to @accel_group immediately and removed again
+ * when the menubar is destroyed. The menubar cannot be passed to
+ * mate_ui_menu_bar_update_from_entries().
+ *
+ * Returns: (transfer full): A new #GtkMenuBar
+ */
+GtkWidget *mate_ui_menu_bar_new_from_entries_lazy(const MateUiSubmenu *submenus,
+                                                   gsize                n_submenus,
+                                                   GtkAccelGroup       *accel_group);
+
 /**
  * mate_ui_menu_new_from_entries:
  * @entries: Array of #MateUiMenuEntry structures
@@ -89,13 +173,68 @@ GtkWidget *mate_ui_menu_new_from_entries(const MateUiMenuEntry *entries,
  * @n_submenus: Number of submenus
  *
  * Creates a GMenuModel from an array of submenu definitions.
- * This is useful for GtkApplication menu integration.
+ * This is useful for GtkApplication menu integration. Separators split
+ * submenus into sections.
  *
  * Returns: (transfer full): A new #GMenuModel
  */
 GMenuModel *mate_ui_menu_model_new_from_entries(const MateUiSubmenu *submenus,
                                                  gsize                n_submenus);
 
+/**
+ * mate_ui_menu_model_get_shared:
+ * @submenus: Array of #MateUiSubmenu structures
+ * @n_submenus: Number of submenus
+ *
+ * Gets a GMenuModel for @submenus like
+ * mate_ui_menu_model_new_from_entries(), but builds it only once and
+ * shares it with later calls for the same table, as long as the table
+ * contents are unchanged. The model is frozen and must not be modified.
+ *
+ * Returns: (transfer full): A shared #GMenuModel
+ */
+GMenuModel *mate_ui_menu_model_get_shared(const MateUiSubmenu *submenus,
+                                          gsize                n_submenus);
+
+/**
+ * mate_ui_menu_model_invalidate:
+ * @submenus: (nullable): A table passed to mate_ui_menu_model_get_shared()
+ *   or mate_ui_menu_model_new_from_compiled(), or %NULL for all tables
+ *
+ * Drops the shared model of @submenus, so the next call builds a new
+ * one. Models already handed out stay valid.
+ */
+void mate_ui_menu_model_invalidate(gconstpointer submenus);
+
+/**
+ * mate_ui_menu_bar_new_from_compiled:
+ * @submenus: Array of #MateUiCompiledSubmenu generated by mateui-compile-ui
+ * @n_submenus: Number of submenus
+ * @accel_group: (nullable): Accelerator group to attach, or %NULL
+ *
+ * Creates a GtkMenuBar from compiled submenus, without parsing any
+ * accelerators.
+ *
+ * Returns: (transfer full): A new #GtkMenuBar
+ */
+GtkWidget *mate_ui_menu_bar_new_from_compiled(const MateUiCompiledSubmenu *submenus,
+                                               gsize                        n_submenus,
+                                               GtkAccelGroup               *accel_group);
+
+/**
+ * mate_ui_menu_model_new_from_compiled:
+ * @submenus: Array of #MateUiCompiledSubmenu generated by mateui-compile-ui
+ * @n_submenus: Number of submenus
+ *
+ * Creates a GMenuModel from compiled submenus, using their pre-stripped
+ * labels. The model is shared and frozen, like
+ * mate_ui_menu_model_get_shared().
+ *
+ * Returns: (transfer full): A #GMenuModel
+ */
+GMenuModel *mate_ui_menu_model_new_from_compiled(const MateUiCompiledSubmenu *submenus,
+                                                  gsize                        n_submenus);
+
 /**
  * mate_ui_menu_item_new_with_action:
  * @label: The menu item label
@@ -126,6 +265,37 @@ GtkWidget *mate_ui_menu_item_new_with_icon(const gchar *label,
                                             const gchar *icon_name,
                                             const gchar *action_name);
 
+/**
+ * mate_ui_menu_warm_icons:
+ * @widget: (nullable): A widget on the screen the menus will show on, or %NULL
+ * @submenus: (array length=n_submenus): Array of #MateUiSubmenu
+ * @n_submenus: Number of submenus
+ *
+ * Resolves and decodes the icons of @submenus at menu size and at the
+ * scale factor of @widget, on a worker thread, once the next frame of
+ * @widget has been painted; without @widget, once the main loop is
+ * idle. Menu items built afterwards use the decoded icons, so the
+ * first open of a menu does not wait for them. Items at another scale
+ * use the themed icons instead. Icons already cached are skipped, and
+ * the cache is dropped when the icon theme changes.
+ */
+void mate_ui_menu_warm_icons(GtkWidget           *widget,
+                              const MateUiSubmenu *submenus,
+                              gsize                n_submenus);
+
+/**
+ * mate_ui_menu_warm_compiled_icons:
+ * @widget: (nullable): A widget on the screen the menus will show on, or %NULL
+ * @submenus: (array length=n_submenus): Array of #MateUiCompiledSubmenu
+ * @n_submenus: Number of submenus
+ *
+ * Like mate_ui_menu_warm_icons(), for tables generated by
+ * mateui-compile-ui.
+ */
+void mate_ui_menu_warm_compiled_icons(GtkWidget                   *widget,
+                                       const MateUiCompiledSubmenu *submenus,
+                                       gsize                        n_submenus);
+
 /**
  * mate_ui_menu_add_recent_chooser:
  * @menu: A #GtkMenu
@@ -144,6 +314,38 @@ GtkWidget *mate_ui_menu_add_recent_chooser(GtkMenu             *menu,
                                             GCallback            callback,
                                             gpointer             user_data);
 
+/**
+ * MateUiRecentActivateFunc:
+ * @uri: The URI of the activated item
+ * @user_data: User data passed to mate_ui_menu_add_recent_items()
+ *
+ * Called when an item of a recent items submenu is activated.
+ */
+typedef void (*MateUiRecentActivateFunc)(const gchar *uri,
+                                         gpointer     user_data);
+
+/**
+ * mate_ui_menu_add_recent_items:
+ * @menu: A #GtkMenu
+ * @label: The submenu label (e.g., "Open _Recent")
+ * @filter: (nullable): A #GtkRecentFilter or %NULL
+ * @limit: Maximum number of items to show
+ * @callback: (nullable): Called with the URI of an activated item
+ * @user_data: User data for @callback
+ *
+ * Adds a recent files submenu that loads the recent items file on a
+ * worker thread, keeps only the newest @limit matching items and builds
+ * its items when opened.
+ *
+ * Returns: (transfer none): The recent items menu item
+ */
+GtkWidget *mate_ui_menu_add_recent_items(GtkMenu                  *menu,
+                                          const gchar              *label,
+                                          GtkRecentFilter          *filter,
+                                          guint                     limit,
+                                          MateUiRecentActivateFunc  callback,
+                                          gpointer                  user_data);
+
 /**
  * mate_ui_popup_menu_at_pointer:
  * @menu: A #GtkMenu
@@ -171,7 +373,8 @@ void mate_ui_popup_menu_at_widget(GtkMenu         *menu,
 /**
  * mate_ui_context_menu_new:
  *
- * Creates a new context menu (GtkMenu).
+ * Creates a new context menu (GtkMenu). Menus shown repeatedly should
+ * use a #MateUiContextMenuTemplate instead.
  *
  * Returns: (transfer full): A new #GtkMenu
  */
@@ -201,6 +404,152 @@ GtkWidget *mate_ui_context_menu_add_item(GtkMenu     *menu,
  */
 void mate_ui_context_menu_add_separator(GtkMenu *menu);
 
+/**
+ * MateUiContextMenuItemState:
+ * @MATE_UI_CONTEXT_MENU_ITEM_VISIBLE: The item is shown
+ * @MATE_UI_CONTEXT_MENU_ITEM_SENSITIVE: The item can be activated
+ *
+ * State of a context menu template item for one popup.
+ */
+typedef enum
+{
+    MATE_UI_CONTEXT_MENU_ITEM_VISIBLE   = 1 << 0,
+    MATE_UI_CONTEXT_MENU_ITEM_SENSITIVE = 1 << 1
+} MateUiContextMenuItemState;
+
+/**
+ * MateUiContextMenuStateFunc:
+ * @id: The item id
+ * @context: The context passed to the popup function
+ * @user_data: User data of the template
+ *
+ * Called for each item of a template before its menu is shown.
+ *
+ * Returns: The state of the item for @context
+ */
+typedef MateUiContextMenuItemState (*MateUiContextMenuStateFunc)(guint    id,
+                                                                 gpointer context,
+                                                                 gpointer user_data);
+
+/**
+ * MateUiContextMenuActivateFunc:
+ * @id: The id of the activated item
+ * @context: The context passed to the popup function
+ * @user_data: User data of the template
+ *
+ * Called when an item of a template is activated.
+ */
+typedef void (*MateUiContextMenuActivateFunc)(guint    id,
+                                              gpointer context,
+                                              gpointer user_data);
+
+/**
+ * MateUiContextMenuTemplate:
+ *
+ * Opaque structure holding a context menu that is built once and
+ * updated for each popup.
+ */
+typedef struct _MateUiContextMenuTemplate MateUiContextMenuTemplate;
+
+/**
+ * mate_ui_context_menu_template_new:
+ * @activate: (nullable): Called when an item is activated
+ * @state: (nullable): Called for each item before the menu is shown
+ * @user_data: User data for @activate and @state
+ * @destroy: (nullable): Destroy notify for @user_data
+ *
+ * Creates a context menu template. Its menu is built once and reused
+ * for every popup.
+ *
+ * Returns: (transfer full): A new #MateUiContextMenuTemplate
+ */
+MateUiContextMenuTemplate *mate_ui_context_menu_template_new(MateUiContextMenuActivateFunc activate,
+                                                             MateUiContextMenuStateFunc    state,
+                                                             gpointer                      user_data,
+                                                             GDestroyNotify                destroy);
+
+/**
+ * mate_ui_context_menu_template_free:
+ * @tmpl: A #MateUiContextMenuTemplate
+ *
+ * Destroys the menu of a template and frees it, releasing the context
+ * of the last popup.
+ */
+void mate_ui_context_menu_template_free(MateUiContextMenuTemplate *tmpl);
+
+/**
+ * mate_ui_context_menu_template_add_item:
+ * @tmpl: A #MateUiContextMenuTemplate
+ * @id: An application defined item id
+ * @label: The item label
+ *
+ * Appends an item to the template. @id is passed to the state and
+ * activate functions of the template.
+ *
+ * Returns: (transfer none): The new menu item
+ */
+GtkWidget *mate_ui_context_menu_template_add_item(MateUiContextMenuTemplate *tmpl,
+                                                  guint                      id,
+                                                  const gchar               *label);
+
+/**
+ * mate_ui_context_menu_template_add_separator:
+ * @tmpl: A #MateUiContextMenuTemplate
+ *
+ * Appends a separator to the template. It is only shown when visible
+ * items precede and follow it.
+ */
+void mate_ui_context_menu_template_add_separator(MateUiContextMenuTemplate *tmpl);
+
+/**
+ * mate_ui_context_menu_template_get_menu:
+ * @tmpl: A #MateUiContextMenuTemplate
+ *
+ * Gets the menu of a template.
+ *
+ * Returns: (transfer none): The #GtkMenu of the template
+ */
+GtkWidget *mate_ui_context_menu_template_get_menu(MateUiContextMenuTemplate *tmpl);
+
+/**
+ * mate_ui_context_menu_template_popup_at_pointer:
+ * @tmpl: A #MateUiContextMenuTemplate
+ * @context: (nullable): Context passed to the state and activate functions
+ * @context_destroy: (nullable): Destroy notify for @context
+ * @event: (nullable): The triggering event or %NULL
+ *
+ * Updates the items of the template for @context and shows its menu at
+ * the pointer position. @context is kept until the next popup or until
+ * the template is freed. Nothing is shown if no item is visible.
+ *
+ * Returns: %TRUE if the menu was shown
+ */
+gboolean mate_ui_context_menu_template_popup_at_pointer(MateUiContextMenuTemplate *tmpl,
+                                                        gpointer                   context,
+                                                        GDestroyNotify             context_destroy,
+                                                        const GdkEvent            *event);
+
+/**
+ * mate_ui_context_menu_template_popup_at_widget:
+ * @tmpl: A #MateUiContextMenuTemplate
+ * @context: (nullable): Context passed to the state and activate functions
+ * @context_destroy: (nullable): Destroy notify for @context
+ * @widget: The widget to popup at
+ * @widget_anchor: Anchor point on widget
+ * @menu_anchor: Anchor point on menu
+ *
+ * Like mate_ui_context_menu_template_popup_at_pointer(), but anchors
+ * the menu to a widget.
+ *
+ * Returns: %TRUE if the menu was shown
+ */
+gboolean mate_ui_context_menu_template_popup_at_widget(MateUiContextMenuTemplate *tmpl,
+                                                       gpointer                   context,
+                                                       GDestroyNotify             context_destroy,
+                                                       GtkWidget                 *widget,
+                                                       GdkGravity                 widget_anchor,
+                                                       GdkGravity                 menu_anchor);
+
 G_END_DECLS
 
 #endif /* MATE_UI_MENU_H */
@@ -0,0 +1,51 @@
+/*
+ * mate-ui-private.h - Internal declarations shared between libmateui modules
+ *
+ * Copyright (C) 2024 MATE Desktop Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+#ifndef MATE_UI_PRIVATE_H
+#define MATE_UI_PRIVATE_H
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/* mate-ui-session.c */
+G_GNUC_INTERNAL
+void _mate_ui_session_init(void);
+
+/*
+ * mate-ui-accel.c, mateui-compile-ui: hash for the perfect-hash action
+ * index of compiled accelerator tables. Generated tables depend on it,
+ * so it must not change.
+ */
+static inline guint32
+_mate_ui_compiled_hash(const gchar *str,
+                       guint32      seed)
+{
+    guint32 h = 2166136261u ^ seed;
+
+    for (; *str != '\0'; str++)
+    {
+        h ^= (guchar) *str;
+        h *= 16777619u;
+    }
+
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+
+    return h;
+}
+
+G_END_DECLS
+
+#endif /* MATE_UI_PRIVATE_H */
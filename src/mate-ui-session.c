@@ -11,23 +11,25 @@
 
 #include "config.h"
 #include "mate-ui-session.h"
+#include "mate-ui-private.h"
 
 #include <gio/gio.h>
 
-#ifdef HAVE_X11
+#if HAVE_X11
 #include <gdk/gdkx.h>
-#ifdef HAVE_XSS
+#if HAVE_XSS
 #include <X11/extensions/scrnsaver.h>
 #endif
+#if HAVE_XSYNC
+#include <X11/extensions/sync.h>
 #endif
+#endif
+
+typedef struct _InhibitEntry InhibitEntry;
 
 struct _MateUiSessionInhibitor
 {
-    GtkApplication     *app;
-    guint               cookie;
-    MateUiInhibitFlags  flags;
-    gboolean            is_dbus;
-    guint               dbus_cookie;
+    InhibitEntry *entry;
 };
 
 /* Session manager D-Bus interface */
@@ -35,30 +37,238 @@ struct _MateUiSessionInhibitor
 #define SM_DBUS_PATH      "/org/gnome/SessionManager"
 #define SM_DBUS_INTERFACE "org.gnome.SessionManager"
 
-static GDBusProxy *
-get_session_manager_proxy(void)
+/*
+ * The session manager proxy is created asynchronously once the bus name
+ * appears, and dropped again when it vanishes. Calls issued while the
+ * proxy is being created are queued rather than blocking the caller.
+ */
+typedef enum
+{
+    SM_STATE_IDLE,
+    SM_STATE_PENDING,
+    SM_STATE_READY,
+    SM_STATE_UNAVAILABLE,
+} SessionManagerState;
+
+typedef struct
+{
+    SessionManagerState  state;
+    guint                watch_id;
+    GDBusProxy          *proxy;
+    GCancellable        *cancellable;
+    GMainContext        *context;
+    GQueue               queue;
+} SessionManager;
+
+static SessionManager session_manager = { SM_STATE_IDLE, 0, NULL, NULL, NULL, G_QUEUE_INIT };
+
+static void inhibit_state_attach(GDBusConnection *connection);
+static void inhibit_state_detach(gboolean available);
+static void session_client_attach(GtkApplication *app,
+                                  const gchar    *path,
+                                  GTask          *task);
+static void session_client_attach_connection(GtkApplication  *app,
+                                             const gchar     *path,
+                                             GDBusConnection *connection);
+static void session_client_detach(void);
+
+#define SM_PROXY_FLAGS (G_DBUS_PROXY_FLAGS_DO_NOT_LOAD_PROPERTIES | \
+                        G_DBUS_PROXY_FLAGS_DO_NOT_CONNECT_SIGNALS | \
+                        G_DBUS_PROXY_FLAGS_DO_NOT_AUTO_START)
+
+/* Completes every queued proxy request, with the proxy or with @error */
+static void
+session_manager_flush(const GError *error)
 {
-    static GDBusProxy *proxy = NULL;
+    GTask *task;
 
-    if (proxy == NULL)
+    while ((task = g_queue_pop_head(&session_manager.queue)) != NULL)
     {
-        GError *error = NULL;
-        proxy = g_dbus_proxy_new_for_bus_sync(G_BUS_TYPE_SESSION,
-                                               G_DBUS_PROXY_FLAGS_NONE,
-                                               NULL,
-                                               SM_DBUS_NAME,
-                                               SM_DBUS_PATH,
-                                               SM_DBUS_INTERFACE,
-                                               NULL,
-                                               &error);
-        if (error != NULL)
+        if (g_task_return_error_if_cancelled(task))
         {
-            g_warning("Failed to connect to session manager: %s", error->message);
-            g_error_free(error);
+            /* Nothing left to do */
+        }
+        else if (error != NULL)
+        {
+            g_task_return_error(task, g_error_copy(error));
+        }
+        else
+        {
+            g_task_return_pointer(task, g_object_ref(session_manager.proxy), g_object_unref);
         }
+
+        g_object_unref(task);
+    }
+}
+
+static void
+session_manager_proxy_ready_cb(GObject      *source G_GNUC_UNUSED,
+                               GAsyncResult *result,
+                               gpointer      user_data G_GNUC_UNUSED)
+{
+    GError *error = NULL;
+
+    GDBusProxy *proxy = g_dbus_proxy_new_finish(result, &error);
+    if (proxy == NULL && g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        /* Superseded by a later appeared/vanished notification */
+        g_error_free(error);
+        return;
+    }
+
+    g_clear_object(&session_manager.cancellable);
+
+    if (proxy == NULL)
+    {
+        g_warning("Failed to connect to session manager: %s", error->message);
+        session_manager.state = SM_STATE_UNAVAILABLE;
+        inhibit_state_detach(FALSE);
+        session_manager_flush(error);
+        g_error_free(error);
+        return;
+    }
+
+    session_manager.proxy = proxy;
+    session_manager.state = SM_STATE_READY;
+    inhibit_state_attach(g_dbus_proxy_get_connection(proxy));
+    session_manager_flush(NULL);
+}
+
+static void
+session_manager_appeared_cb(GDBusConnection *connection,
+                            const gchar     *name G_GNUC_UNUSED,
+                            const gchar     *name_owner G_GNUC_UNUSED,
+                            gpointer         user_data G_GNUC_UNUSED)
+{
+    g_cancellable_cancel(session_manager.cancellable);
+    g_clear_object(&session_manager.cancellable);
+    g_clear_object(&session_manager.proxy);
+    inhibit_state_detach(TRUE);
+
+    session_manager.state = SM_STATE_PENDING;
+    session_manager.cancellable = g_cancellable_new();
+
+    g_dbus_proxy_new(connection,
+                     SM_PROXY_FLAGS,
+                     NULL,
+                     SM_DBUS_NAME,
+                     SM_DBUS_PATH,
+                     SM_DBUS_INTERFACE,
+                     session_manager.cancellable,
+                     session_manager_proxy_ready_cb,
+                     NULL);
+}
+
+static void
+session_manager_vanished_cb(GDBusConnection *connection G_GNUC_UNUSED,
+                            const gchar     *name G_GNUC_UNUSED,
+                            gpointer         user_data G_GNUC_UNUSED)
+{
+    g_cancellable_cancel(session_manager.cancellable);
+    g_clear_object(&session_manager.cancellable);
+    g_clear_object(&session_manager.proxy);
+    inhibit_state_detach(FALSE);
+    session_client_detach();
+
+    session_manager.state = SM_STATE_UNAVAILABLE;
+
+    GError *error = g_error_new_literal(G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                                        "Session manager is not running");
+    session_manager_flush(error);
+    g_error_free(error);
+}
+
+/*
+ * _mate_ui_session_init:
+ *
+ * Starts watching for the session manager on the bus. Called from
+ * application startup; safe to call more than once.
+ */
+void
+_mate_ui_session_init(void)
+{
+    if (session_manager.state != SM_STATE_IDLE)
+        return;
+
+    session_manager.state = SM_STATE_PENDING;
+    session_manager.context = g_main_context_ref_thread_default();
+    session_manager.watch_id = g_bus_watch_name(G_BUS_TYPE_SESSION,
+                                                SM_DBUS_NAME,
+                                                G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                session_manager_appeared_cb,
+                                                session_manager_vanished_cb,
+                                                NULL,
+                                                NULL);
+}
+
+static void
+session_manager_private_proxy_cb(GObject      *source G_GNUC_UNUSED,
+                                 GAsyncResult *result,
+                                 gpointer      user_data)
+{
+    GTask *task = user_data;
+    GError *error = NULL;
+
+    GDBusProxy *proxy = g_dbus_proxy_new_for_bus_finish(result, &error);
+    if (proxy != NULL)
+        g_task_return_pointer(task, proxy, g_object_unref);
+    else
+        g_task_return_error(task, error);
+
+    g_object_unref(task);
+}
+
+/* Completes @task with a ref on the session manager proxy */
+static void
+session_manager_acquire(GTask *task)
+{
+    GMainContext *context = g_main_context_ref_thread_default();
+
+    /* Lazily start watching if the application did not do so at startup */
+    if (session_manager.state == SM_STATE_IDLE && context == g_main_context_default())
+        _mate_ui_session_init();
+
+    switch (session_manager.state)
+    {
+        case SM_STATE_READY:
+            g_task_return_pointer(task, g_object_ref(session_manager.proxy), g_object_unref);
+            g_object_unref(task);
+            break;
+
+        case SM_STATE_UNAVAILABLE:
+            g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                                    "Session manager is not running");
+            g_object_unref(task);
+            break;
+
+        case SM_STATE_PENDING:
+        case SM_STATE_IDLE:
+        default:
+            if (context == session_manager.context)
+            {
+                g_queue_push_tail(&session_manager.queue, task);
+            }
+            else
+            {
+                /*
+                 * The caller is iterating a different context (for example
+                 * a synchronous call), so the watch cannot make progress
+                 * for it. Give it a short-lived proxy of its own instead.
+                 */
+                g_dbus_proxy_new_for_bus(G_BUS_TYPE_SESSION,
+                                         SM_PROXY_FLAGS,
+                                         NULL,
+                                         SM_DBUS_NAME,
+                                         SM_DBUS_PATH,
+                                         SM_DBUS_INTERFACE,
+                                         g_task_get_cancellable(task),
+                                         session_manager_private_proxy_cb,
+                                         task);
+            }
+            break;
     }
 
-    return proxy;
+    g_main_context_unref(context);
 }
 
 /* Convert our flags to GNOME SessionManager flags */
@@ -79,504 +289,3228 @@ convert_inhibit_flags(MateUiInhibitFlags flags)
     return sm_flags;
 }
 
+/* Timeout applied to every session manager call, in milliseconds */
+static gint session_timeout = MATE_UI_SESSION_DEFAULT_TIMEOUT;
+
 /**
- * mate_ui_session_inhibit:
- * @app: (nullable): A #GtkApplication or %NULL
- * @window: (nullable): A #GtkWindow or %NULL
- * @flags: What to inhibit
- * @reason: Human-readable reason for the inhibition
+ * mate_ui_session_set_timeout:
+ * @timeout_ms: Timeout in milliseconds, or -1 for the D-Bus default
+ *
+ * Sets the timeout applied to session manager calls.
+ */
+void
+mate_ui_session_set_timeout(gint timeout_ms)
+{
+    g_return_if_fail(timeout_ms >= -1);
+
+    session_timeout = timeout_ms;
+}
+
+/**
+ * mate_ui_session_get_timeout:
  *
- * Inhibits session actions.
+ * Gets the timeout applied to session manager calls.
  *
- * Returns: (transfer full) (nullable): An inhibitor handle or %NULL on failure
+ * Returns: Timeout in milliseconds
  */
-MateUiSessionInhibitor *
-mate_ui_session_inhibit(GtkApplication     *app,
-                         GtkWindow          *window,
-                         MateUiInhibitFlags  flags,
-                         const gchar        *reason)
+gint
+mate_ui_session_get_timeout(void)
 {
-    g_return_val_if_fail(reason != NULL, NULL);
+    return session_timeout;
+}
 
-    MateUiSessionInhibitor *inhibitor = g_new0(MateUiSessionInhibitor, 1);
-    inhibitor->flags = flags;
+/*
+ * Inhibited actions, tracked from the session manager's InhibitorAdded
+ * and InhibitorRemoved signals and its InhibitedActions property, so that
+ * mate_ui_session_is_inhibited() can be answered without a bus call.
+ */
+#define DBUS_PROPERTIES_INTERFACE "org.freedesktop.DBus.Properties"
+
+typedef struct
+{
+    GDBusConnection    *connection;
+    guint               subscription_id;
+    GCancellable       *cancellable;
+    gboolean            valid;
+    gboolean            no_property;
+    MateUiInhibitFlags  flags;
+} InhibitState;
+
+static InhibitState inhibit_state = { NULL, 0, NULL, FALSE, FALSE, 0 };
+
+/* Inhibit flags probed one by one when InhibitedActions is not exported */
+static const MateUiInhibitFlags inhibit_probe_flags[] = {
+    MATE_UI_INHIBIT_LOGOUT,
+    MATE_UI_INHIBIT_USER_SWITCH,
+    MATE_UI_INHIBIT_SUSPEND,
+    MATE_UI_INHIBIT_IDLE,
+};
+
+typedef struct
+{
+    GCancellable       *cancellable;
+    guint               index;
+    MateUiInhibitFlags  flags;
+} InhibitProbe;
+
+struct _MateUiSessionMonitor
+{
+    GObject parent_instance;
+};
+
+G_DEFINE_TYPE(MateUiSessionMonitor, mate_ui_session_monitor, G_TYPE_OBJECT)
+
+enum
+{
+    SIGNAL_INHIBITED_CHANGED,
+    N_SIGNALS
+};
+
+static guint monitor_signals[N_SIGNALS];
+
+static MateUiSessionMonitor *session_monitor = NULL;
+
+static void
+mate_ui_session_monitor_class_init(MateUiSessionMonitorClass *klass)
+{
+    /**
+     * MateUiSessionMonitor::inhibited-changed:
+     * @monitor: The #MateUiSessionMonitor
+     * @flags: The #MateUiInhibitFlags now inhibited
+     *
+     * Emitted when the set of inhibited session actions changes.
+     */
+    monitor_signals[SIGNAL_INHIBITED_CHANGED] =
+        g_signal_new("inhibited-changed",
+                     G_TYPE_FROM_CLASS(klass),
+                     G_SIGNAL_RUN_LAST,
+                     0,
+                     NULL, NULL,
+                     NULL,
+                     G_TYPE_NONE, 1,
+                     G_TYPE_UINT);
+}
+
+static void
+mate_ui_session_monitor_init(MateUiSessionMonitor *monitor G_GNUC_UNUSED)
+{
+}
 
-    /* Try GTK application inhibit first */
-    if (app != NULL && GTK_IS_APPLICATION(app))
+/* Convert GNOME SessionManager flags to our flags */
+static MateUiInhibitFlags
+convert_sm_inhibit_flags(guint sm_flags)
+{
+    MateUiInhibitFlags flags = 0;
+
+    if (sm_flags & 1)
+        flags |= MATE_UI_INHIBIT_LOGOUT;
+    if (sm_flags & 2)
+        flags |= MATE_UI_INHIBIT_USER_SWITCH;
+    if (sm_flags & 4)
+        flags |= MATE_UI_INHIBIT_SUSPEND;
+    if (sm_flags & 8)
+        flags |= MATE_UI_INHIBIT_IDLE;
+
+    return flags;
+}
+
+static void
+inhibit_state_set(MateUiInhibitFlags flags)
+{
+    gboolean changed = !inhibit_state.valid || inhibit_state.flags != flags;
+
+    inhibit_state.valid = TRUE;
+    inhibit_state.flags = flags;
+
+    if (changed && session_monitor != NULL)
+        g_signal_emit(session_monitor, monitor_signals[SIGNAL_INHIBITED_CHANGED], 0, (guint) flags);
+}
+
+static void inhibit_state_probe_next(InhibitProbe *probe);
+
+static void
+inhibit_state_probe_cb(GObject      *source,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+    InhibitProbe *probe = user_data;
+    GError *error = NULL;
+
+    GVariant *reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error);
+    if (reply != NULL && g_cancellable_is_cancelled(probe->cancellable))
+    {
+        /* Superseded after the reply arrived */
+        g_variant_unref(reply);
+        reply = NULL;
+        g_set_error_literal(&error, G_IO_ERROR, G_IO_ERROR_CANCELLED, "Operation was cancelled");
+    }
+
+    if (reply == NULL)
+    {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_warning("Failed to query inhibited actions: %s", error->message);
+
+        g_error_free(error);
+        g_object_unref(probe->cancellable);
+        g_free(probe);
+        return;
+    }
+
+    gboolean inhibited;
+    g_variant_get(reply, "(b)", &inhibited);
+    g_variant_unref(reply);
+
+    if (inhibited)
+        probe->flags |= inhibit_probe_flags[probe->index];
+
+    probe->index++;
+    inhibit_state_probe_next(probe);
+}
+
+static void
+inhibit_state_probe_next(InhibitProbe *probe)
+{
+    if (probe->index == G_N_ELEMENTS(inhibit_probe_flags))
     {
-        GtkApplicationInhibitFlags gtk_flags = 0;
+        inhibit_state_set(probe->flags);
+        g_object_unref(probe->cancellable);
+        g_free(probe);
+        return;
+    }
+
+    g_dbus_connection_call(inhibit_state.connection,
+                           SM_DBUS_NAME,
+                           SM_DBUS_PATH,
+                           SM_DBUS_INTERFACE,
+                           "IsInhibited",
+                           g_variant_new("(u)", convert_inhibit_flags(inhibit_probe_flags[probe->index])),
+                           G_VARIANT_TYPE("(b)"),
+                           G_DBUS_CALL_FLAGS_NONE,
+                           session_timeout,
+                           probe->cancellable,
+                           inhibit_state_probe_cb,
+                           probe);
+}
+
+static void
+inhibit_state_probe(void)
+{
+    InhibitProbe *probe = g_new0(InhibitProbe, 1);
+    probe->cancellable = g_object_ref(inhibit_state.cancellable);
+
+    inhibit_state_probe_next(probe);
+}
+
+static void
+inhibit_state_get_cb(GObject      *source,
+                     GAsyncResult *result,
+                     gpointer      user_data)
+{
+    GCancellable *cancellable = user_data;
+    GError *error = NULL;
 
-        if (flags & MATE_UI_INHIBIT_LOGOUT)
-            gtk_flags |= GTK_APPLICATION_INHIBIT_LOGOUT;
-        if (flags & MATE_UI_INHIBIT_USER_SWITCH)
-            gtk_flags |= GTK_APPLICATION_INHIBIT_SWITCH;
-        if (flags & MATE_UI_INHIBIT_SUSPEND)
-            gtk_flags |= GTK_APPLICATION_INHIBIT_SUSPEND;
-        if (flags & MATE_UI_INHIBIT_IDLE)
-            gtk_flags |= GTK_APPLICATION_INHIBIT_IDLE;
+    GVariant *reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error);
+    gboolean superseded = g_cancellable_is_cancelled(cancellable);
+    g_object_unref(cancellable);
+
+    if (reply != NULL && superseded)
+    {
+        g_variant_unref(reply);
+        return;
+    }
 
-        inhibitor->cookie = gtk_application_inhibit(app, window, gtk_flags, reason);
-        if (inhibitor->cookie != 0)
+    if (reply == NULL)
+    {
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
         {
-            inhibitor->app = g_object_ref(app);
-            inhibitor->is_dbus = FALSE;
-            return inhibitor;
+            g_error_free(error);
+            return;
         }
+
+        /* Older session managers lack the property; ask per flag instead */
+        inhibit_state.no_property = TRUE;
+        g_error_free(error);
+        inhibit_state_probe();
+        return;
     }
 
-    /* Fall back to D-Bus session manager */
-    GDBusProxy *proxy = get_session_manager_proxy();
-    if (proxy != NULL)
+    GVariant *value;
+    g_variant_get(reply, "(v)", &value);
+
+    if (g_variant_is_of_type(value, G_VARIANT_TYPE_UINT32))
+    {
+        inhibit_state_set(convert_sm_inhibit_flags(g_variant_get_uint32(value)));
+    }
+    else
+    {
+        inhibit_state.no_property = TRUE;
+        inhibit_state_probe();
+    }
+
+    g_variant_unref(value);
+    g_variant_unref(reply);
+}
+
+/* Re-reads the inhibited actions, superseding any read in progress */
+static void
+inhibit_state_refresh(void)
+{
+    g_cancellable_cancel(inhibit_state.cancellable);
+    g_clear_object(&inhibit_state.cancellable);
+    inhibit_state.cancellable = g_cancellable_new();
+
+    if (inhibit_state.no_property)
     {
-        const gchar *app_id = app ? g_application_get_application_id(G_APPLICATION(app)) : "mate-application";
-        guint32 toplevel_xid = 0;
+        inhibit_state_probe();
+        return;
+    }
+
+    g_dbus_connection_call(inhibit_state.connection,
+                           SM_DBUS_NAME,
+                           SM_DBUS_PATH,
+                           DBUS_PROPERTIES_INTERFACE,
+                           "Get",
+                           g_variant_new("(ss)", SM_DBUS_INTERFACE, "InhibitedActions"),
+                           G_VARIANT_TYPE("(v)"),
+                           G_DBUS_CALL_FLAGS_NONE,
+                           session_timeout,
+                           inhibit_state.cancellable,
+                           inhibit_state_get_cb,
+                           g_object_ref(inhibit_state.cancellable));
+}
 
-#ifdef HAVE_X11
-        if (window != NULL && gtk_widget_get_realized(GTK_WIDGET(window)))
+static void
+inhibit_state_signal_cb(GDBusConnection *connection G_GNUC_UNUSED,
+                        const gchar     *sender_name G_GNUC_UNUSED,
+                        const gchar     *object_path G_GNUC_UNUSED,
+                        const gchar     *interface_name,
+                        const gchar     *signal_name,
+                        GVariant        *parameters,
+                        gpointer         user_data G_GNUC_UNUSED)
+{
+    if (g_strcmp0(interface_name, SM_DBUS_INTERFACE) == 0)
+    {
+        if (g_strcmp0(signal_name, "InhibitorAdded") == 0 ||
+            g_strcmp0(signal_name, "InhibitorRemoved") == 0)
         {
-            GdkWindow *gdk_window = gtk_widget_get_window(GTK_WIDGET(window));
-            if (GDK_IS_X11_WINDOW(gdk_window))
-            {
-                toplevel_xid = GDK_WINDOW_XID(gdk_window);
-            }
+            inhibit_state_refresh();
         }
-#endif
+        return;
+    }
+
+    if (g_strcmp0(interface_name, DBUS_PROPERTIES_INTERFACE) != 0 ||
+        g_strcmp0(signal_name, "PropertiesChanged") != 0 ||
+        !g_variant_is_of_type(parameters, G_VARIANT_TYPE("(sa{sv}as)")))
+    {
+        return;
+    }
+
+    const gchar *interface;
+    GVariant *changed;
+    const gchar **invalidated;
 
-        GError *error = NULL;
-        GVariant *result = g_dbus_proxy_call_sync(proxy,
-                                                   "Inhibit",
-                                                   g_variant_new("(susu)",
-                                                                  app_id,
-                                                                  toplevel_xid,
-                                                                  reason,
-                                                                  convert_inhibit_flags(flags)),
-                                                   G_DBUS_CALL_FLAGS_NONE,
-                                                   -1,
-                                                   NULL,
-                                                   &error);
-
-        if (result != NULL)
+    g_variant_get(parameters, "(&s@a{sv}^a&s)", &interface, &changed, &invalidated);
+
+    if (g_strcmp0(interface, SM_DBUS_INTERFACE) == 0)
+    {
+        guint32 actions;
+
+        if (g_variant_lookup(changed, "InhibitedActions", "u", &actions))
         {
-            g_variant_get(result, "(u)", &inhibitor->dbus_cookie);
-            g_variant_unref(result);
-            inhibitor->is_dbus = TRUE;
-            return inhibitor;
+            inhibit_state.no_property = FALSE;
+            inhibit_state_set(convert_sm_inhibit_flags(actions));
         }
-
-        if (error != NULL)
+        else if (g_strv_contains(invalidated, "InhibitedActions"))
         {
-            g_warning("Failed to inhibit via session manager: %s", error->message);
-            g_error_free(error);
+            inhibit_state_refresh();
         }
     }
 
-    g_free(inhibitor);
-    return NULL;
+    g_variant_unref(changed);
+    g_free(invalidated);
+}
+
+/* Starts tracking inhibited actions on the session manager at @connection */
+static void
+inhibit_state_attach(GDBusConnection *connection)
+{
+    inhibit_state.connection = g_object_ref(connection);
+    inhibit_state.subscription_id =
+        g_dbus_connection_signal_subscribe(connection,
+                                           SM_DBUS_NAME,
+                                           NULL,
+                                           NULL,
+                                           SM_DBUS_PATH,
+                                           NULL,
+                                           G_DBUS_SIGNAL_FLAGS_NONE,
+                                           inhibit_state_signal_cb,
+                                           NULL,
+                                           NULL);
+
+    inhibit_state_refresh();
+}
+
+/*
+ * Stops tracking. If @available is %FALSE there is no session manager,
+ * so nothing is inhibited; otherwise the state is unknown until the next
+ * attach.
+ */
+static void
+inhibit_state_detach(gboolean available)
+{
+    g_cancellable_cancel(inhibit_state.cancellable);
+    g_clear_object(&inhibit_state.cancellable);
+
+    if (inhibit_state.subscription_id != 0)
+    {
+        g_dbus_connection_signal_unsubscribe(inhibit_state.connection,
+                                             inhibit_state.subscription_id);
+        inhibit_state.subscription_id = 0;
+    }
+
+    g_clear_object(&inhibit_state.connection);
+    inhibit_state.no_property = FALSE;
+
+    if (available)
+        inhibit_state.valid = FALSE;
+    else
+        inhibit_state_set(0);
+}
+
+/**
+ * mate_ui_session_monitor_get_default:
+ *
+ * Gets the monitor that reports changes in session state. Getting it
+ * starts watching the session manager if that has not happened yet.
+ *
+ * Returns: (transfer none): The default #MateUiSessionMonitor
+ */
+MateUiSessionMonitor *
+mate_ui_session_monitor_get_default(void)
+{
+    if (session_monitor == NULL)
+        session_monitor = g_object_new(MATE_UI_TYPE_SESSION_MONITOR, NULL);
+
+    GMainContext *context = g_main_context_ref_thread_default();
+    if (context == g_main_context_default())
+        _mate_ui_session_init();
+    g_main_context_unref(context);
+
+    return session_monitor;
+}
+
+/**
+ * mate_ui_session_get_inhibited_flags:
+ *
+ * Gets the session actions currently inhibited by any client, as last
+ * reported by the session manager. No bus call is made.
+ *
+ * Returns: The inhibited #MateUiInhibitFlags, or 0 if not yet known
+ */
+MateUiInhibitFlags
+mate_ui_session_get_inhibited_flags(void)
+{
+    return inhibit_state.valid ? inhibit_state.flags : 0;
+}
+
+/* Pending session manager call */
+typedef void (*SessionReplyFunc)(GTask *task, GVariant *reply);
+
+typedef struct
+{
+    GTask            *task;
+    const gchar      *method;
+    GVariant         *parameters;
+    SessionReplyFunc  reply_func;
+} SessionCall;
+
+static void
+session_call_free(SessionCall *call)
+{
+    g_object_unref(call->task);
+    if (call->parameters != NULL)
+        g_variant_unref(call->parameters);
+    g_free(call);
+}
+
+static void
+session_call_cb(GObject      *source,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+    SessionCall *call = user_data;
+    GError *error = NULL;
+
+    GVariant *reply = g_dbus_proxy_call_finish(G_DBUS_PROXY(source), result, &error);
+    if (reply != NULL)
+    {
+        call->reply_func(call->task, reply);
+        g_variant_unref(reply);
+    }
+    else
+    {
+        g_task_return_error(call->task, error);
+    }
+
+    session_call_free(call);
+}
+
+static void
+session_call_proxy_cb(GObject      *source G_GNUC_UNUSED,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+    SessionCall *call = user_data;
+    GError *error = NULL;
+
+    GDBusProxy *proxy = g_task_propagate_pointer(G_TASK(result), &error);
+    if (proxy == NULL)
+    {
+        g_task_return_error(call->task, error);
+        session_call_free(call);
+        return;
+    }
+
+    g_dbus_proxy_call(proxy,
+                      call->method,
+                      call->parameters,
+                      G_DBUS_CALL_FLAGS_NONE,
+                      session_timeout,
+                      g_task_get_cancellable(call->task),
+                      session_call_cb,
+                      call);
+    g_object_unref(proxy);
+}
+
+/*
+ * Calls @method on the session manager and completes @task via
+ * @reply_func. @method must be a static string. Takes ownership of @task.
+ */
+static void
+session_call(GTask            *task,
+             const gchar      *method,
+             GVariant         *parameters,
+             SessionReplyFunc  reply_func)
+{
+    SessionCall *call = g_new0(SessionCall, 1);
+    call->task = task;
+    call->method = method;
+    call->parameters = parameters ? g_variant_ref_sink(parameters) : NULL;
+    call->reply_func = reply_func;
+
+    session_manager_acquire(g_task_new(NULL,
+                                       g_task_get_cancellable(task),
+                                       session_call_proxy_cb,
+                                       call));
+}
+
+/*
+ * Like session_call(), but issued from the default main context with an
+ * internal task that has no cancellable. For calls that change state on
+ * the session manager: they are seen through even when the caller has
+ * given up, or stopped running the context it called from. @callback
+ * runs on the default context.
+ */
+static void
+session_call_detached(const gchar         *method,
+                      GVariant            *parameters,
+                      SessionReplyFunc     reply_func,
+                      GAsyncReadyCallback  callback,
+                      gpointer             user_data)
+{
+    g_main_context_push_thread_default(g_main_context_default());
+    session_call(g_task_new(NULL, NULL, callback, user_data),
+                 method,
+                 parameters,
+                 reply_func);
+    g_main_context_pop_thread_default(g_main_context_default());
+}
+
+static void
+session_reply_boolean(GTask    *task,
+                      GVariant *reply)
+{
+    gboolean value;
+
+    g_variant_get(reply, "(b)", &value);
+    g_task_return_boolean(task, value);
+}
+
+static void
+session_reply_ignore(GTask    *task,
+                     GVariant *reply G_GNUC_UNUSED)
+{
+    g_task_return_boolean(task, TRUE);
+}
+
+/*
+ * Synchronous calls run the asynchronous variant on a private main
+ * context, so the caller's context is not re-entered, and give up once
+ * the session timeout has elapsed.
+ */
+typedef struct
+{
+    GMainContext *context;
+    GCancellable *cancellable;
+    GSource      *deadline;
+    GAsyncResult *result;
+} SessionSync;
+
+static gboolean
+session_sync_deadline_cb(gpointer user_data)
+{
+    SessionSync *sync = user_data;
+
+    g_cancellable_cancel(sync->cancellable);
+    return G_SOURCE_REMOVE;
+}
+
+static void
+session_sync_cb(GObject      *source G_GNUC_UNUSED,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+    SessionSync *sync = user_data;
+
+    sync->result = g_object_ref(result);
+    g_main_context_wakeup(sync->context);
+}
+
+static void
+session_sync_begin(SessionSync *sync)
+{
+    sync->context = g_main_context_new();
+    sync->cancellable = g_cancellable_new();
+    sync->deadline = NULL;
+    sync->result = NULL;
+
+    g_main_context_push_thread_default(sync->context);
+
+    if (session_timeout >= 0)
+    {
+        sync->deadline = g_timeout_source_new(session_timeout);
+        g_source_set_callback(sync->deadline, session_sync_deadline_cb, sync, NULL);
+        g_source_attach(sync->deadline, sync->context);
+    }
+}
+
+/* Returns: (transfer full): the result of the call started after begin */
+static GAsyncResult *
+session_sync_end(SessionSync *sync)
+{
+    while (sync->result == NULL)
+        g_main_context_iteration(sync->context, TRUE);
+
+    if (sync->deadline != NULL)
+    {
+        g_source_destroy(sync->deadline);
+        g_source_unref(sync->deadline);
+    }
+
+    g_main_context_pop_thread_default(sync->context);
+    g_main_context_unref(sync->context);
+    g_object_unref(sync->cancellable);
+
+    return sync->result;
+}
+
+/*
+ * Blocking calls
+ *
+ * A synchronous caller cannot simply stop waiting for a call that changes
+ * state on the session manager, which may act on it anyway. Such calls
+ * are made from a worker thread, and the caller waits on a condition for
+ * at most the session timeout. If the reply only arrives once the caller
+ * has given up, the worker undoes the call by passing the reply to
+ * @undo_method.
+ */
+typedef struct
+{
+    GMutex              lock;
+    GCond               cond;
+    gboolean            done;
+    gboolean            abandoned;
+
+    const gchar        *method;
+    GVariant           *parameters;
+    const GVariantType *reply_type;
+    const gchar        *undo_method;
+
+    GDBusConnection    *connection;
+    GVariant           *reply;
+    GError             *error;
+} SessionBlockingCall;
+
+static void
+session_blocking_call_free(SessionBlockingCall *call)
+{
+    g_mutex_clear(&call->lock);
+    g_cond_clear(&call->cond);
+    g_variant_unref(call->parameters);
+    g_clear_object(&call->connection);
+    if (call->reply != NULL)
+        g_variant_unref(call->reply);
+    g_clear_error(&call->error);
+    g_free(call);
+}
+
+static void
+session_blocking_call_thread(GTask        *task G_GNUC_UNUSED,
+                             gpointer      source_object G_GNUC_UNUSED,
+                             gpointer      task_data,
+                             GCancellable *cancellable G_GNUC_UNUSED)
+{
+    SessionBlockingCall *call = task_data;
+    GVariant *reply = NULL;
+    GError *error = NULL;
+
+    /* Not bounded by the session timeout, so a late reply is still seen */
+    GDBusConnection *connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+    if (connection != NULL)
+    {
+        reply = g_dbus_connection_call_sync(connection,
+                                            SM_DBUS_NAME,
+                                            SM_DBUS_PATH,
+                                            SM_DBUS_INTERFACE,
+                                            call->method,
+                                            call->parameters,
+                                            call->reply_type,
+                                            G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                            -1,
+                                            NULL,
+                                            &error);
+    }
+
+    g_mutex_lock(&call->lock);
+    gboolean abandoned = call->abandoned;
+    if (!abandoned)
+    {
+        /* The caller frees @call once woken */
+        call->connection = connection;
+        call->reply = reply;
+        call->error = error;
+        call->done = TRUE;
+        g_cond_signal(&call->cond);
+    }
+    g_mutex_unlock(&call->lock);
+
+    if (!abandoned)
+        return;
+
+    if (reply != NULL)
+    {
+        GVariant *undone = g_dbus_connection_call_sync(connection,
+                                                       SM_DBUS_NAME,
+                                                       SM_DBUS_PATH,
+                                                       SM_DBUS_INTERFACE,
+                                                       call->undo_method,
+                                                       reply,
+                                                       NULL,
+                                                       G_DBUS_CALL_FLAGS_NO_AUTO_START,
+                                                       -1,
+                                                       NULL,
+                                                       NULL);
+        if (undone != NULL)
+            g_variant_unref(undone);
+        g_variant_unref(reply);
+    }
+
+    g_clear_object(&connection);
+    g_clear_error(&error);
+    session_blocking_call_free(call);
+}
+
+/*
+ * Calls @method and waits for at most the session timeout. On success,
+ * the connection the call went over is returned in @connection, if not
+ * %NULL.
+ *
+ * Returns: (transfer full) (nullable): the reply, or %NULL on error
+ */
+static GVariant *
+session_blocking_call(const gchar         *method,
+                      GVariant            *parameters,
+                      const GVariantType  *reply_type,
+                      const gchar         *undo_method,
+                      GDBusConnection    **connection,
+                      GError             **error)
+{
+    SessionBlockingCall *call = g_new0(SessionBlockingCall, 1);
+    g_mutex_init(&call->lock);
+    g_cond_init(&call->cond);
+    call->method = method;
+    call->parameters = g_variant_ref_sink(parameters);
+    call->reply_type = reply_type;
+    call->undo_method = undo_method;
+
+    gint64 end_time = -1;
+    if (session_timeout >= 0)
+        end_time = g_get_monotonic_time() + session_timeout * G_TIME_SPAN_MILLISECOND;
+
+    GTask *task = g_task_new(NULL, NULL, NULL, NULL);
+    g_task_set_task_data(task, call, NULL);
+    g_task_run_in_thread(task, session_blocking_call_thread);
+    g_object_unref(task);
+
+    g_mutex_lock(&call->lock);
+    while (!call->done)
+    {
+        if (end_time < 0)
+            g_cond_wait(&call->cond, &call->lock);
+        else if (!g_cond_wait_until(&call->cond, &call->lock, end_time))
+            break;
+    }
+    gboolean done = call->done;
+    call->abandoned = !done;
+    g_mutex_unlock(&call->lock);
+
+    /* The worker owns @call from here on */
+    if (!done)
+    {
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                            "Timed out waiting for the session manager");
+        return NULL;
+    }
+
+    GVariant *reply = call->reply;
+    call->reply = NULL;
+
+    if (reply == NULL)
+    {
+        g_propagate_error(error, call->error);
+        call->error = NULL;
+    }
+    else if (connection != NULL)
+    {
+        *connection = call->connection;
+        call->connection = NULL;
+    }
+
+    session_blocking_call_free(call);
+
+    return reply;
+}
+
+static GtkApplicationInhibitFlags
+convert_gtk_inhibit_flags(MateUiInhibitFlags flags)
+{
+    GtkApplicationInhibitFlags gtk_flags = 0;
+
+    if (flags & MATE_UI_INHIBIT_LOGOUT)
+        gtk_flags |= GTK_APPLICATION_INHIBIT_LOGOUT;
+    if (flags & MATE_UI_INHIBIT_USER_SWITCH)
+        gtk_flags |= GTK_APPLICATION_INHIBIT_SWITCH;
+    if (flags & MATE_UI_INHIBIT_SUSPEND)
+        gtk_flags |= GTK_APPLICATION_INHIBIT_SUSPEND;
+    if (flags & MATE_UI_INHIBIT_IDLE)
+        gtk_flags |= GTK_APPLICATION_INHIBIT_IDLE;
+
+    return gtk_flags;
+}
+
+/*
+ * Inhibit registry
+ *
+ * Requests with the same flags share one real inhibition. Each distinct
+ * flag set has at most one registered entry; the handles given to callers
+ * only count references to it, and the real uninhibit goes out when the
+ * last handle is released.
+ */
+struct _InhibitEntry
+{
+    MateUiInhibitFlags  flags;
+    guint               refcount;
+    gboolean            resolved;
+    gboolean            registered;
+    GList              *waiters;
+
+    /* Request parameters, dropped once the entry is resolved */
+    GtkWindow          *window;
+    gchar              *reason;
+
+    GtkApplication     *app;
+    guint               cookie;
+    gboolean            is_dbus;
+    guint32             dbus_cookie;
+};
+
+typedef struct
+{
+    GTask        *task;
+    InhibitEntry *entry;
+    GSource      *cancel_source;
+} InhibitWaiter;
+
+static GHashTable *inhibit_registry = NULL;
+static guint inhibit_cookie_count = 0;
+
+/* Registers the new entry unless another one already has its flags */
+static InhibitEntry *
+inhibit_entry_new(GtkApplication     *app,
+                  GtkWindow          *window,
+                  MateUiInhibitFlags  flags,
+                  const gchar        *reason)
+{
+    InhibitEntry *entry = g_new0(InhibitEntry, 1);
+    entry->flags = flags;
+    entry->app = app ? g_object_ref(app) : NULL;
+    entry->window = window ? g_object_ref(window) : NULL;
+    entry->reason = g_strdup(reason);
+
+    if (inhibit_registry == NULL)
+        inhibit_registry = g_hash_table_new(NULL, NULL);
+
+    if (!g_hash_table_contains(inhibit_registry, GUINT_TO_POINTER(flags)))
+    {
+        g_hash_table_insert(inhibit_registry, GUINT_TO_POINTER(flags), entry);
+        entry->registered = TRUE;
+    }
+
+    return entry;
+}
+
+static void
+inhibit_entry_unregister(InhibitEntry *entry)
+{
+    if (entry->registered)
+    {
+        g_hash_table_remove(inhibit_registry, GUINT_TO_POINTER(entry->flags));
+        entry->registered = FALSE;
+    }
+}
+
+static void
+inhibit_entry_free(InhibitEntry *entry)
+{
+    inhibit_entry_unregister(entry);
+    g_clear_object(&entry->app);
+    g_clear_object(&entry->window);
+    g_free(entry->reason);
+    g_free(entry);
+}
+
+static void
+inhibit_release_cb(GObject      *source G_GNUC_UNUSED,
+                   GAsyncResult *result,
+                   gpointer      user_data)
+{
+    GTask *task = user_data;
+    GError *error = NULL;
+
+    if (g_task_propagate_boolean(G_TASK(result), &error))
+    {
+        if (task != NULL)
+            g_task_return_boolean(task, TRUE);
+    }
+    else if (task != NULL)
+    {
+        g_task_return_error(task, error);
+    }
+    else
+    {
+        g_warning("Failed to uninhibit: %s", error->message);
+        g_error_free(error);
+    }
+
+    g_clear_object(&task);
+}
+
+/*
+ * Drops the real inhibition held by @entry and frees it. @task, if not
+ * %NULL, is completed once the session manager has answered; takes
+ * ownership. The Uninhibit call itself does not depend on @task, so
+ * cancelling it only affects what the caller is told.
+ */
+static void
+inhibit_entry_release(InhibitEntry *entry,
+                      GTask        *task)
+{
+    gboolean is_dbus = entry->is_dbus;
+    guint32 dbus_cookie = entry->dbus_cookie;
+
+    if (!is_dbus && entry->app != NULL)
+        gtk_application_uninhibit(entry->app, entry->cookie);
+
+    inhibit_cookie_count--;
+    inhibit_entry_free(entry);
+
+    if (is_dbus)
+    {
+        session_call_detached("Uninhibit",
+                              g_variant_new("(u)", dbus_cookie),
+                              session_reply_ignore,
+                              inhibit_release_cb,
+                              task);
+        return;
+    }
+
+    if (task != NULL)
+    {
+        g_task_return_boolean(task, TRUE);
+        g_object_unref(task);
+    }
+}
+
+/* Releases a handle whose result was never collected by the caller */
+static void
+inhibitor_drop(gpointer data)
+{
+    mate_ui_session_uninhibit(data);
+}
+
+static MateUiSessionInhibitor *
+inhibitor_new(InhibitEntry *entry)
+{
+    MateUiSessionInhibitor *inhibitor = g_new0(MateUiSessionInhibitor, 1);
+    inhibitor->entry = entry;
+
+    return inhibitor;
+}
+
+static void
+inhibit_waiter_free(InhibitWaiter *waiter)
+{
+    if (waiter->cancel_source != NULL)
+    {
+        g_source_destroy(waiter->cancel_source);
+        g_source_unref(waiter->cancel_source);
+    }
+
+    g_object_unref(waiter->task);
+    g_free(waiter);
+}
+
+static gboolean
+inhibit_waiter_cancelled_cb(GCancellable *cancellable G_GNUC_UNUSED,
+                            gpointer      user_data)
+{
+    InhibitWaiter *waiter = user_data;
+    InhibitEntry *entry = waiter->entry;
+
+    entry->waiters = g_list_remove(entry->waiters, waiter);
+    entry->refcount--;
+
+    /*
+     * Nobody is waiting any more; a later request starts afresh. The bus
+     * call is left to complete, as the session manager may grant the
+     * inhibition anyway, and inhibit_call_cb() then releases it.
+     */
+    if (entry->refcount == 0)
+        inhibit_entry_unregister(entry);
+
+    g_task_return_error_if_cancelled(waiter->task);
+    inhibit_waiter_free(waiter);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+inhibit_reply(GTask    *task,
+              GVariant *reply)
+{
+    guint32 cookie;
+
+    g_variant_get(reply, "(u)", &cookie);
+    g_task_return_int(task, cookie);
+}
+
+/*
+ * Completes the waiters of @entry with the outcome of its Inhibit call.
+ * If *@error is set, the call failed; it is cleared if the GTK fallback
+ * succeeds. Returns %FALSE, and frees @entry, if no inhibition was taken.
+ */
+static gboolean
+inhibit_entry_resolve(InhibitEntry  *entry,
+                      guint32        dbus_cookie,
+                      GError       **error)
+{
+    if (*error == NULL)
+    {
+        entry->is_dbus = TRUE;
+        entry->dbus_cookie = dbus_cookie;
+    }
+    else if (entry->app != NULL && entry->refcount > 0)
+    {
+        /* Fall back to GTK, which knows about portals and other backends */
+        entry->cookie = gtk_application_inhibit(entry->app, entry->window,
+                                                convert_gtk_inhibit_flags(entry->flags),
+                                                entry->reason);
+        if (entry->cookie != 0)
+            g_clear_error(error);
+    }
+
+    g_clear_object(&entry->window);
+    g_clear_pointer(&entry->reason, g_free);
+
+    GList *waiters = g_list_reverse(entry->waiters);
+    entry->waiters = NULL;
+
+    if (*error != NULL)
+    {
+        inhibit_entry_unregister(entry);
+
+        for (GList *l = waiters; l != NULL; l = l->next)
+        {
+            InhibitWaiter *waiter = l->data;
+
+            g_task_return_error(waiter->task, g_error_copy(*error));
+            inhibit_waiter_free(waiter);
+        }
+
+        g_list_free(waiters);
+        inhibit_entry_free(entry);
+        return FALSE;
+    }
+
+    entry->resolved = TRUE;
+    inhibit_cookie_count++;
+
+    /* Callbacks may release their handle straight away */
+    entry->refcount++;
+
+    for (GList *l = waiters; l != NULL; l = l->next)
+    {
+        InhibitWaiter *waiter = l->data;
+
+        g_task_return_pointer(waiter->task, inhibitor_new(entry), inhibitor_drop);
+        inhibit_waiter_free(waiter);
+    }
+
+    g_list_free(waiters);
+
+    if (--entry->refcount == 0)
+    {
+        inhibit_entry_release(entry, NULL);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+inhibit_call_cb(GObject      *source G_GNUC_UNUSED,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+    InhibitEntry *entry = user_data;
+    GError *error = NULL;
+
+    guint32 dbus_cookie = g_task_propagate_int(G_TASK(result), &error);
+    inhibit_entry_resolve(entry, dbus_cookie, &error);
+    g_clear_error(&error);
+}
+
+static GVariant *
+inhibit_parameters(InhibitEntry *entry)
+{
+    const gchar *app_id = entry->app ? g_application_get_application_id(G_APPLICATION(entry->app)) : NULL;
+    if (app_id == NULL)
+        app_id = "mate-application";
+
+    guint32 toplevel_xid = 0;
+
+#if HAVE_X11
+    if (entry->window != NULL && gtk_widget_get_realized(GTK_WIDGET(entry->window)))
+    {
+        GdkWindow *gdk_window = gtk_widget_get_window(GTK_WIDGET(entry->window));
+        if (GDK_IS_X11_WINDOW(gdk_window))
+        {
+            toplevel_xid = GDK_WINDOW_XID(gdk_window);
+        }
+    }
+#endif
+
+    return g_variant_new("(susu)",
+                         app_id,
+                         toplevel_xid,
+                         entry->reason,
+                         convert_inhibit_flags(entry->flags));
+}
+
+static void
+inhibit_entry_start(InhibitEntry *entry)
+{
+    /* Not cancellable: a granted inhibition must be seen to be released */
+    session_call_detached("Inhibit",
+                          inhibit_parameters(entry),
+                          inhibit_reply,
+                          inhibit_call_cb,
+                          entry);
+}
+
+/**
+ * mate_ui_session_inhibit_async:
+ * @app: (nullable): A #GtkApplication or %NULL
+ * @window: (nullable): A #GtkWindow or %NULL
+ * @flags: What to inhibit
+ * @reason: Human-readable reason for the inhibition
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously inhibits session actions. The session manager is asked
+ * first; if it is unavailable, the request falls back to
+ * gtk_application_inhibit().
+ *
+ * Requests for the same @flags share a single inhibition, so only the
+ * first one reaches the session manager and its @window and @reason are
+ * the ones reported. Later requests just take another reference. The
+ * request is sent from the default main context, and completes while
+ * that context runs.
+ */
+void
+mate_ui_session_inhibit_async(GtkApplication      *app,
+                               GtkWindow           *window,
+                               MateUiInhibitFlags   flags,
+                               const gchar         *reason,
+                               GCancellable        *cancellable,
+                               GAsyncReadyCallback  callback,
+                               gpointer             user_data)
+{
+    g_return_if_fail(app == NULL || GTK_IS_APPLICATION(app));
+    g_return_if_fail(window == NULL || GTK_IS_WINDOW(window));
+    g_return_if_fail(reason != NULL);
+
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, mate_ui_session_inhibit_async);
+
+    InhibitEntry *entry = NULL;
+    if (inhibit_registry != NULL)
+        entry = g_hash_table_lookup(inhibit_registry, GUINT_TO_POINTER(flags));
+
+    if (entry != NULL && entry->resolved)
+    {
+        entry->refcount++;
+        g_task_return_pointer(task, inhibitor_new(entry), inhibitor_drop);
+        g_object_unref(task);
+        return;
+    }
+
+    gboolean start = FALSE;
+
+    if (entry == NULL)
+    {
+        entry = inhibit_entry_new(app, window, flags, reason);
+        start = TRUE;
+    }
+
+    InhibitWaiter *waiter = g_new0(InhibitWaiter, 1);
+    waiter->task = task;
+    waiter->entry = entry;
+
+    if (cancellable != NULL)
+    {
+        waiter->cancel_source = g_cancellable_source_new(cancellable);
+        g_source_set_callback(waiter->cancel_source,
+                              (GSourceFunc) inhibit_waiter_cancelled_cb,
+                              waiter, NULL);
+        g_source_attach(waiter->cancel_source, g_task_get_context(task));
+    }
+
+    entry->refcount++;
+    entry->waiters = g_list_prepend(entry->waiters, waiter);
+
+    if (start)
+        inhibit_entry_start(entry);
+}
+
+/**
+ * mate_ui_session_inhibit_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_inhibit_async().
+ *
+ * Returns: (transfer full) (nullable): An inhibitor handle or %NULL on failure
+ */
+MateUiSessionInhibitor *
+mate_ui_session_inhibit_finish(GAsyncResult  *result,
+                                GError       **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), NULL);
+
+    return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+/**
+ * mate_ui_session_inhibit:
+ * @app: (nullable): A #GtkApplication or %NULL
+ * @window: (nullable): A #GtkWindow or %NULL
+ * @flags: What to inhibit
+ * @reason: Human-readable reason for the inhibition
+ *
+ * Inhibits session actions. Blocks for at most the session timeout, and
+ * not at all when @flags are already inhibited by this process. An
+ * inhibition granted after the timeout is released again.
+ *
+ * Returns: (transfer full) (nullable): An inhibitor handle or %NULL on failure
+ */
+MateUiSessionInhibitor *
+mate_ui_session_inhibit(GtkApplication     *app,
+                         GtkWindow          *window,
+                         MateUiInhibitFlags  flags,
+                         const gchar        *reason)
+{
+    g_return_val_if_fail(app == NULL || GTK_IS_APPLICATION(app), NULL);
+    g_return_val_if_fail(window == NULL || GTK_IS_WINDOW(window), NULL);
+    g_return_val_if_fail(reason != NULL, NULL);
+
+    InhibitEntry *entry = NULL;
+    if (inhibit_registry != NULL)
+        entry = g_hash_table_lookup(inhibit_registry, GUINT_TO_POINTER(flags));
+
+    if (entry != NULL && entry->resolved)
+    {
+        entry->refcount++;
+        return inhibitor_new(entry);
+    }
+
+    /*
+     * A pending request completes on the default context, which does not
+     * run while we block, so make a request of our own.
+     */
+    entry = inhibit_entry_new(app, window, flags, reason);
+    entry->refcount = 1;
+
+    GError *error = NULL;
+    guint32 dbus_cookie = 0;
+
+    GVariant *reply = session_blocking_call("Inhibit",
+                                            inhibit_parameters(entry),
+                                            G_VARIANT_TYPE("(u)"),
+                                            "Uninhibit",
+                                            NULL,
+                                            &error);
+    if (reply != NULL)
+    {
+        g_variant_get(reply, "(u)", &dbus_cookie);
+        g_variant_unref(reply);
+    }
+    else if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT))
+    {
+        /* Falling back to GTK would block again; the worker cleans up */
+        entry->refcount = 0;
+        inhibit_entry_free(entry);
+        entry = NULL;
+    }
+
+    if (entry != NULL && inhibit_entry_resolve(entry, dbus_cookie, &error))
+        return inhibitor_new(entry);
+
+    g_warning("Failed to inhibit via session manager: %s", error->message);
+    g_error_free(error);
+
+    return NULL;
+}
+
+/**
+ * mate_ui_session_uninhibit_async:
+ * @inhibitor: An inhibitor returned by mate_ui_session_inhibit()
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously releases a session inhibitor. The inhibitor handle is
+ * consumed and must not be used again. The session manager is only
+ * contacted when this was the last handle for its flags.
+ *
+ * The release is sent from the default main context and always goes
+ * out; cancelling @cancellable only affects the result passed to
+ * @callback.
+ */
+void
+mate_ui_session_uninhibit_async(MateUiSessionInhibitor *inhibitor,
+                                 GCancellable           *cancellable,
+                                 GAsyncReadyCallback     callback,
+                                 gpointer                user_data)
+{
+    g_return_if_fail(inhibitor != NULL);
+
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, mate_ui_session_uninhibit_async);
+
+    InhibitEntry *entry = inhibitor->entry;
+    g_free(inhibitor);
+
+    if (--entry->refcount > 0)
+    {
+        g_task_return_boolean(task, TRUE);
+        g_object_unref(task);
+        return;
+    }
+
+    inhibit_entry_release(entry, task);
+}
+
+/**
+ * mate_ui_session_uninhibit_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_uninhibit_async().
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+mate_ui_session_uninhibit_finish(GAsyncResult  *result,
+                                  GError       **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/**
+ * mate_ui_session_uninhibit:
+ * @inhibitor: An inhibitor returned by mate_ui_session_inhibit()
+ *
+ * Releases a session inhibitor. Does not block: the release is sent from
+ * the default main context, and a failure is logged.
+ */
+void
+mate_ui_session_uninhibit(MateUiSessionInhibitor *inhibitor)
+{
+    if (inhibitor == NULL)
+        return;
+
+    InhibitEntry *entry = inhibitor->entry;
+    g_free(inhibitor);
+
+    if (--entry->refcount == 0)
+        inhibit_entry_release(entry, NULL);
+}
+
+/**
+ * mate_ui_session_get_inhibit_cookie_count:
+ *
+ * Gets the number of real inhibitions this process holds with the
+ * session manager or GTK, however many handles share them.
+ *
+ * Returns: The number of inhibit cookies currently held
+ */
+guint
+mate_ui_session_get_inhibit_cookie_count(void)
+{
+    return inhibit_cookie_count;
+}
+
+/**
+ * mate_ui_session_is_inhibited_async:
+ * @flags: Flags to check
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously checks if any session actions are currently inhibited.
+ * Once the session manager is being tracked, the answer comes from the
+ * cached state without a bus call.
+ */
+void
+mate_ui_session_is_inhibited_async(MateUiInhibitFlags   flags,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data)
+{
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, mate_ui_session_is_inhibited_async);
+
+    if (inhibit_state.valid)
+    {
+        g_task_return_boolean(task, (inhibit_state.flags & flags) != 0);
+        g_object_unref(task);
+        return;
+    }
+
+    session_call(task,
+                 "IsInhibited",
+                 g_variant_new("(u)", convert_inhibit_flags(flags)),
+                 session_reply_boolean);
+}
+
+/**
+ * mate_ui_session_is_inhibited_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_is_inhibited_async().
+ *
+ * Returns: %TRUE if inhibited, %FALSE if not or on error
+ */
+gboolean
+mate_ui_session_is_inhibited_finish(GAsyncResult  *result,
+                                     GError       **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/**
+ * mate_ui_session_is_inhibited:
+ * @flags: Flags to check
+ *
+ * Checks if any session actions are currently inhibited. The answer
+ * comes from the cached state once the session manager is being tracked;
+ * until then this blocks for at most the session timeout. Connect to
+ * #MateUiSessionMonitor::inhibited-changed instead of polling.
+ *
+ * Returns: %TRUE if inhibited
+ */
+gboolean
+mate_ui_session_is_inhibited(MateUiInhibitFlags flags)
+{
+    if (inhibit_state.valid)
+        return (inhibit_state.flags & flags) != 0;
+
+    SessionSync sync;
+    session_sync_begin(&sync);
+    mate_ui_session_is_inhibited_async(flags, sync.cancellable, session_sync_cb, &sync);
+    GAsyncResult *result = session_sync_end(&sync);
+
+    GError *error = NULL;
+    gboolean inhibited = mate_ui_session_is_inhibited_finish(result, &error);
+    g_object_unref(result);
+
+    if (error != NULL)
+    {
+        g_warning("Failed to check inhibit status: %s", error->message);
+        g_error_free(error);
+    }
+
+    return inhibited;
+}
+
+static void
+register_reply(GTask    *task,
+               GVariant *reply)
+{
+    gchar *client_path;
+
+    g_variant_get(reply, "(o)", &client_path);
+    g_task_return_pointer(task, client_path, g_free);
+}
+
+static void
+register_call_cb(GObject      *source G_GNUC_UNUSED,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+    GTask *task = user_data;
+    GError *error = NULL;
+
+    gchar *client_path = g_task_propagate_pointer(G_TASK(result), &error);
+    if (client_path == NULL)
+    {
+        g_task_return_error(task, error);
+        g_object_unref(task);
+        return;
+    }
+
+    /* Completes @task once the client signals are handled */
+    session_client_attach(g_task_get_task_data(task), client_path, task);
+    g_free(client_path);
+}
+
+static GVariant *
+register_parameters(GtkApplication *app,
+                    const gchar    *client_id)
+{
+    const gchar *app_id = g_application_get_application_id(G_APPLICATION(app));
+    if (app_id == NULL)
+        app_id = "mate-application";
+
+    return g_variant_new("(ss)", app_id, client_id ? client_id : "");
+}
+
+/**
+ * mate_ui_session_register_async:
+ * @app: A #GtkApplication
+ * @client_id: (nullable): Session client ID or %NULL
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously registers the application with the session manager.
+ * Once registered, the save callback set with
+ * mate_ui_session_set_save_callback() runs when the session ends, and
+ * the application quits when the session manager asks it to stop.
+ *
+ * The registration is made from the default main context. Once the
+ * request has been sent it is always completed, since the session
+ * manager then waits for answers from the client; cancelling
+ * @cancellable only affects the result passed to @callback.
+ */
+void
+mate_ui_session_register_async(GtkApplication      *app,
+                                const gchar         *client_id,
+                                GCancellable        *cancellable,
+                                GAsyncReadyCallback  callback,
+                                gpointer             user_data)
+{
+    g_return_if_fail(GTK_IS_APPLICATION(app));
+
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, mate_ui_session_register_async);
+    g_task_set_task_data(task, g_object_ref(app), g_object_unref);
+
+    session_call_detached("RegisterClient",
+                          register_parameters(app, client_id),
+                          register_reply,
+                          register_call_cb,
+                          task);
+}
+
+/**
+ * mate_ui_session_register_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_register_async().
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+mate_ui_session_register_finish(GAsyncResult  *result,
+                                 GError       **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/**
+ * mate_ui_session_register:
+ * @app: A #GtkApplication
+ * @client_id: (nullable): Session client ID or %NULL
+ *
+ * Registers the application with the session manager. Blocks for at
+ * most the session timeout. A registration that completes after that is
+ * withdrawn again.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+mate_ui_session_register(GtkApplication *app,
+                          const gchar    *client_id)
+{
+    g_return_val_if_fail(GTK_IS_APPLICATION(app), FALSE);
+
+    GDBusConnection *connection = NULL;
+    GError *error = NULL;
+
+    GVariant *reply = session_blocking_call("RegisterClient",
+                                            register_parameters(app, client_id),
+                                            G_VARIANT_TYPE("(o)"),
+                                            "UnregisterClient",
+                                            &connection,
+                                            &error);
+    if (reply == NULL)
+    {
+        g_warning("Failed to register with session manager: %s", error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    const gchar *client_path;
+    g_variant_get(reply, "(&o)", &client_path);
+    session_client_attach_connection(app, client_path, connection);
+
+    g_variant_unref(reply);
+    g_object_unref(connection);
+
+    return TRUE;
+}
+
+/**
+ * mate_ui_session_set_restart_command:
+ * @app: A #GtkApplication
+ * @argc: Number of arguments
+ * @argv: Argument vector
+ *
+ * Sets the command to restart this application.
+ */
+void
+mate_ui_session_set_restart_command(GtkApplication  *app,
+                                     gint             argc G_GNUC_UNUSED,
+                                     const gchar    **argv)
+{
+    g_return_if_fail(GTK_IS_APPLICATION(app));
+    g_return_if_fail(argv != NULL);
+
+    /* Store as application data for session save */
+    gchar **argv_copy = g_strdupv((gchar **)argv);
+    g_object_set_data_full(G_OBJECT(app), "mate-ui-restart-command",
+                            argv_copy, (GDestroyNotify)g_strfreev);
+}
+
+/**
+ * mate_ui_session_request_save_async:
+ * @app: A #GtkApplication
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously requests the session to save state.
+ */
+void
+mate_ui_session_request_save_async(GtkApplication      *app,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data)
+{
+    g_return_if_fail(GTK_IS_APPLICATION(app));
+
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, mate_ui_session_request_save_async);
+
+    session_call(task, "RequestSave", NULL, session_reply_ignore);
+}
+
+/**
+ * mate_ui_session_request_save_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_request_save_async().
+ *
+ * Returns: %TRUE if request was accepted
+ */
+gboolean
+mate_ui_session_request_save_finish(GAsyncResult  *result,
+                                     GError       **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/**
+ * mate_ui_session_request_save:
+ * @app: A #GtkApplication
+ *
+ * Requests the session to save state. Blocks for at most the session
+ * timeout.
+ *
+ * Returns: %TRUE if request was accepted
+ */
+gboolean
+mate_ui_session_request_save(GtkApplication *app)
+{
+    g_return_val_if_fail(GTK_IS_APPLICATION(app), FALSE);
+
+    SessionSync sync;
+    session_sync_begin(&sync);
+    mate_ui_session_request_save_async(app, sync.cancellable, session_sync_cb, &sync);
+    GAsyncResult *result = session_sync_end(&sync);
+
+    GError *error = NULL;
+    gboolean accepted = mate_ui_session_request_save_finish(result, &error);
+    g_object_unref(result);
+
+    if (error != NULL)
+    {
+        g_warning("Failed to request session save: %s", error->message);
+        g_error_free(error);
+    }
+
+    return accepted;
+}
+
+/**
+ * mate_ui_session_request_logout_async:
+ * @prompt: Whether to prompt the user
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously requests the session to log out.
+ */
+void
+mate_ui_session_request_logout_async(gboolean             prompt,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data)
+{
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, mate_ui_session_request_logout_async);
+
+    session_call(task,
+                 "Logout",
+                 g_variant_new("(u)", prompt ? 0 : 1),
+                 session_reply_ignore);
+}
+
+/**
+ * mate_ui_session_request_logout_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_request_logout_async().
+ *
+ * Returns: %TRUE if the request was delivered
+ */
+gboolean
+mate_ui_session_request_logout_finish(GAsyncResult  *result,
+                                       GError       **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/**
+ * mate_ui_session_request_logout:
+ * @prompt: Whether to prompt the user
+ *
+ * Requests the session to log out. Blocks for at most the session timeout.
+ */
+void
+mate_ui_session_request_logout(gboolean prompt)
+{
+    SessionSync sync;
+    session_sync_begin(&sync);
+    mate_ui_session_request_logout_async(prompt, sync.cancellable, session_sync_cb, &sync);
+    GAsyncResult *result = session_sync_end(&sync);
+
+    GError *error = NULL;
+    if (!mate_ui_session_request_logout_finish(result, &error))
+    {
+        g_warning("Failed to request logout: %s", error->message);
+        g_error_free(error);
+    }
+    g_object_unref(result);
+}
+
+/**
+ * mate_ui_session_request_shutdown_async:
+ * @prompt: Whether to prompt the user
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously requests the system to shut down.
+ */
+void
+mate_ui_session_request_shutdown_async(gboolean             prompt G_GNUC_UNUSED,
+                                        GCancellable        *cancellable,
+                                        GAsyncReadyCallback  callback,
+                                        gpointer             user_data)
+{
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, mate_ui_session_request_shutdown_async);
+
+    session_call(task, "Shutdown", NULL, session_reply_ignore);
+}
+
+/**
+ * mate_ui_session_request_shutdown_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_request_shutdown_async().
+ *
+ * Returns: %TRUE if the request was delivered
+ */
+gboolean
+mate_ui_session_request_shutdown_finish(GAsyncResult  *result,
+                                         GError       **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/**
+ * mate_ui_session_request_shutdown:
+ * @prompt: Whether to prompt the user
+ *
+ * Requests the system to shut down. Blocks for at most the session timeout.
+ */
+void
+mate_ui_session_request_shutdown(gboolean prompt)
+{
+    SessionSync sync;
+    session_sync_begin(&sync);
+    mate_ui_session_request_shutdown_async(prompt, sync.cancellable, session_sync_cb, &sync);
+    GAsyncResult *result = session_sync_end(&sync);
+
+    GError *error = NULL;
+    if (!mate_ui_session_request_shutdown_finish(result, &error))
+    {
+        g_warning("Failed to request shutdown: %s", error->message);
+        g_error_free(error);
+    }
+    g_object_unref(result);
+}
+
+/**
+ * mate_ui_session_request_reboot_async:
+ * @prompt: Whether to prompt the user
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously requests the system to reboot.
+ */
+void
+mate_ui_session_request_reboot_async(gboolean             prompt G_GNUC_UNUSED,
+                                      GCancellable        *cancellable,
+                                      GAsyncReadyCallback  callback,
+                                      gpointer             user_data)
+{
+    GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+    g_task_set_source_tag(task, mate_ui_session_request_reboot_async);
+
+    session_call(task, "Reboot", NULL, session_reply_ignore);
+}
+
+/**
+ * mate_ui_session_request_reboot_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_request_reboot_async().
+ *
+ * Returns: %TRUE if the request was delivered
+ */
+gboolean
+mate_ui_session_request_reboot_finish(GAsyncResult  *result,
+                                       GError       **error)
+{
+    g_return_val_if_fail(g_task_is_valid(result, NULL), FALSE);
+
+    return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/**
+ * mate_ui_session_request_reboot:
+ * @prompt: Whether to prompt the user
+ *
+ * Requests the system to reboot. Blocks for at most the session timeout.
+ */
+void
+mate_ui_session_request_reboot(gboolean prompt)
+{
+    SessionSync sync;
+    session_sync_begin(&sync);
+    mate_ui_session_request_reboot_async(prompt, sync.cancellable, session_sync_cb, &sync);
+    GAsyncResult *result = session_sync_end(&sync);
+
+    GError *error = NULL;
+    if (!mate_ui_session_request_reboot_finish(result, &error))
+    {
+        g_warning("Failed to request reboot: %s", error->message);
+        g_error_free(error);
+    }
+    g_object_unref(result);
+}
+
+/* Save callback data */
+typedef struct
+{
+    MateUiSessionSaveCallback callback;
+    gpointer                  user_data;
+    GDestroyNotify            destroy;
+} SaveCallbackData;
+
+static void
+save_callback_data_free(gpointer data)
+{
+    SaveCallbackData *d = data;
+    if (d->destroy != NULL)
+        d->destroy(d->user_data);
+    g_free(d);
+}
+
+/**
+ * mate_ui_session_set_save_callback:
+ * @app: A #GtkApplication
+ * @callback: Callback for save requests
+ * @user_data: User data for callback
+ * @destroy: (nullable): Destroy notify for user data
+ *
+ * Sets a callback to be called when the session manager requests
+ * the application to save its state. The callback runs from an idle
+ * source once the session ends, and is given the save timeout to finish;
+ * see mate_ui_session_hold_save() for saving asynchronously.
+ */
+void
+mate_ui_session_set_save_callback(GtkApplication            *app,
+                                   MateUiSessionSaveCallback  callback,
+                                   gpointer                   user_data,
+                                   GDestroyNotify             destroy)
+{
+    g_return_if_fail(GTK_IS_APPLICATION(app));
+
+    SaveCallbackData *data = g_new0(SaveCallbackData, 1);
+    data->callback = callback;
+    data->user_data = user_data;
+    data->destroy = destroy;
+
+    g_object_set_data_full(G_OBJECT(app), "mate-ui-save-callback",
+                            data, save_callback_data_free);
+}
+
+/*
+ * Registered client. The session manager talks to the client through
+ * signals on the object path returned by RegisterClient, and waits for an
+ * EndSessionResponse before moving on, so the save callback runs under
+ * a deadline that keeps us well inside the session manager's own.
+ */
+#define SM_CLIENT_PRIVATE_INTERFACE "org.gnome.SessionManager.ClientPrivate"
+
+typedef struct
+{
+    GtkApplication  *app;
+    GDBusConnection *connection;
+    gchar           *path;
+    guint            subscription_id;
+    gboolean         ending;
+    gboolean         saved;
+    guint            holds;
+    guint            save_id;
+    guint            deadline_id;
+    GCancellable    *cancellable;
+} SessionClient;
+
+static SessionClient session_client = { NULL, NULL, NULL, 0, FALSE, TRUE, 0, 0, 0, NULL };
+static guint session_save_timeout = MATE_UI_SESSION_DEFAULT_SAVE_TIMEOUT;
+
+static void
+session_client_respond(gboolean     is_ok,
+                       const gchar *reason)
+{
+    g_dbus_connection_call(session_client.connection,
+                           SM_DBUS_NAME,
+                           session_client.path,
+                           SM_CLIENT_PRIVATE_INTERFACE,
+                           "EndSessionResponse",
+                           g_variant_new("(bs)", is_ok, reason),
+                           NULL,
+                           G_DBUS_CALL_FLAGS_NONE,
+                           session_timeout,
+                           NULL,
+                           NULL,
+                           NULL);
+}
+
+static void
+session_client_stop_save(void)
+{
+    session_client.ending = FALSE;
+    session_client.holds = 0;
+
+    if (session_client.save_id != 0)
+    {
+        g_source_remove(session_client.save_id);
+        session_client.save_id = 0;
+    }
+
+    if (session_client.deadline_id != 0)
+    {
+        g_source_remove(session_client.deadline_id);
+        session_client.deadline_id = 0;
+    }
+}
+
+/* Answers EndSession; @reason is %NULL if the state was saved */
+static void
+session_client_finish_save(const gchar *reason)
+{
+    if (!session_client.ending)
+        return;
+
+    session_client_stop_save();
+    session_client_respond(reason == NULL, reason ? reason : "");
+}
+
+static gboolean
+session_client_deadline_cb(gpointer user_data G_GNUC_UNUSED)
+{
+    session_client.deadline_id = 0;
+    session_client_finish_save("Saving state timed out");
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+session_client_save_cb(gpointer user_data G_GNUC_UNUSED)
+{
+    session_client.save_id = 0;
+
+    SaveCallbackData *data = NULL;
+    if (session_client.app != NULL)
+        data = g_object_get_data(G_OBJECT(session_client.app), "mate-ui-save-callback");
+
+    gboolean success = TRUE;
+    if (data != NULL && data->callback != NULL)
+        success = data->callback(data->user_data);
+
+    /* Drop the hold taken when EndSession arrived */
+    mate_ui_session_release_save(success);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+session_client_signal_cb(GDBusConnection *connection G_GNUC_UNUSED,
+                         const gchar     *sender_name G_GNUC_UNUSED,
+                         const gchar     *object_path G_GNUC_UNUSED,
+                         const gchar     *interface_name G_GNUC_UNUSED,
+                         const gchar     *signal_name,
+                         GVariant        *parameters G_GNUC_UNUSED,
+                         gpointer         user_data G_GNUC_UNUSED)
+{
+    if (g_strcmp0(signal_name, "QueryEndSession") == 0)
+    {
+        /* Applications that need to block logout hold an inhibitor */
+        session_client_respond(TRUE, "");
+    }
+    else if (g_strcmp0(signal_name, "EndSession") == 0)
+    {
+        if (session_client.ending)
+            return;
+
+        session_client.ending = TRUE;
+        session_client.saved = TRUE;
+        session_client.holds = 1;
+        session_client.deadline_id = g_timeout_add(session_save_timeout,
+                                                   session_client_deadline_cb,
+                                                   NULL);
+        session_client.save_id = g_idle_add(session_client_save_cb, NULL);
+    }
+    else if (g_strcmp0(signal_name, "CancelEndSession") == 0)
+    {
+        session_client_stop_save();
+    }
+    else if (g_strcmp0(signal_name, "Stop") == 0)
+    {
+        session_client_stop_save();
+
+        if (session_client.app != NULL)
+            g_application_quit(G_APPLICATION(session_client.app));
+    }
+}
+
+static void
+session_client_detach(void)
+{
+    session_client_stop_save();
+
+    g_cancellable_cancel(session_client.cancellable);
+    g_clear_object(&session_client.cancellable);
+
+    if (session_client.subscription_id != 0)
+    {
+        g_dbus_connection_signal_unsubscribe(session_client.connection,
+                                             session_client.subscription_id);
+        session_client.subscription_id = 0;
+    }
+
+    if (session_client.app != NULL)
+    {
+        g_object_remove_weak_pointer(G_OBJECT(session_client.app),
+                                     (gpointer *) &session_client.app);
+        session_client.app = NULL;
+    }
+
+    g_clear_object(&session_client.connection);
+    g_clear_pointer(&session_client.path, g_free);
+}
+
+/* Takes ownership of @connection */
+static void
+session_client_subscribe(GDBusConnection *connection)
+{
+    session_client.connection = connection;
+
+    /* Handle the signals on the main loop, even if registered synchronously */
+    g_main_context_push_thread_default(g_main_context_default());
+    session_client.subscription_id =
+        g_dbus_connection_signal_subscribe(connection,
+                                           SM_DBUS_NAME,
+                                           SM_CLIENT_PRIVATE_INTERFACE,
+                                           NULL,
+                                           session_client.path,
+                                           NULL,
+                                           G_DBUS_SIGNAL_FLAGS_NONE,
+                                           session_client_signal_cb,
+                                           NULL,
+                                           NULL);
+    g_main_context_pop_thread_default(g_main_context_default());
+}
+
+static void
+session_client_bus_cb(GObject      *source G_GNUC_UNUSED,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+    GTask *task = user_data;
+    GError *error = NULL;
+
+    GDBusConnection *connection = g_bus_get_finish(result, &error);
+    if (connection == NULL)
+    {
+        /* Cancelled when superseded by a later attach or detach */
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            session_client_detach();
+
+        g_task_return_error(task, error);
+        g_object_unref(task);
+        return;
+    }
+
+    g_clear_object(&session_client.cancellable);
+    session_client_subscribe(connection);
+
+    g_task_return_boolean(task, TRUE);
+    g_object_unref(task);
+}
+
+static void
+session_client_bind(GtkApplication *app,
+                    const gchar    *path)
+{
+    session_client_detach();
+
+    session_client.path = g_strdup(path);
+    session_client.app = app;
+    g_object_add_weak_pointer(G_OBJECT(app), (gpointer *) &session_client.app);
+}
+
+/*
+ * Starts handling the client signals sent to @path for @app, then
+ * completes @task. The bus is already connected, since RegisterClient
+ * went over it, so this only waits for the shared connection to be
+ * handed out. The attach does not depend on @task's cancellable.
+ */
+static void
+session_client_attach(GtkApplication *app,
+                      const gchar    *path,
+                      GTask          *task)
+{
+    session_client_bind(app, path);
+    session_client.cancellable = g_cancellable_new();
+
+    g_bus_get(G_BUS_TYPE_SESSION, session_client.cancellable, session_client_bus_cb, task);
+}
+
+/* Like session_client_attach(), for a caller that has the connection */
+static void
+session_client_attach_connection(GtkApplication  *app,
+                                 const gchar     *path,
+                                 GDBusConnection *connection)
+{
+    session_client_bind(app, path);
+    session_client_subscribe(g_object_ref(connection));
+}
+
+/**
+ * mate_ui_session_set_save_timeout:
+ * @timeout_ms: Timeout in milliseconds
+ *
+ * Sets how long the save callback may take when the session ends. Once
+ * it has elapsed the session manager is answered regardless.
+ */
+void
+mate_ui_session_set_save_timeout(guint timeout_ms)
+{
+    session_save_timeout = timeout_ms;
+}
+
+/**
+ * mate_ui_session_get_save_timeout:
+ *
+ * Gets how long the save callback may take when the session ends.
+ *
+ * Returns: Timeout in milliseconds
+ */
+guint
+mate_ui_session_get_save_timeout(void)
+{
+    return session_save_timeout;
+}
+
+/**
+ * mate_ui_session_hold_save:
+ *
+ * Delays the answer to the session manager until a matching
+ * mate_ui_session_release_save(), so the save callback can finish its
+ * work asynchronously. Only valid while a save is in progress.
+ */
+void
+mate_ui_session_hold_save(void)
+{
+    g_return_if_fail(session_client.holds > 0);
+
+    session_client.holds++;
+}
+
+/**
+ * mate_ui_session_release_save:
+ * @success: Whether the held work saved its state
+ *
+ * Releases a hold taken with mate_ui_session_hold_save(). The session
+ * manager is answered once every hold is released. Releasing after the
+ * save timeout has elapsed does nothing.
+ */
+void
+mate_ui_session_release_save(gboolean success)
+{
+    if (session_client.holds == 0)
+        return;
+
+    if (!success)
+        session_client.saved = FALSE;
+
+    if (--session_client.holds == 0)
+        session_client_finish_save(session_client.saved ? NULL : "Failed to save state");
+}
+
+/*
+ * Idle time source
+ *
+ * The backend is probed once per display: the XSync IDLETIME counter is
+ * preferred, then XScreenSaver with a reused info struct. Elsewhere the
+ * time is taken from org.mate.ScreenSaver, which reports when the session
+ * became idle; the value is then extrapolated locally and kept current
+ * from the screensaver's signals, so queries never touch the bus.
+ */
+#define SS_DBUS_NAME      "org.mate.ScreenSaver"
+#define SS_DBUS_PATH      "/org/mate/ScreenSaver"
+#define SS_DBUS_INTERFACE "org.mate.ScreenSaver"
+
+typedef enum
+{
+    IDLE_BACKEND_NONE,
+    IDLE_BACKEND_XSYNC,
+    IDLE_BACKEND_XSS,
+    IDLE_BACKEND_SCREENSAVER,
+} IdleBackend;
+
+typedef struct
+{
+    GdkDisplay        *display;
+    IdleBackend        backend;
+#if HAVE_X11
+    Display           *xdisplay;
+#endif
+#if HAVE_XSYNC
+    XSyncCounter       counter;
+    int                sync_event_base;
+#endif
+#if HAVE_XSS
+    XScreenSaverInfo  *info;
+#endif
+
+    /* org.mate.ScreenSaver fallback */
+    guint              watch_id;
+    GDBusConnection   *connection;
+    guint              subscription_id;
+    GCancellable      *cancellable;
+    gboolean           known;
+    gboolean           session_idle;
+    gint64             idle_since;   /* monotonic time the session went idle */
+} IdleTime;
+
+static IdleTime idle_time;
+
+#if HAVE_XSYNC
+static XSyncCounter
+idle_time_find_counter(Display *xdisplay)
+{
+    XSyncCounter counter = None;
+    int n_counters = 0;
+    XSyncSystemCounter *counters = XSyncListSystemCounters(xdisplay, &n_counters);
+
+    for (int i = 0; i < n_counters; i++)
+    {
+        if (g_strcmp0(counters[i].name, "IDLETIME") == 0)
+        {
+            counter = counters[i].counter;
+            break;
+        }
+    }
+
+    if (counters != NULL)
+        XSyncFreeSystemCounterList(counters);
+
+    return counter;
+}
+#endif
+
+static void
+idle_time_screensaver_set(gboolean session_idle,
+                          guint64  idle_ms)
+{
+    idle_time.known = TRUE;
+    idle_time.session_idle = session_idle;
+    idle_time.idle_since = g_get_monotonic_time() - (gint64)idle_ms * 1000;
+}
+
+static void
+idle_time_screensaver_query_cb(GObject      *source,
+                               GAsyncResult *result,
+                               gpointer      user_data G_GNUC_UNUSED)
+{
+    GError *error = NULL;
+
+    GVariant *reply = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error);
+    if (reply == NULL)
+    {
+        if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_warning("Failed to query session idle time: %s", error->message);
+
+        g_error_free(error);
+        return;
+    }
+
+    guint32 idle_secs;
+    g_variant_get(reply, "(u)", &idle_secs);
+    g_variant_unref(reply);
+
+    idle_time_screensaver_set(idle_secs > 0, (guint64)idle_secs * 1000);
+}
+
+static void
+idle_time_screensaver_query(void)
+{
+    g_dbus_connection_call(idle_time.connection,
+                           SS_DBUS_NAME,
+                           SS_DBUS_PATH,
+                           SS_DBUS_INTERFACE,
+                           "GetSessionIdleTime",
+                           NULL,
+                           G_VARIANT_TYPE("(u)"),
+                           G_DBUS_CALL_FLAGS_NONE,
+                           session_timeout,
+                           idle_time.cancellable,
+                           idle_time_screensaver_query_cb,
+                           NULL);
+}
+
+static void
+idle_time_screensaver_signal_cb(GDBusConnection *connection G_GNUC_UNUSED,
+                                const gchar     *sender_name G_GNUC_UNUSED,
+                                const gchar     *object_path G_GNUC_UNUSED,
+                                const gchar     *interface_name G_GNUC_UNUSED,
+                                const gchar     *signal_name,
+                                GVariant        *parameters,
+                                gpointer         user_data G_GNUC_UNUSED)
+{
+    gboolean value;
+
+    if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(b)")))
+        return;
+
+    g_variant_get(parameters, "(b)", &value);
+
+    if (g_strcmp0(signal_name, "SessionIdleChanged") == 0)
+    {
+        idle_time_screensaver_set(value, 0);
+    }
+    else if (g_strcmp0(signal_name, "ActiveChanged") == 0 && !value)
+    {
+        /* The screensaver only deactivates on user activity */
+        idle_time_screensaver_set(FALSE, 0);
+    }
+}
+
+static void
+idle_time_screensaver_appeared_cb(GDBusConnection *connection,
+                                  const gchar     *name G_GNUC_UNUSED,
+                                  const gchar     *name_owner G_GNUC_UNUSED,
+                                  gpointer         user_data G_GNUC_UNUSED)
+{
+    idle_time.connection = g_object_ref(connection);
+    idle_time.cancellable = g_cancellable_new();
+    idle_time.subscription_id =
+        g_dbus_connection_signal_subscribe(connection,
+                                           SS_DBUS_NAME,
+                                           SS_DBUS_INTERFACE,
+                                           NULL,
+                                           SS_DBUS_PATH,
+                                           NULL,
+                                           G_DBUS_SIGNAL_FLAGS_NONE,
+                                           idle_time_screensaver_signal_cb,
+                                           NULL,
+                                           NULL);
+
+    idle_time_screensaver_query();
+}
+
+static void
+idle_time_screensaver_vanished_cb(GDBusConnection *connection G_GNUC_UNUSED,
+                                  const gchar     *name G_GNUC_UNUSED,
+                                  gpointer         user_data G_GNUC_UNUSED)
+{
+    g_cancellable_cancel(idle_time.cancellable);
+    g_clear_object(&idle_time.cancellable);
+
+    if (idle_time.subscription_id != 0)
+    {
+        g_dbus_connection_signal_unsubscribe(idle_time.connection,
+                                             idle_time.subscription_id);
+        idle_time.subscription_id = 0;
+    }
+
+    g_clear_object(&idle_time.connection);
+    idle_time.known = FALSE;
+}
+
+static void
+idle_time_reset(void)
+{
+#if HAVE_XSS
+    if (idle_time.info != NULL)
+    {
+        XFree(idle_time.info);
+        idle_time.info = NULL;
+    }
+#endif
+
+    if (idle_time.display != NULL)
+    {
+        g_object_remove_weak_pointer(G_OBJECT(idle_time.display),
+                                     (gpointer *) &idle_time.display);
+        idle_time.display = NULL;
+    }
+
+    idle_time.backend = IDLE_BACKEND_NONE;
+}
+
+/* Returns: the idle time state for the default display, probing it once */
+static IdleTime *
+idle_time_get(void)
+{
+    GdkDisplay *display = gdk_display_get_default();
+
+    /* A display that went away leaves the weak pointer cleared */
+    if (idle_time.backend != IDLE_BACKEND_NONE && display == idle_time.display &&
+        (display != NULL || idle_time.backend == IDLE_BACKEND_SCREENSAVER))
+        return &idle_time;
+
+    idle_time_reset();
+
+    if (display != NULL)
+    {
+        idle_time.display = display;
+        g_object_add_weak_pointer(G_OBJECT(display), (gpointer *) &idle_time.display);
+    }
+
+#if HAVE_X11
+    if (display != NULL && GDK_IS_X11_DISPLAY(display))
+    {
+        Display *xdisplay = GDK_DISPLAY_XDISPLAY(display);
+        idle_time.xdisplay = xdisplay;
+
+#if HAVE_XSYNC
+        int event_base, error_base, major, minor;
+
+        if (XSyncQueryExtension(xdisplay, &event_base, &error_base) &&
+            XSyncInitialize(xdisplay, &major, &minor))
+        {
+            idle_time.counter = idle_time_find_counter(xdisplay);
+            if (idle_time.counter != None)
+            {
+                idle_time.sync_event_base = event_base;
+                idle_time.backend = IDLE_BACKEND_XSYNC;
+                return &idle_time;
+            }
+        }
+#endif
+
+#if HAVE_XSS
+        int ss_event_base, ss_error_base;
+
+        if (XScreenSaverQueryExtension(xdisplay, &ss_event_base, &ss_error_base))
+        {
+            idle_time.info = XScreenSaverAllocInfo();
+            if (idle_time.info != NULL)
+            {
+                idle_time.backend = IDLE_BACKEND_XSS;
+                return &idle_time;
+            }
+        }
+#endif
+    }
+#endif
+
+    idle_time.backend = IDLE_BACKEND_SCREENSAVER;
+
+    if (idle_time.watch_id == 0)
+    {
+        /* Track the screensaver from the main loop, whoever asked first */
+        g_main_context_push_thread_default(g_main_context_default());
+        idle_time.watch_id = g_bus_watch_name(G_BUS_TYPE_SESSION,
+                                              SS_DBUS_NAME,
+                                              G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                              idle_time_screensaver_appeared_cb,
+                                              idle_time_screensaver_vanished_cb,
+                                              NULL,
+                                              NULL);
+        g_main_context_pop_thread_default(g_main_context_default());
+    }
+
+    return &idle_time;
+}
+
+/**
+ * mate_ui_session_get_idle_time:
+ *
+ * Gets the current idle time in milliseconds. The backend is chosen once
+ * per display and queries do not allocate. Use
+ * mate_ui_session_has_idle_time() to tell whether the value is real.
+ *
+ * Returns: Idle time in milliseconds, or 0 if it is not known
+ */
+guint64
+mate_ui_session_get_idle_time(void)
+{
+    IdleTime *state = idle_time_get();
+
+    switch (state->backend)
+    {
+#if HAVE_XSYNC
+        case IDLE_BACKEND_XSYNC:
+        {
+            XSyncValue value;
+
+            if (XSyncQueryCounter(state->xdisplay, state->counter, &value))
+                return ((guint64)(guint32)XSyncValueHigh32(value) << 32) |
+                       (guint32)XSyncValueLow32(value);
+            return 0;
+        }
+#endif
+
+#if HAVE_XSS
+        case IDLE_BACKEND_XSS:
+            if (XScreenSaverQueryInfo(state->xdisplay, DefaultRootWindow(state->xdisplay), state->info))
+                return state->info->idle;
+            return 0;
+#endif
+
+        case IDLE_BACKEND_SCREENSAVER:
+            if (state->known && state->session_idle)
+                return (g_get_monotonic_time() - state->idle_since) / 1000;
+            return 0;
+
+        case IDLE_BACKEND_NONE:
+        default:
+            return 0;
+    }
+}
+
+/**
+ * mate_ui_session_has_idle_time:
+ *
+ * Checks whether mate_ui_session_get_idle_time() reports a measured
+ * value. When it returns %FALSE, the idle time is always 0. Values taken
+ * from the screensaver only count time since the session was marked idle.
+ *
+ * Returns: %TRUE if the idle time is real
+ */
+gboolean
+mate_ui_session_has_idle_time(void)
+{
+    IdleTime *state = idle_time_get();
+
+    switch (state->backend)
+    {
+        case IDLE_BACKEND_XSYNC:
+        case IDLE_BACKEND_XSS:
+            return TRUE;
+
+        case IDLE_BACKEND_SCREENSAVER:
+            return state->known;
+
+        case IDLE_BACKEND_NONE:
+        default:
+            return FALSE;
+    }
+}
+
+/*
+ * Idle monitor
+ *
+ * All idle watches in the process share one monitor. On X11 servers with
+ * the SYNC extension it arms IDLETIME alarms and sleeps until the server
+ * reports a threshold crossing or renewed activity. Elsewhere it arms a
+ * single timeout for exactly the time left until the nearest threshold,
+ * and only polls for activity while some watch is in its idle state.
+ *
+ * Watches waiting for their threshold live in a min-heap ordered by
+ * threshold, so each wakeup costs one idle-time query no matter how many
+ * watches exist, and adding or removing a watch is O(log n).
+ */
+#define IDLE_ACTIVE_POLL_MS 1000
+
+typedef struct
+{
+    guint                  id;
+    guint64                threshold;
+    MateUiSessionIdleFunc  idle_func;
+    MateUiSessionIdleFunc  active_func;
+    gpointer               user_data;
+    GDestroyNotify         destroy;
+    gboolean               fired;
+    guint                  index;   /* position in pending heap or fired array */
+} IdleWatch;
+
+typedef struct
+{
+    GHashTable   *watches;      /* id -> IdleWatch */
+    GPtrArray    *pending;      /* min-heap of unfired watches by threshold */
+    GPtrArray    *fired;        /* watches whose idle callback has run */
+    guint         next_id;
+    guint64       last_idle;
+    gint64        last_sample;  /* monotonic time of last_idle */
+    guint         timeout_id;
+    gboolean      initialized;
+#if HAVE_XSYNC
+    Display      *xdisplay;
+    XSyncCounter  counter;
+    int           event_base;
+    XSyncAlarm    idle_alarm;
+    XSyncAlarm    reset_alarm;
+#endif
+} IdleMonitor;
+
+static IdleMonitor idle_monitor;
+
+static void idle_monitor_rearm(IdleMonitor *monitor, guint64 idle);
+
+/*
+ * Upper bound for the current idle time, assuming the user stayed idle
+ * since the last sample. Waking up early is harmless, late is not.
+ */
+static guint64
+idle_monitor_estimate(IdleMonitor *monitor)
+{
+    if (monitor->last_sample == 0)
+        return 0;
+
+    return monitor->last_idle + (g_get_monotonic_time() - monitor->last_sample) / 1000;
+}
+
+static void
+idle_watch_free(gpointer data)
+{
+    IdleWatch *watch = data;
+
+    if (watch->destroy != NULL)
+        watch->destroy(watch->user_data);
+    g_free(watch);
+}
+
+#define IDLE_HEAP_AT(heap, i) ((IdleWatch *)g_ptr_array_index((heap), (i)))
+
+static void
+idle_heap_set(GPtrArray *heap,
+              guint      i,
+              IdleWatch *watch)
+{
+    g_ptr_array_index(heap, i) = watch;
+    watch->index = i;
+}
+
+static void
+idle_heap_sift_up(GPtrArray *heap,
+                  guint      i)
+{
+    IdleWatch *watch = IDLE_HEAP_AT(heap, i);
+
+    while (i > 0)
+    {
+        guint parent = (i - 1) / 2;
+        if (IDLE_HEAP_AT(heap, parent)->threshold <= watch->threshold)
+            break;
+
+        idle_heap_set(heap, i, IDLE_HEAP_AT(heap, parent));
+        i = parent;
+    }
+
+    idle_heap_set(heap, i, watch);
+}
+
+static void
+idle_heap_sift_down(GPtrArray *heap,
+                    guint      i)
+{
+    IdleWatch *watch = IDLE_HEAP_AT(heap, i);
+
+    for (;;)
+    {
+        guint child = 2 * i + 1;
+        if (child >= heap->len)
+            break;
+
+        if (child + 1 < heap->len &&
+            IDLE_HEAP_AT(heap, child + 1)->threshold < IDLE_HEAP_AT(heap, child)->threshold)
+            child++;
+
+        if (watch->threshold <= IDLE_HEAP_AT(heap, child)->threshold)
+            break;
+
+        idle_heap_set(heap, i, IDLE_HEAP_AT(heap, child));
+        i = child;
+    }
+
+    idle_heap_set(heap, i, watch);
+}
+
+static void
+idle_heap_push(GPtrArray *heap,
+               IdleWatch *watch)
+{
+    g_ptr_array_add(heap, watch);
+    idle_heap_sift_up(heap, heap->len - 1);
+}
+
+static void
+idle_heap_remove(GPtrArray *heap,
+                 IdleWatch *watch)
+{
+    guint i = watch->index;
+    IdleWatch *last = g_ptr_array_remove_index(heap, heap->len - 1);
+
+    if (last == watch)
+        return;
+
+    idle_heap_set(heap, i, last);
+    if (i > 0 && IDLE_HEAP_AT(heap, (i - 1) / 2)->threshold > last->threshold)
+        idle_heap_sift_up(heap, i);
+    else
+        idle_heap_sift_down(heap, i);
+}
+
+/* O(1) removal from the unordered fired array */
+static void
+idle_fired_remove(GPtrArray *fired,
+                  IdleWatch *watch)
+{
+    guint i = watch->index;
+
+    g_ptr_array_remove_index_fast(fired, i);
+    if (i < fired->len)
+        IDLE_HEAP_AT(fired, i)->index = i;
+}
+
+/* Runs the idle callback of every watch whose threshold has been reached */
+static void
+idle_monitor_check(IdleMonitor *monitor,
+                   guint64      idle)
+{
+    GArray *due = g_array_new(FALSE, FALSE, sizeof(guint));
+
+    monitor->last_idle = idle;
+    monitor->last_sample = g_get_monotonic_time();
+
+    while (monitor->pending->len > 0 &&
+           IDLE_HEAP_AT(monitor->pending, 0)->threshold <= idle)
+    {
+        IdleWatch *watch = IDLE_HEAP_AT(monitor->pending, 0);
+
+        idle_heap_remove(monitor->pending, watch);
+        watch->fired = TRUE;
+        watch->index = monitor->fired->len;
+        g_ptr_array_add(monitor->fired, watch);
+
+        g_array_append_val(due, watch->id);
+    }
+
+    /* Callbacks may add or remove watches, so look each one up again */
+    for (guint i = 0; i < due->len; i++)
+    {
+        IdleWatch *watch = g_hash_table_lookup(monitor->watches,
+                                               GUINT_TO_POINTER(g_array_index(due, guint, i)));
+        if (watch != NULL && watch->idle_func != NULL)
+            watch->idle_func(watch->user_data);
+    }
+
+    g_array_unref(due);
 }
 
-/**
- * mate_ui_session_uninhibit:
- * @inhibitor: An inhibitor returned by mate_ui_session_inhibit()
- *
- * Releases a session inhibitor.
- */
-void
-mate_ui_session_uninhibit(MateUiSessionInhibitor *inhibitor)
+/* Returns every fired watch to the pending heap */
+static void
+idle_monitor_became_active(IdleMonitor *monitor)
 {
-    if (inhibitor == NULL)
-        return;
+    GArray *due = g_array_new(FALSE, FALSE, sizeof(guint));
 
-    if (!inhibitor->is_dbus && inhibitor->app != NULL)
+    while (monitor->fired->len > 0)
     {
-        gtk_application_uninhibit(inhibitor->app, inhibitor->cookie);
-        g_object_unref(inhibitor->app);
+        IdleWatch *watch = g_ptr_array_remove_index(monitor->fired, monitor->fired->len - 1);
+
+        watch->fired = FALSE;
+        idle_heap_push(monitor->pending, watch);
+
+        g_array_append_val(due, watch->id);
     }
-    else if (inhibitor->is_dbus)
+
+    for (guint i = 0; i < due->len; i++)
     {
-        GDBusProxy *proxy = get_session_manager_proxy();
-        if (proxy != NULL)
-        {
-            GError *error = NULL;
-            g_dbus_proxy_call_sync(proxy,
-                                    "Uninhibit",
-                                    g_variant_new("(u)", inhibitor->dbus_cookie),
-                                    G_DBUS_CALL_FLAGS_NONE,
-                                    -1,
-                                    NULL,
-                                    &error);
-
-            if (error != NULL)
-            {
-                g_warning("Failed to uninhibit: %s", error->message);
-                g_error_free(error);
-            }
-        }
+        IdleWatch *watch = g_hash_table_lookup(monitor->watches,
+                                               GUINT_TO_POINTER(g_array_index(due, guint, i)));
+        if (watch != NULL && watch->active_func != NULL)
+            watch->active_func(watch->user_data);
     }
 
-    g_free(inhibitor);
+    g_array_unref(due);
 }
 
-/**
- * mate_ui_session_is_inhibited:
- * @flags: Flags to check
- *
- * Checks if any session actions are currently inhibited.
- *
- * Returns: %TRUE if inhibited
- */
-gboolean
-mate_ui_session_is_inhibited(MateUiInhibitFlags flags)
+/* Smallest threshold of a pending watch, or G_MAXUINT64 */
+static guint64
+idle_monitor_next_threshold(IdleMonitor *monitor)
 {
-    GDBusProxy *proxy = get_session_manager_proxy();
-    if (proxy == NULL)
-        return FALSE;
+    if (monitor->pending->len == 0)
+        return G_MAXUINT64;
 
-    GError *error = NULL;
-    GVariant *result = g_dbus_proxy_call_sync(proxy,
-                                               "IsInhibited",
-                                               g_variant_new("(u)", convert_inhibit_flags(flags)),
-                                               G_DBUS_CALL_FLAGS_NONE,
-                                               -1,
-                                               NULL,
-                                               &error);
+    return IDLE_HEAP_AT(monitor->pending, 0)->threshold;
+}
 
-    if (result != NULL)
-    {
-        gboolean inhibited;
-        g_variant_get(result, "(b)", &inhibited);
-        g_variant_unref(result);
-        return inhibited;
-    }
+#if HAVE_XSYNC
+static XSyncAlarm
+idle_monitor_set_alarm(IdleMonitor  *monitor,
+                       XSyncAlarm    alarm,
+                       XSyncTestType test_type,
+                       guint64       value)
+{
+    XSyncAlarmAttributes attr;
+    unsigned long mask = XSyncCACounter | XSyncCAValueType | XSyncCATestType |
+                         XSyncCAValue | XSyncCADelta | XSyncCAEvents;
+
+    attr.trigger.counter = monitor->counter;
+    attr.trigger.value_type = XSyncAbsolute;
+    attr.trigger.test_type = test_type;
+    XSyncIntsToValue(&attr.trigger.wait_value,
+                     (unsigned int)(value & G_MAXUINT32),
+                     (int)(value >> 32));
+    XSyncIntToValue(&attr.delta, 0);
+    attr.events = True;
+
+    if (alarm == None)
+        return XSyncCreateAlarm(monitor->xdisplay, mask, &attr);
+
+    XSyncChangeAlarm(monitor->xdisplay, alarm, mask, &attr);
+    return alarm;
+}
 
-    if (error != NULL)
+static void
+idle_monitor_clear_alarm(IdleMonitor *monitor,
+                         XSyncAlarm  *alarm)
+{
+    if (*alarm != None)
     {
-        g_warning("Failed to check inhibit status: %s", error->message);
-        g_error_free(error);
+        XSyncDestroyAlarm(monitor->xdisplay, *alarm);
+        *alarm = None;
     }
-
-    return FALSE;
 }
 
-/**
- * mate_ui_session_register:
- * @app: A #GtkApplication
- * @client_id: (nullable): Session client ID or %NULL
- *
- * Registers the application with the session manager.
- *
- * Returns: %TRUE on success
- */
-gboolean
-mate_ui_session_register(GtkApplication *app,
-                          const gchar    *client_id)
+static GdkFilterReturn
+idle_monitor_xevent_filter(GdkXEvent *xevent,
+                           GdkEvent  *event G_GNUC_UNUSED,
+                           gpointer   user_data)
 {
-    g_return_val_if_fail(GTK_IS_APPLICATION(app), FALSE);
-
-    GDBusProxy *proxy = get_session_manager_proxy();
-    if (proxy == NULL)
-        return FALSE;
+    IdleMonitor *monitor = user_data;
+    XEvent *ev = xevent;
 
-    const gchar *app_id = g_application_get_application_id(G_APPLICATION(app));
-    if (app_id == NULL)
-        app_id = "mate-application";
+    if (ev->type != monitor->event_base + XSyncAlarmNotify)
+        return GDK_FILTER_CONTINUE;
 
-    GError *error = NULL;
-    GVariant *result = g_dbus_proxy_call_sync(proxy,
-                                               "RegisterClient",
-                                               g_variant_new("(ss)",
-                                                              app_id,
-                                                              client_id ? client_id : ""),
-                                               G_DBUS_CALL_FLAGS_NONE,
-                                               -1,
-                                               NULL,
-                                               &error);
+    XSyncAlarmNotifyEvent *alarm_event = (XSyncAlarmNotifyEvent *)ev;
+    guint64 idle = ((guint64)(guint32)XSyncValueHigh32(alarm_event->counter_value) << 32) |
+                   (guint32)XSyncValueLow32(alarm_event->counter_value);
 
-    if (result != NULL)
+    if (alarm_event->alarm == monitor->reset_alarm)
     {
-        g_variant_unref(result);
-        return TRUE;
+        idle_monitor_became_active(monitor);
+        idle_monitor_check(monitor, idle);
+        idle_monitor_rearm(monitor, idle);
+        return GDK_FILTER_REMOVE;
     }
 
-    if (error != NULL)
+    if (alarm_event->alarm == monitor->idle_alarm)
     {
-        g_warning("Failed to register with session manager: %s", error->message);
-        g_error_free(error);
+        idle_monitor_check(monitor, idle);
+        idle_monitor_rearm(monitor, idle);
+        return GDK_FILTER_REMOVE;
     }
 
-    return FALSE;
+    return GDK_FILTER_CONTINUE;
 }
 
-/**
- * mate_ui_session_set_restart_command:
- * @app: A #GtkApplication
- * @argc: Number of arguments
- * @argv: Argument vector
- *
- * Sets the command to restart this application.
- */
-void
-mate_ui_session_set_restart_command(GtkApplication  *app,
-                                     gint             argc G_GNUC_UNUSED,
-                                     const gchar    **argv)
+static gboolean
+idle_monitor_init_xsync(IdleMonitor *monitor)
 {
-    g_return_if_fail(GTK_IS_APPLICATION(app));
-    g_return_if_fail(argv != NULL);
+    IdleTime *state = idle_time_get();
+    if (state->backend != IDLE_BACKEND_XSYNC)
+        return FALSE;
 
-    /* Store as application data for session save */
-    gchar **argv_copy = g_strdupv((gchar **)argv);
-    g_object_set_data_full(G_OBJECT(app), "mate-ui-restart-command",
-                            argv_copy, (GDestroyNotify)g_strfreev);
+    monitor->xdisplay = state->xdisplay;
+    monitor->counter = state->counter;
+    monitor->event_base = state->sync_event_base;
+    monitor->idle_alarm = None;
+    monitor->reset_alarm = None;
+
+    gdk_window_add_filter(NULL, idle_monitor_xevent_filter, monitor);
+    return TRUE;
 }
+#endif
 
-/**
- * mate_ui_session_request_save:
- * @app: A #GtkApplication
- *
- * Requests the session to save state.
- *
- * Returns: %TRUE if request was accepted
- */
-gboolean
-mate_ui_session_request_save(GtkApplication *app)
+static gboolean
+idle_monitor_timeout_cb(gpointer user_data)
 {
-    g_return_val_if_fail(GTK_IS_APPLICATION(app), FALSE);
+    IdleMonitor *monitor = user_data;
+    guint64 idle = mate_ui_session_get_idle_time();
 
-    GDBusProxy *proxy = get_session_manager_proxy();
-    if (proxy == NULL)
-        return FALSE;
+    monitor->timeout_id = 0;
 
-    GError *error = NULL;
-    GVariant *result = g_dbus_proxy_call_sync(proxy,
-                                               "RequestSave",
-                                               NULL,
-                                               G_DBUS_CALL_FLAGS_NONE,
-                                               -1,
-                                               NULL,
-                                               &error);
+    if (monitor->fired->len > 0 && idle < monitor->last_idle)
+        idle_monitor_became_active(monitor);
+
+    idle_monitor_check(monitor, idle);
+    idle_monitor_rearm(monitor, idle);
 
-    if (result != NULL)
+    return G_SOURCE_REMOVE;
+}
+
+/* Arms whatever wakeup is needed for the next state change after @idle */
+static void
+idle_monitor_rearm(IdleMonitor *monitor,
+                   guint64      idle)
+{
+    guint64 next_idle = idle_monitor_next_threshold(monitor);
+
+    if (monitor->timeout_id != 0)
     {
-        g_variant_unref(result);
-        return TRUE;
+        g_source_remove(monitor->timeout_id);
+        monitor->timeout_id = 0;
     }
 
-    if (error != NULL)
+#if HAVE_XSYNC
+    if (monitor->xdisplay != NULL)
     {
-        g_warning("Failed to request session save: %s", error->message);
-        g_error_free(error);
+        if (next_idle != G_MAXUINT64)
+            monitor->idle_alarm = idle_monitor_set_alarm(monitor, monitor->idle_alarm,
+                                                         XSyncPositiveComparison,
+                                                         next_idle);
+        else
+            idle_monitor_clear_alarm(monitor, &monitor->idle_alarm);
+
+        if (monitor->fired->len > 0)
+        {
+            guint64 min_fired = G_MAXUINT64;
+            for (guint i = 0; i < monitor->fired->len; i++)
+                min_fired = MIN(min_fired, IDLE_HEAP_AT(monitor->fired, i)->threshold);
+
+            monitor->reset_alarm = idle_monitor_set_alarm(monitor, monitor->reset_alarm,
+                                                          XSyncNegativeTransition,
+                                                          min_fired > 0 ? min_fired - 1 : 0);
+        }
+        else
+        {
+            idle_monitor_clear_alarm(monitor, &monitor->reset_alarm);
+        }
+
+        XFlush(monitor->xdisplay);
+        return;
     }
+#endif
 
-    return FALSE;
+    guint64 interval = G_MAXUINT64;
+
+    if (next_idle != G_MAXUINT64)
+        interval = next_idle > idle ? next_idle - idle : 1;
+
+    /* Without server-side alarms, activity can only be noticed by polling */
+    if (monitor->fired->len > 0)
+        interval = MIN(interval, IDLE_ACTIVE_POLL_MS);
+
+    if (interval == G_MAXUINT64)
+        return;
+
+    monitor->timeout_id = g_timeout_add_full(G_PRIORITY_DEFAULT,
+                                             (guint)MIN(interval, G_MAXUINT),
+                                             idle_monitor_timeout_cb,
+                                             monitor,
+                                             NULL);
 }
 
 /**
- * mate_ui_session_request_logout:
- * @prompt: Whether to prompt the user
+ * mate_ui_session_add_idle_watch:
+ * @idle_time_ms: Idle time threshold in milliseconds
+ * @idle_func: (nullable): Function to call when the threshold is reached
+ * @active_func: (nullable): Function to call when the user becomes active
+ *   again after @idle_func was called
+ * @user_data: User data for the callbacks
+ * @destroy: (nullable): Destroy notify for user data
+ *
+ * Adds a watch that is notified once each time the user has been idle
+ * for @idle_time_ms, and once when they become active again.
+ * @idle_time_ms must be greater than 0.
  *
- * Requests the session to log out.
+ * Returns: A watch ID for mate_ui_session_remove_idle_watch(), or 0 if
+ *   the arguments are invalid
  */
-void
-mate_ui_session_request_logout(gboolean prompt)
+guint
+mate_ui_session_add_idle_watch(guint64                idle_time_ms,
+                                MateUiSessionIdleFunc  idle_func,
+                                MateUiSessionIdleFunc  active_func,
+                                gpointer               user_data,
+                                GDestroyNotify         destroy)
 {
-    GDBusProxy *proxy = get_session_manager_proxy();
-    if (proxy == NULL)
-        return;
-
-    GError *error = NULL;
-    GVariant *result = g_dbus_proxy_call_sync(proxy,
-                                               "Logout",
-                                               g_variant_new("(u)", prompt ? 0 : 1),
-                                               G_DBUS_CALL_FLAGS_NONE,
-                                               -1,
-                                               NULL,
-                                               &error);
+    g_return_val_if_fail(idle_time_ms > 0, 0);
+    g_return_val_if_fail(idle_func != NULL || active_func != NULL, 0);
 
-    if (result != NULL)
-        g_variant_unref(result);
+    IdleMonitor *monitor = &idle_monitor;
 
-    if (error != NULL)
+    if (!monitor->initialized)
     {
-        g_warning("Failed to request logout: %s", error->message);
-        g_error_free(error);
+        monitor->watches = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                                 NULL, idle_watch_free);
+        monitor->pending = g_ptr_array_new();
+        monitor->fired = g_ptr_array_new();
+        monitor->next_id = 1;
+#if HAVE_XSYNC
+        idle_monitor_init_xsync(monitor);
+#endif
+        monitor->initialized = TRUE;
     }
+
+    IdleWatch *watch = g_new0(IdleWatch, 1);
+    watch->id = monitor->next_id++;
+    watch->threshold = idle_time_ms;
+    watch->idle_func = idle_func;
+    watch->active_func = active_func;
+    watch->user_data = user_data;
+    watch->destroy = destroy;
+
+    g_hash_table_insert(monitor->watches, GUINT_TO_POINTER(watch->id), watch);
+    idle_heap_push(monitor->pending, watch);
+
+    idle_monitor_rearm(monitor, idle_monitor_estimate(monitor));
+
+    return watch->id;
 }
 
 /**
- * mate_ui_session_request_shutdown:
- * @prompt: Whether to prompt the user
+ * mate_ui_session_remove_idle_watch:
+ * @watch_id: A watch ID returned by mate_ui_session_add_idle_watch()
  *
- * Requests the system to shut down.
+ * Removes an idle watch.
  */
 void
-mate_ui_session_request_shutdown(gboolean prompt G_GNUC_UNUSED)
+mate_ui_session_remove_idle_watch(guint watch_id)
 {
-    GDBusProxy *proxy = get_session_manager_proxy();
-    if (proxy == NULL)
+    IdleMonitor *monitor = &idle_monitor;
+
+    g_return_if_fail(watch_id > 0);
+
+    if (!monitor->initialized)
         return;
 
-    GError *error = NULL;
-    GVariant *result = g_dbus_proxy_call_sync(proxy,
-                                               "Shutdown",
-                                               NULL,
-                                               G_DBUS_CALL_FLAGS_NONE,
-                                               -1,
-                                               NULL,
-                                               &error);
+    IdleWatch *watch = g_hash_table_lookup(monitor->watches, GUINT_TO_POINTER(watch_id));
+    if (watch == NULL)
+        return;
 
-    if (result != NULL)
-        g_variant_unref(result);
+    if (watch->fired)
+        idle_fired_remove(monitor->fired, watch);
+    else
+        idle_heap_remove(monitor->pending, watch);
 
-    if (error != NULL)
-    {
-        g_warning("Failed to request shutdown: %s", error->message);
-        g_error_free(error);
-    }
+    g_hash_table_remove(monitor->watches, GUINT_TO_POINTER(watch_id));
+    idle_monitor_rearm(monitor, idle_monitor_estimate(monitor));
 }
 
-/**
- * mate_ui_session_request_reboot:
- * @prompt: Whether to prompt the user
+/*
+ * Idle callbacks
  *
- * Requests the system to reboot.
+ * mate_ui_session_set_idle_callback() returns a main loop source ID, so
+ * each callback is a source of its own. It stays dormant while the user
+ * is active, is made ready by an idle watch, and then repeats every
+ * second until the user becomes active again.
  */
-void
-mate_ui_session_request_reboot(gboolean prompt G_GNUC_UNUSED)
+typedef struct
 {
-    GDBusProxy *proxy = get_session_manager_proxy();
-    if (proxy == NULL)
-        return;
+    GSource         source;
+    guint           watch_id;
+    GCallback       callback;
+    gpointer        user_data;
+    GDestroyNotify  destroy;
+} IdleCallbackSource;
 
-    GError *error = NULL;
-    GVariant *result = g_dbus_proxy_call_sync(proxy,
-                                               "Reboot",
-                                               NULL,
-                                               G_DBUS_CALL_FLAGS_NONE,
-                                               -1,
-                                               NULL,
-                                               &error);
+static gboolean
+idle_callback_dispatch(GSource     *source,
+                       GSourceFunc  func G_GNUC_UNUSED,
+                       gpointer     data G_GNUC_UNUSED)
+{
+    IdleCallbackSource *idle = (IdleCallbackSource *) source;
+    void (*cb)(gpointer) = (void (*)(gpointer)) idle->callback;
 
-    if (result != NULL)
-        g_variant_unref(result);
+    g_source_set_ready_time(source, g_source_get_time(source) + G_USEC_PER_SEC);
+    cb(idle->user_data);
 
-    if (error != NULL)
-    {
-        g_warning("Failed to request reboot: %s", error->message);
-        g_error_free(error);
-    }
+    return G_SOURCE_CONTINUE;
 }
 
-/* Save callback data */
-typedef struct
+static void
+idle_callback_finalize(GSource *source)
 {
-    MateUiSessionSaveCallback callback;
-    gpointer                  user_data;
-    GDestroyNotify            destroy;
-} SaveCallbackData;
+    IdleCallbackSource *idle = (IdleCallbackSource *) source;
+
+    if (idle->watch_id != 0)
+        mate_ui_session_remove_idle_watch(idle->watch_id);
+    if (idle->destroy != NULL)
+        idle->destroy(idle->user_data);
+}
+
+static GSourceFuncs idle_callback_funcs = {
+    NULL,
+    NULL,
+    idle_callback_dispatch,
+    idle_callback_finalize,
+    NULL,
+    NULL
+};
 
 static void
-save_callback_data_free(gpointer data)
+idle_callback_idle(gpointer user_data)
 {
-    SaveCallbackData *d = data;
-    if (d->destroy != NULL)
-        d->destroy(d->user_data);
-    g_free(d);
+    g_source_set_ready_time(user_data, 0);
 }
 
-/**
- * mate_ui_session_set_save_callback:
- * @app: A #GtkApplication
- * @callback: Callback for save requests
- * @user_data: User data for callback
- * @destroy: (nullable): Destroy notify for user data
- *
- * Sets a callback to be called when the session manager requests
- * the application to save its state.
- */
-void
-mate_ui_session_set_save_callback(GtkApplication            *app,
-                                   MateUiSessionSaveCallback  callback,
-                                   gpointer                   user_data,
-                                   GDestroyNotify             destroy)
+static void
+idle_callback_active(gpointer user_data)
 {
-    g_return_if_fail(GTK_IS_APPLICATION(app));
-
-    SaveCallbackData *data = g_new0(SaveCallbackData, 1);
-    data->callback = callback;
-    data->user_data = user_data;
-    data->destroy = destroy;
-
-    g_object_set_data_full(G_OBJECT(app), "mate-ui-save-callback",
-                            data, save_callback_data_free);
+    g_source_set_ready_time(user_data, -1);
 }
 
 /**
- * mate_ui_session_get_idle_time:
+ * mate_ui_session_get_idle_source_count:
  *
- * Gets the current idle time in milliseconds.
+ * Gets the number of wakeup sources the idle monitor currently has armed:
+ * main loop timeouts plus X server alarms. This does not grow with the
+ * number of watches; it is at most one timeout, or two server alarms.
  *
- * Returns: Idle time in milliseconds
+ * Returns: Number of armed wakeup sources
  */
-guint64
-mate_ui_session_get_idle_time(void)
-{
-#if defined(HAVE_X11) && defined(HAVE_XSS)
-    GdkDisplay *display = gdk_display_get_default();
-    if (GDK_IS_X11_DISPLAY(display))
-    {
-        Display *xdisplay = GDK_DISPLAY_XDISPLAY(display);
-        int event_base, error_base;
-
-        if (XScreenSaverQueryExtension(xdisplay, &event_base, &error_base))
-        {
-            XScreenSaverInfo *info = XScreenSaverAllocInfo();
-            if (info != NULL)
-            {
-                Window root = DefaultRootWindow(xdisplay);
-                XScreenSaverQueryInfo(xdisplay, root, info);
-                guint64 idle = info->idle;
-                XFree(info);
-                return idle;
-            }
-        }
-    }
-#endif
-
-    /* Fallback: return 0 (not idle) */
-    return 0;
-}
-
-/* Idle callback data */
-typedef struct
-{
-    guint64        threshold;
-    GCallback      callback;
-    gpointer       user_data;
-    GDestroyNotify destroy;
-    guint          source_id;
-} IdleCallbackData;
-
-static gboolean
-idle_check_callback(gpointer user_data)
+guint
+mate_ui_session_get_idle_source_count(void)
 {
-    IdleCallbackData *data = user_data;
-    guint64 idle_time = mate_ui_session_get_idle_time();
+    IdleMonitor *monitor = &idle_monitor;
+    guint count = 0;
 
-    if (idle_time >= data->threshold)
-    {
-        void (*cb)(gpointer) = (void (*)(gpointer))data->callback;
-        cb(data->user_data);
-    }
+    if (monitor->timeout_id != 0)
+        count++;
 
-    return G_SOURCE_CONTINUE;
-}
+#if HAVE_XSYNC
+    if (monitor->idle_alarm != None)
+        count++;
+    if (monitor->reset_alarm != None)
+        count++;
+#endif
 
-static void
-idle_callback_data_free(gpointer data)
-{
-    IdleCallbackData *d = data;
-    if (d->destroy != NULL)
-        d->destroy(d->user_data);
-    g_free(d);
+    return count;
 }
 
 /**
@@ -586,8 +3520,10 @@ idle_callback_data_free(gpointer data)
  * @user_data: User data for callback
  * @destroy: (nullable): Destroy notify for user data
  *
- * Sets a callback to be called when the user has been idle
- * for the specified time.
+ * Sets a callback to be called every second while the user has been
+ * idle for at least the specified time. With an @idle_time_ms of 0 it
+ * is called every second. Unlike polling, nothing runs while the user
+ * is active.
  *
  * Returns: A source ID that can be used with g_source_remove()
  */
@@ -599,18 +3535,28 @@ mate_ui_session_set_idle_callback(guint64        idle_time_ms,
 {
     g_return_val_if_fail(callback != NULL, 0);
 
-    IdleCallbackData *data = g_new0(IdleCallbackData, 1);
-    data->threshold = idle_time_ms;
-    data->callback = callback;
-    data->user_data = user_data;
-    data->destroy = destroy;
+    GSource *source = g_source_new(&idle_callback_funcs, sizeof(IdleCallbackSource));
+    IdleCallbackSource *idle = (IdleCallbackSource *) source;
+
+    idle->callback = callback;
+    idle->user_data = user_data;
+    idle->destroy = destroy;
+
+    if (idle_time_ms > 0)
+    {
+        idle->watch_id = mate_ui_session_add_idle_watch(idle_time_ms,
+                                                         idle_callback_idle,
+                                                         idle_callback_active,
+                                                         source,
+                                                         NULL);
+    }
+    else
+    {
+        g_source_set_ready_time(source, g_get_monotonic_time() + G_USEC_PER_SEC);
+    }
+
+    guint source_id = g_source_attach(source, NULL);
+    g_source_unref(source);
 
-    /* Check every second */
-    guint source_id = g_timeout_add_seconds_full(G_PRIORITY_DEFAULT,
-                                                   1,
-                                                   idle_check_callback,
-                                                   data,
-                                                   idle_callback_data_free);
-    data->source_id = source_id;
     return source_id;
 }
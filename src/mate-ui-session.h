@@ -40,6 +40,39 @@ typedef enum
  */
 typedef struct _MateUiSessionInhibitor MateUiSessionInhibitor;
 
+/**
+ * MATE_UI_SESSION_DEFAULT_TIMEOUT:
+ *
+ * Default timeout for session manager calls, in milliseconds.
+ */
+#define MATE_UI_SESSION_DEFAULT_TIMEOUT 5000
+
+/**
+ * MATE_UI_SESSION_DEFAULT_SAVE_TIMEOUT:
+ *
+ * Default time the save callback may take when the session ends, in
+ * milliseconds.
+ */
+#define MATE_UI_SESSION_DEFAULT_SAVE_TIMEOUT 4000
+
+/**
+ * mate_ui_session_set_timeout:
+ * @timeout_ms: Timeout in milliseconds, or -1 for the D-Bus default
+ *
+ * Sets the timeout applied to session manager calls. Synchronous
+ * functions never block for longer than this.
+ */
+void mate_ui_session_set_timeout(gint timeout_ms);
+
+/**
+ * mate_ui_session_get_timeout:
+ *
+ * Gets the timeout applied to session manager calls.
+ *
+ * Returns: Timeout in milliseconds
+ */
+gint mate_ui_session_get_timeout(void);
+
 /**
  * mate_ui_session_inhibit:
  * @app: (nullable): A #GtkApplication or %NULL
@@ -48,7 +81,8 @@ typedef struct _MateUiSessionInhibitor MateUiSessionInhibitor;
  * @reason: Human-readable reason for the inhibition
  *
  * Inhibits session actions. The inhibitor must be released with
- * mate_ui_session_uninhibit().
+ * mate_ui_session_uninhibit(). Requests for the same @flags share a
+ * single inhibition with the session manager.
  *
  * Returns: (transfer full) (nullable): An inhibitor handle or %NULL on failure
  */
@@ -57,24 +91,144 @@ MateUiSessionInhibitor *mate_ui_session_inhibit(GtkApplication     *app,
                                                   MateUiInhibitFlags  flags,
                                                   const gchar        *reason);
 
+/**
+ * mate_ui_session_inhibit_async:
+ * @app: (nullable): A #GtkApplication or %NULL
+ * @window: (nullable): A #GtkWindow or %NULL
+ * @flags: What to inhibit
+ * @reason: Human-readable reason for the inhibition
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously inhibits session actions.
+ */
+void mate_ui_session_inhibit_async(GtkApplication      *app,
+                                    GtkWindow           *window,
+                                    MateUiInhibitFlags   flags,
+                                    const gchar         *reason,
+                                    GCancellable        *cancellable,
+                                    GAsyncReadyCallback  callback,
+                                    gpointer             user_data);
+
+/**
+ * mate_ui_session_inhibit_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_inhibit_async().
+ *
+ * Returns: (transfer full) (nullable): An inhibitor handle or %NULL on failure
+ */
+MateUiSessionInhibitor *mate_ui_session_inhibit_finish(GAsyncResult  *result,
+                                                         GError       **error);
+
 /**
  * mate_ui_session_uninhibit:
  * @inhibitor: An inhibitor returned by mate_ui_session_inhibit()
  *
- * Releases a session inhibitor.
+ * Releases a session inhibitor. Does not block: the release is sent from
+ * the default main context, and a failure is logged.
  */
 void mate_ui_session_uninhibit(MateUiSessionInhibitor *inhibitor);
 
+/**
+ * mate_ui_session_uninhibit_async:
+ * @inhibitor: An inhibitor returned by mate_ui_session_inhibit()
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously releases a session inhibitor. The inhibitor handle is
+ * consumed and must not be used again. The release always goes out;
+ * cancelling @cancellable only affects the result passed to @callback.
+ */
+void mate_ui_session_uninhibit_async(MateUiSessionInhibitor *inhibitor,
+                                      GCancellable           *cancellable,
+                                      GAsyncReadyCallback     callback,
+                                      gpointer                user_data);
+
+/**
+ * mate_ui_session_uninhibit_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_uninhibit_async().
+ *
+ * Returns: %TRUE on success
+ */
+gboolean mate_ui_session_uninhibit_finish(GAsyncResult  *result,
+                                           GError       **error);
+
+/**
+ * mate_ui_session_get_inhibit_cookie_count:
+ *
+ * Gets the number of real inhibitions this process holds. Handles for
+ * the same flags share one inhibition.
+ *
+ * Returns: The number of inhibit cookies currently held
+ */
+guint mate_ui_session_get_inhibit_cookie_count(void);
+
+#define MATE_UI_TYPE_SESSION_MONITOR (mate_ui_session_monitor_get_type())
+G_DECLARE_FINAL_TYPE(MateUiSessionMonitor, mate_ui_session_monitor, MATE_UI, SESSION_MONITOR, GObject)
+
+/**
+ * mate_ui_session_monitor_get_default:
+ *
+ * Gets the monitor that reports changes in session state.
+ *
+ * Returns: (transfer none): The default #MateUiSessionMonitor
+ */
+MateUiSessionMonitor *mate_ui_session_monitor_get_default(void);
+
+/**
+ * mate_ui_session_get_inhibited_flags:
+ *
+ * Gets the session actions currently inhibited by any client, without
+ * a bus call.
+ *
+ * Returns: The inhibited #MateUiInhibitFlags, or 0 if not yet known
+ */
+MateUiInhibitFlags mate_ui_session_get_inhibited_flags(void);
+
 /**
  * mate_ui_session_is_inhibited:
  * @flags: Flags to check
  *
- * Checks if any session actions are currently inhibited.
+ * Checks if any session actions are currently inhibited. Answered from
+ * cached state once the session manager is being tracked.
  *
  * Returns: %TRUE if inhibited
  */
 gboolean mate_ui_session_is_inhibited(MateUiInhibitFlags flags);
 
+/**
+ * mate_ui_session_is_inhibited_async:
+ * @flags: Flags to check
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously checks if any session actions are currently inhibited.
+ */
+void mate_ui_session_is_inhibited_async(MateUiInhibitFlags   flags,
+                                         GCancellable        *cancellable,
+                                         GAsyncReadyCallback  callback,
+                                         gpointer             user_data);
+
+/**
+ * mate_ui_session_is_inhibited_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_is_inhibited_async().
+ *
+ * Returns: %TRUE if inhibited, %FALSE if not or on error
+ */
+gboolean mate_ui_session_is_inhibited_finish(GAsyncResult  *result,
+                                              GError       **error);
+
 /**
  * mate_ui_session_register:
  * @app: A #GtkApplication
@@ -87,6 +241,36 @@ gboolean mate_ui_session_is_inhibited(MateUiInhibitFlags flags);
 gboolean mate_ui_session_register(GtkApplication *app,
                                    const gchar    *client_id);
 
+/**
+ * mate_ui_session_register_async:
+ * @app: A #GtkApplication
+ * @client_id: (nullable): Session client ID or %NULL
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously registers the application with the session manager.
+ * Once sent, the registration is always completed; cancelling
+ * @cancellable only affects the result passed to @callback.
+ */
+void mate_ui_session_register_async(GtkApplication      *app,
+                                     const gchar         *client_id,
+                                     GCancellable        *cancellable,
+                                     GAsyncReadyCallback  callback,
+                                     gpointer             user_data);
+
+/**
+ * mate_ui_session_register_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_register_async().
+ *
+ * Returns: %TRUE on success
+ */
+gboolean mate_ui_session_register_finish(GAsyncResult  *result,
+                                          GError       **error);
+
 /**
  * mate_ui_session_set_restart_command:
  * @app: A #GtkApplication
@@ -109,6 +293,32 @@ void mate_ui_session_set_restart_command(GtkApplication  *app,
  */
 gboolean mate_ui_session_request_save(GtkApplication *app);
 
+/**
+ * mate_ui_session_request_save_async:
+ * @app: A #GtkApplication
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously requests the session to save state.
+ */
+void mate_ui_session_request_save_async(GtkApplication      *app,
+                                         GCancellable        *cancellable,
+                                         GAsyncReadyCallback  callback,
+                                         gpointer             user_data);
+
+/**
+ * mate_ui_session_request_save_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_request_save_async().
+ *
+ * Returns: %TRUE if request was accepted
+ */
+gboolean mate_ui_session_request_save_finish(GAsyncResult  *result,
+                                              GError       **error);
+
 /**
  * mate_ui_session_request_logout:
  * @prompt: Whether to prompt the user
@@ -117,6 +327,32 @@ gboolean mate_ui_session_request_save(GtkApplication *app);
  */
 void mate_ui_session_request_logout(gboolean prompt);
 
+/**
+ * mate_ui_session_request_logout_async:
+ * @prompt: Whether to prompt the user
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously requests the session to log out.
+ */
+void mate_ui_session_request_logout_async(gboolean             prompt,
+                                          GCancellable        *cancellable,
+                                          GAsyncReadyCallback  callback,
+                                          gpointer             user_data);
+
+/**
+ * mate_ui_session_request_logout_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_request_logout_async().
+ *
+ * Returns: %TRUE if the request was delivered
+ */
+gboolean mate_ui_session_request_logout_finish(GAsyncResult  *result,
+                                               GError       **error);
+
 /**
  * mate_ui_session_request_shutdown:
  * @prompt: Whether to prompt the user
@@ -125,6 +361,32 @@ void mate_ui_session_request_logout(gboolean prompt);
  */
 void mate_ui_session_request_shutdown(gboolean prompt);
 
+/**
+ * mate_ui_session_request_shutdown_async:
+ * @prompt: Whether to prompt the user
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously requests the system to shut down.
+ */
+void mate_ui_session_request_shutdown_async(gboolean             prompt,
+                                            GCancellable        *cancellable,
+                                            GAsyncReadyCallback  callback,
+                                            gpointer             user_data);
+
+/**
+ * mate_ui_session_request_shutdown_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_request_shutdown_async().
+ *
+ * Returns: %TRUE if the request was delivered
+ */
+gboolean mate_ui_session_request_shutdown_finish(GAsyncResult  *result,
+                                                 GError       **error);
+
 /**
  * mate_ui_session_request_reboot:
  * @prompt: Whether to prompt the user
@@ -133,6 +395,32 @@ void mate_ui_session_request_shutdown(gboolean prompt);
  */
 void mate_ui_session_request_reboot(gboolean prompt);
 
+/**
+ * mate_ui_session_request_reboot_async:
+ * @prompt: Whether to prompt the user
+ * @cancellable: (nullable): A #GCancellable or %NULL
+ * @callback: Callback to invoke when the request is complete
+ * @user_data: User data for @callback
+ *
+ * Asynchronously requests the system to reboot.
+ */
+void mate_ui_session_request_reboot_async(gboolean             prompt,
+                                          GCancellable        *cancellable,
+                                          GAsyncReadyCallback  callback,
+                                          gpointer             user_data);
+
+/**
+ * mate_ui_session_request_reboot_finish:
+ * @result: A #GAsyncResult
+ * @error: Return location for error
+ *
+ * Finishes an operation started with mate_ui_session_request_reboot_async().
+ *
+ * Returns: %TRUE if the request was delivered
+ */
+gboolean mate_ui_session_request_reboot_finish(GAsyncResult  *result,
+                                               GError       **error);
+
 /**
  * MateUiSessionSaveCallback:
  * @user_data: User data
@@ -151,22 +439,117 @@ typedef gboolean (*MateUiSessionSaveCallback)(gpointer user_data);
  * @destroy: (nullable): Destroy notify for user data
  *
  * Sets a callback to be called when the session manager requests
- * the application to save its state.
+ * the application to save its state. The application must have been
+ * registered with mate_ui_session_register().
  */
 void mate_ui_session_set_save_callback(GtkApplication            *app,
                                         MateUiSessionSaveCallback  callback,
                                         gpointer                   user_data,
                                         GDestroyNotify             destroy);
 
+/**
+ * mate_ui_session_set_save_timeout:
+ * @timeout_ms: Timeout in milliseconds
+ *
+ * Sets how long the save callback may take when the session ends.
+ */
+void mate_ui_session_set_save_timeout(guint timeout_ms);
+
+/**
+ * mate_ui_session_get_save_timeout:
+ *
+ * Gets how long the save callback may take when the session ends.
+ *
+ * Returns: Timeout in milliseconds
+ */
+guint mate_ui_session_get_save_timeout(void);
+
+/**
+ * mate_ui_session_hold_save:
+ *
+ * Delays the answer to the session manager until a matching
+ * mate_ui_session_release_save(). Call from the save callback to
+ * finish saving asynchronously.
+ */
+void mate_ui_session_hold_save(void);
+
+/**
+ * mate_ui_session_release_save:
+ * @success: Whether the held work saved its state
+ *
+ * Releases a hold taken with mate_ui_session_hold_save().
+ */
+void mate_ui_session_release_save(gboolean success);
+
 /**
  * mate_ui_session_get_idle_time:
  *
  * Gets the current idle time in milliseconds.
  *
- * Returns: Idle time in milliseconds
+ * Returns: Idle time in milliseconds, or 0 if it is not known
  */
 guint64 mate_ui_session_get_idle_time(void);
 
+/**
+ * mate_ui_session_has_idle_time:
+ *
+ * Checks whether mate_ui_session_get_idle_time() reports a measured
+ * value rather than always returning 0.
+ *
+ * Returns: %TRUE if the idle time is real
+ */
+gboolean mate_ui_session_has_idle_time(void);
+
+/**
+ * MateUiSessionIdleFunc:
+ * @user_data: User data
+ *
+ * Callback for idle state transitions.
+ */
+typedef void (*MateUiSessionIdleFunc)(gpointer user_data);
+
+/**
+ * mate_ui_session_add_idle_watch:
+ * @idle_time_ms: Idle time threshold in milliseconds
+ * @idle_func: (nullable): Function to call when the threshold is reached
+ * @active_func: (nullable): Function to call when the user becomes active
+ *   again after @idle_func was called
+ * @user_data: User data for the callbacks
+ * @destroy: (nullable): Destroy notify for user data
+ *
+ * Adds a watch that is notified once each time the user has been idle
+ * for @idle_time_ms, and once when they become active again. Watches do
+ * not poll while the user is active. @idle_time_ms must be greater
+ * than 0.
+ *
+ * Returns: A watch ID for mate_ui_session_remove_idle_watch(), or 0 if
+ *   the arguments are invalid
+ */
+guint mate_ui_session_add_idle_watch(guint64                idle_time_ms,
+                                      MateUiSessionIdleFunc  idle_func,
+                                      MateUiSessionIdleFunc  active_func,
+                                      gpointer               user_data,
+                                      GDestroyNotify         destroy);
+
+/**
+ * mate_ui_session_remove_idle_watch:
+ * @watch_id: A watch ID returned by mate_ui_session_add_idle_watch()
+ *
+ * Removes an idle watch.
+ */
+void mate_ui_session_remove_idle_watch(guint watch_id);
+
+/**
+ * mate_ui_session_get_idle_source_count:
+ *
+ * Gets the number of wakeup sources the idle monitor currently has armed.
+ * All idle watches share these sources, so the count does not grow with
+ * the number of watches.
+ *
+ * Returns: Number of armed wakeup sources
+ */
+guint mate_ui_session_get_idle_source_count(void);
+
 /**
  * mate_ui_session_set_idle_callback:
  * @idle_time_ms: Idle time threshold in milliseconds
@@ -174,8 +557,10 @@ guint64 mate_ui_session_get_idle_time(void);
  * @user_data: User data for callback
  * @destroy: (nullable): Destroy notify for user data
  *
- * Sets a callback to be called when the user has been idle
- * for the specified time.
+ * Sets a callback to be called every second while the user has been
+ * idle for at least the specified time. With an @idle_time_ms of 0 it
+ * is called every second. Unlike polling, nothing runs while the user
+ * is active.
  *
  * Returns: A source ID that can be used with g_source_remove()
  */
@@ -72,6 +72,29 @@ mate_ui_window_rebuild_layout(MateUiWindow *self)
     }
 }
 
+/*
+ * Replaces one child of main_box at its place in the layout, leaving the
+ * other children packed, instead of rebuilding the whole layout.
+ */
+static void
+mate_ui_window_swap_child(MateUiWindow *self,
+                          GtkWidget    *old_child,
+                          GtkWidget    *new_child,
+                          gint          position)
+{
+    MateUiWindowPrivate *priv = mate_ui_window_get_instance_private(self);
+
+    if (old_child != NULL && gtk_widget_get_parent(old_child) == priv->main_box)
+        gtk_container_remove(GTK_CONTAINER(priv->main_box), old_child);
+
+    if (new_child == NULL)
+        return;
+
+    gtk_box_pack_start(GTK_BOX(priv->main_box), new_child, FALSE, FALSE, 0);
+    gtk_box_reorder_child(GTK_BOX(priv->main_box), new_child, position);
+    gtk_widget_show(new_child);
+}
+
 static gboolean
 mate_ui_window_configure_event(GtkWidget         *widget,
                                 GdkEventConfigure *event,
@@ -231,15 +254,18 @@ mate_ui_window_set_menubar(MateUiWindow *window,
     if (priv->menubar == menubar)
         return;
 
-    if (priv->menubar != NULL)
-        g_object_unref(priv->menubar);
+    GtkWidget *old_menubar = priv->menubar;
 
     priv->menubar = menubar;
 
     if (priv->menubar != NULL)
         g_object_ref_sink(priv->menubar);
 
-    mate_ui_window_rebuild_layout(window);
+    /* The menubar is always first */
+    mate_ui_window_swap_child(window, old_menubar, priv->menubar, 0);
+
+    if (old_menubar != NULL)
+        g_object_unref(old_menubar);
 }
 
 /**
@@ -278,15 +304,19 @@ mate_ui_window_set_toolbar(MateUiWindow *window,
     if (priv->toolbar == toolbar)
         return;
 
-    if (priv->toolbar != NULL)
-        g_object_unref(priv->toolbar);
+    GtkWidget *old_toolbar = priv->toolbar;
 
     priv->toolbar = toolbar;
 
     if (priv->toolbar != NULL)
         g_object_ref_sink(priv->toolbar);
 
-    mate_ui_window_rebuild_layout(window);
+    /* The toolbar follows the menubar */
+    mate_ui_window_swap_child(window, old_toolbar, priv->toolbar,
+                              priv->menubar != NULL ? 1 : 0);
+
+    if (old_toolbar != NULL)
+        g_object_unref(old_toolbar);
 }
 
 /**
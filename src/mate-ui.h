@@ -26,6 +26,7 @@
 #include "mate-ui-settings.h"
 #include "mate-ui-accel.h"
 #include "mate-ui-session.h"
+#include "mate-ui-command-palette.h"
 #include "mate-ui-util.h"
 
 #undef __MATE_UI_INSIDE__
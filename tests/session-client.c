@@ -0,0 +1,428 @@
+/*
+ * session-client.c - Tests for the libmateui session client
+ *
+ * Runs a private D-Bus daemon with a mock org.gnome.SessionManager,
+ * registers with it, then drives the client through the ClientPrivate
+ * signals and checks the EndSessionResponse calls it answers with.
+ *
+ * Run with: meson test -C build session-client
+ */
+
+#include "mate-ui.h"
+
+#define SM_DBUS_NAME      "org.gnome.SessionManager"
+#define SM_DBUS_PATH      "/org/gnome/SessionManager"
+#define SM_CLIENT_PATH    "/org/gnome/SessionManager/Client1"
+#define SM_CLIENT_PRIVATE "org.gnome.SessionManager.ClientPrivate"
+
+/* Short enough to keep the deadline tests quick */
+#define SAVE_TIMEOUT 200
+
+/*
+ * Mock session manager
+ *
+ * Lives on its own connection in the main context. The tests only use
+ * the asynchronous session calls, so replies flow while they wait.
+ */
+static const gchar mock_xml[] =
+    "<node>"
+    "  <interface name='org.gnome.SessionManager'>"
+    "    <method name='RegisterClient'>"
+    "      <arg type='s' direction='in'/>"
+    "      <arg type='s' direction='in'/>"
+    "      <arg type='o' direction='out'/>"
+    "    </method>"
+    "    <property name='InhibitedActions' type='u' access='read'/>"
+    "  </interface>"
+    "  <interface name='org.gnome.SessionManager.ClientPrivate'>"
+    "    <method name='EndSessionResponse'>"
+    "      <arg type='b' direction='in'/>"
+    "      <arg type='s' direction='in'/>"
+    "    </method>"
+    "    <signal name='QueryEndSession'>"
+    "      <arg type='u'/>"
+    "    </signal>"
+    "    <signal name='EndSession'>"
+    "      <arg type='u'/>"
+    "    </signal>"
+    "    <signal name='CancelEndSession'/>"
+    "    <signal name='Stop'/>"
+    "  </interface>"
+    "</node>";
+
+typedef struct
+{
+    GDBusConnection *connection;
+    guint            owned;
+    guint            registered;
+    guint            responses;
+    gboolean         is_ok;
+    gchar           *reason;
+    gint64           response_time;
+} Mock;
+
+static Mock mock;
+
+static void
+mock_method_call(GDBusConnection       *connection G_GNUC_UNUSED,
+                 const gchar           *sender G_GNUC_UNUSED,
+                 const gchar           *object_path G_GNUC_UNUSED,
+                 const gchar           *interface_name G_GNUC_UNUSED,
+                 const gchar           *method_name,
+                 GVariant              *parameters,
+                 GDBusMethodInvocation *invocation,
+                 gpointer               user_data G_GNUC_UNUSED)
+{
+    if (g_strcmp0(method_name, "RegisterClient") == 0)
+    {
+        mock.registered++;
+        g_dbus_method_invocation_return_value(invocation,
+                                              g_variant_new("(o)", SM_CLIENT_PATH));
+    }
+    else if (g_strcmp0(method_name, "EndSessionResponse") == 0)
+    {
+        g_free(mock.reason);
+        g_variant_get(parameters, "(bs)", &mock.is_ok, &mock.reason);
+        mock.response_time = g_get_monotonic_time();
+        mock.responses++;
+        g_dbus_method_invocation_return_value(invocation, NULL);
+    }
+}
+
+static GVariant *
+mock_get_property(GDBusConnection  *connection G_GNUC_UNUSED,
+                  const gchar      *sender G_GNUC_UNUSED,
+                  const gchar      *object_path G_GNUC_UNUSED,
+                  const gchar      *interface_name G_GNUC_UNUSED,
+                  const gchar      *property_name G_GNUC_UNUSED,
+                  GError          **error G_GNUC_UNUSED,
+                  gpointer          user_data G_GNUC_UNUSED)
+{
+    return g_variant_new_uint32(0);
+}
+
+static const GDBusInterfaceVTable mock_vtable = {
+    mock_method_call,
+    mock_get_property,
+    NULL,
+    { NULL }
+};
+
+static void
+mock_name_acquired_cb(GDBusConnection *connection G_GNUC_UNUSED,
+                      const gchar     *name G_GNUC_UNUSED,
+                      gpointer         user_data G_GNUC_UNUSED)
+{
+    mock.owned++;
+}
+
+static void
+mock_start(const gchar *address)
+{
+    GError *error = NULL;
+
+    mock.connection = g_dbus_connection_new_for_address_sync(address,
+                                                              G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                              G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                              NULL, NULL, &error);
+    g_assert_no_error(error);
+
+    GDBusNodeInfo *info = g_dbus_node_info_new_for_xml(mock_xml, &error);
+    g_assert_no_error(error);
+
+    g_dbus_connection_register_object(mock.connection, SM_DBUS_PATH,
+                                      info->interfaces[0], &mock_vtable,
+                                      NULL, NULL, &error);
+    g_assert_no_error(error);
+
+    g_dbus_connection_register_object(mock.connection, SM_CLIENT_PATH,
+                                      info->interfaces[1], &mock_vtable,
+                                      NULL, NULL, &error);
+    g_assert_no_error(error);
+
+    g_dbus_node_info_unref(info);
+
+    g_bus_own_name_on_connection(mock.connection, SM_DBUS_NAME,
+                                 G_BUS_NAME_OWNER_FLAGS_NONE,
+                                 mock_name_acquired_cb, NULL, NULL, NULL);
+}
+
+static void
+mock_emit(const gchar *signal_name,
+          GVariant    *parameters)
+{
+    GError *error = NULL;
+
+    g_dbus_connection_emit_signal(mock.connection, NULL,
+                                  SM_CLIENT_PATH, SM_CLIENT_PRIVATE, signal_name,
+                                  parameters, &error);
+    g_assert_no_error(error);
+}
+
+/* Main loop helpers */
+static gboolean
+set_flag_cb(gpointer user_data)
+{
+    *(gboolean *)user_data = TRUE;
+    return G_SOURCE_REMOVE;
+}
+
+/* Runs the main loop until *@counter reaches @expected or @timeout_ms pass */
+static gboolean
+wait_for(guint *counter,
+         guint  expected,
+         guint  timeout_ms)
+{
+    gboolean timed_out = FALSE;
+    guint timeout_id = g_timeout_add(timeout_ms, set_flag_cb, &timed_out);
+
+    while (*counter < expected && !timed_out)
+        g_main_context_iteration(NULL, TRUE);
+
+    if (!timed_out)
+        g_source_remove(timeout_id);
+
+    return *counter >= expected;
+}
+
+/* Runs the main loop for @timeout_ms */
+static void
+spin(guint timeout_ms)
+{
+    guint never = 0;
+
+    wait_for(&never, 1, timeout_ms);
+}
+
+/* Save callback */
+static guint saves;
+static gboolean save_result = TRUE;
+static gboolean save_hold;
+
+static gboolean
+save_cb(gpointer user_data G_GNUC_UNUSED)
+{
+    saves++;
+
+    if (save_hold)
+        mate_ui_session_hold_save();
+
+    return save_result;
+}
+
+static void
+reset(void)
+{
+    mock.responses = 0;
+    saves = 0;
+    save_result = TRUE;
+    save_hold = FALSE;
+}
+
+static void
+test_query_end_session(void)
+{
+    reset();
+
+    mock_emit("QueryEndSession", g_variant_new("(u)", 0));
+
+    g_assert_true(wait_for(&mock.responses, 1, 2000));
+    g_assert_true(mock.is_ok);
+    g_assert_cmpstr(mock.reason, ==, "");
+    g_assert_cmpuint(saves, ==, 0);
+}
+
+static void
+test_end_session(void)
+{
+    reset();
+
+    mock_emit("EndSession", g_variant_new("(u)", 0));
+
+    g_assert_true(wait_for(&mock.responses, 1, 2000));
+    g_assert_cmpuint(saves, ==, 1);
+    g_assert_true(mock.is_ok);
+    g_assert_cmpstr(mock.reason, ==, "");
+}
+
+static void
+test_end_session_failed(void)
+{
+    reset();
+    save_result = FALSE;
+
+    mock_emit("EndSession", g_variant_new("(u)", 0));
+
+    g_assert_true(wait_for(&mock.responses, 1, 2000));
+    g_assert_cmpuint(saves, ==, 1);
+    g_assert_false(mock.is_ok);
+    g_assert_cmpstr(mock.reason, ==, "Failed to save state");
+}
+
+static void
+test_end_session_deadline(void)
+{
+    reset();
+    save_hold = TRUE;
+
+    gint64 start = g_get_monotonic_time();
+    mock_emit("EndSession", g_variant_new("(u)", 0));
+
+    /* The hold is never released, so only the deadline answers */
+    g_assert_true(wait_for(&mock.responses, 1, SAVE_TIMEOUT * 10));
+    g_assert_cmpuint(saves, ==, 1);
+    g_assert_false(mock.is_ok);
+    g_assert_cmpstr(mock.reason, ==, "Saving state timed out");
+    g_assert_cmpint(mock.response_time - start, >=, SAVE_TIMEOUT * 1000);
+
+    /* Releasing after the deadline does nothing */
+    mate_ui_session_release_save(TRUE);
+    spin(SAVE_TIMEOUT / 2);
+    g_assert_cmpuint(mock.responses, ==, 1);
+}
+
+static void
+test_end_session_held(void)
+{
+    reset();
+    save_hold = TRUE;
+
+    mock_emit("EndSession", g_variant_new("(u)", 0));
+    g_assert_true(wait_for(&saves, 1, 2000));
+
+    /* Held saves are answered once released, before the deadline */
+    spin(SAVE_TIMEOUT / 4);
+    g_assert_cmpuint(mock.responses, ==, 0);
+
+    mate_ui_session_release_save(TRUE);
+    g_assert_true(wait_for(&mock.responses, 1, 2000));
+    g_assert_true(mock.is_ok);
+}
+
+static void
+test_cancel_end_session(void)
+{
+    reset();
+    save_hold = TRUE;
+
+    mock_emit("EndSession", g_variant_new("(u)", 0));
+    g_assert_true(wait_for(&saves, 1, 2000));
+
+    mock_emit("CancelEndSession", NULL);
+
+    /* Neither the deadline nor a late release answer */
+    spin(SAVE_TIMEOUT * 2);
+    mate_ui_session_release_save(TRUE);
+    spin(SAVE_TIMEOUT / 2);
+    g_assert_cmpuint(mock.responses, ==, 0);
+}
+
+static void
+stop_activate_cb(GApplication *app,
+                 gpointer      user_data G_GNUC_UNUSED)
+{
+    /* Only the Stop signal ends the run */
+    g_application_hold(app);
+
+    mock_emit("EndSession", g_variant_new("(u)", 0));
+    mock_emit("Stop", NULL);
+}
+
+static void
+test_stop(gconstpointer user_data)
+{
+    GApplication *app = G_APPLICATION((gpointer) user_data);
+
+    if (!gtk_init_check(NULL, NULL))
+    {
+        g_test_skip("Running the application needs a display");
+        return;
+    }
+
+    reset();
+    save_hold = TRUE;
+
+    gulong handler = g_signal_connect(app, "activate", G_CALLBACK(stop_activate_cb), NULL);
+    g_assert_cmpint(g_application_run(app, 0, NULL), ==, 0);
+    g_signal_handler_disconnect(app, handler);
+
+    /* Stopping drops the save in progress without answering */
+    spin(SAVE_TIMEOUT * 2);
+    g_assert_cmpuint(mock.responses, ==, 0);
+}
+
+static void
+register_cb(GObject      *source G_GNUC_UNUSED,
+            GAsyncResult *result,
+            gpointer      user_data)
+{
+    GError *error = NULL;
+
+    g_assert_true(mate_ui_session_register_finish(result, &error));
+    g_assert_no_error(error);
+
+    (*(guint *)user_data)++;
+}
+
+int
+main(int    argc,
+     char **argv)
+{
+    GError *error = NULL;
+
+    g_test_init(&argc, &argv, NULL);
+
+    /* Must come before anything connects to the session bus */
+    GTestDBus *bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(bus);
+
+    mock_start(g_test_dbus_get_bus_address(bus));
+    g_assert_true(wait_for(&mock.owned, 1, 5000));
+
+    GtkApplication *app = gtk_application_new("org.mate.UiSessionClientTest", G_APPLICATION_NON_UNIQUE);
+    mate_ui_session_set_save_callback(app, save_cb, NULL, NULL);
+    mate_ui_session_set_save_timeout(SAVE_TIMEOUT);
+
+    guint registered = 0;
+    mate_ui_session_register_async(app, NULL, NULL, register_cb, &registered);
+    g_assert_true(wait_for(&registered, 1, 5000));
+    g_assert_cmpuint(mock.registered, ==, 1);
+
+    /*
+     * The client subscribed before registering completed. A round trip
+     * on its connection makes sure the bus has applied the match rule
+     * before the mock emits anything.
+     */
+    GDBusConnection *connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+    g_assert_no_error(error);
+    GVariant *reply = g_dbus_connection_call_sync(connection,
+                                                  "org.freedesktop.DBus",
+                                                  "/org/freedesktop/DBus",
+                                                  "org.freedesktop.DBus",
+                                                  "GetId",
+                                                  NULL,
+                                                  G_VARIANT_TYPE("(s)"),
+                                                  G_DBUS_CALL_FLAGS_NONE,
+                                                  -1, NULL, &error);
+    g_assert_no_error(error);
+    g_variant_unref(reply);
+    g_object_unref(connection);
+
+    g_test_add_func("/session/client/query-end-session", test_query_end_session);
+    g_test_add_func("/session/client/end-session", test_end_session);
+    g_test_add_func("/session/client/end-session-failed", test_end_session_failed);
+    g_test_add_func("/session/client/end-session-held", test_end_session_held);
+    g_test_add_func("/session/client/end-session-deadline", test_end_session_deadline);
+    g_test_add_func("/session/client/cancel-end-session", test_cancel_end_session);
+    g_test_add_data_func("/session/client/stop", app, test_stop);
+
+    gint status = g_test_run();
+
+    g_object_unref(app);
+    g_object_unref(mock.connection);
+    g_free(mock.reason);
+    g_test_dbus_down(bus);
+    g_object_unref(bus);
+
+    return status;
+}
@@ -0,0 +1,724 @@
+/*
+ * mateui-compile-ui.c - Compiles menu and shortcut descriptions to C tables
+ *
+ * Copyright (C) 2024 MATE Desktop Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ */
+
+/*
+ * Reads a key file describing menus and shortcuts and writes a C header
+ * with the tables mate_ui_menu_bar_new_from_compiled(),
+ * mate_ui_menu_model_new_from_compiled() and
+ * mate_ui_accel_map_add_compiled() take, so nothing is parsed at startup:
+ *
+ *   [Accels]
+ *   win.close=<Control>w
+ *
+ *   [Menu file]
+ *   Label=_File
+ *   Items=new;-;quit
+ *
+ *   [Item new]
+ *   Label=_New
+ *   Action=app.new
+ *   Accel=<Control>n
+ *   Icon=document-new
+ *
+ * Menus are emitted in file order and "-" is a separator. Accelerators of
+ * menu items are added to the accelerator table. Invalid accelerators,
+ * actions bound to two different accelerators, accelerators bound to
+ * two different actions and menu ids that map to the same C identifier
+ * are errors.
+ *
+ * Usage: mateui-compile-ui [--prefix NAME] --output FILE INPUT
+ */
+
+#include "config.h"
+#include "mate-ui-private.h"
+
+#include <string.h>
+
+typedef struct
+{
+    gchar           *action_name;
+    gchar           *accel;
+    guint            key;
+    GdkModifierType  mods;
+} CompiledAccel;
+
+typedef struct
+{
+    gchar           *label;
+    gchar           *action_name;
+    gchar           *accel;
+    gchar           *icon_name;
+    guint            key;
+    GdkModifierType  mods;
+} CompiledItem;
+
+typedef struct
+{
+    gchar     *id;
+    gchar     *identifier;
+    gchar     *label;
+    GPtrArray *items;   /* CompiledItem, NULL for separators */
+} CompiledMenu;
+
+typedef struct
+{
+    const gchar *filename;
+    GKeyFile    *keyfile;
+    GPtrArray   *accels;        /* CompiledAccel */
+    GHashTable  *by_action;     /* action_name -> CompiledAccel */
+    GHashTable  *by_key;        /* "key:mods" -> CompiledAccel */
+    GPtrArray   *menus;         /* CompiledMenu */
+    GHashTable  *by_identifier; /* C identifier -> CompiledMenu */
+} Compiler;
+
+static void
+compiled_accel_free(gpointer data)
+{
+    CompiledAccel *accel = data;
+
+    g_free(accel->action_name);
+    g_free(accel->accel);
+    g_free(accel);
+}
+
+static void
+compiled_item_free(gpointer data)
+{
+    CompiledItem *item = data;
+
+    if (item == NULL)
+        return;
+
+    g_free(item->label);
+    g_free(item->action_name);
+    g_free(item->accel);
+    g_free(item->icon_name);
+    g_free(item);
+}
+
+static void
+compiled_menu_free(gpointer data)
+{
+    CompiledMenu *menu = data;
+
+    g_free(menu->id);
+    g_free(menu->identifier);
+    g_free(menu->label);
+    g_ptr_array_unref(menu->items);
+    g_free(menu);
+}
+
+static gchar *
+make_identifier(const gchar *str)
+{
+    gchar *id = g_strdup(str);
+
+    for (gchar *p = id; *p != '\0'; p++)
+    {
+        if (!g_ascii_isalnum(*p))
+            *p = '_';
+    }
+
+    return id;
+}
+
+/*
+ * Parses like mate_ui_accel_parse(), without a display. <Primary> needs
+ * the display's keymap in GTK, so it is resolved to Control, which is
+ * what it means on every backend MATE supports.
+ */
+static gboolean
+compiler_parse_accel(const gchar     *accel,
+                     guint           *key,
+                     GdkModifierType *mods)
+{
+    GString *resolved = g_string_new(NULL);
+
+    for (const gchar *p = accel; *p != '\0'; )
+    {
+        if (g_ascii_strncasecmp(p, "<Primary>", 9) == 0)
+        {
+            g_string_append(resolved, "<Control>");
+            p += 9;
+        }
+        else
+        {
+            g_string_append_c(resolved, *p++);
+        }
+    }
+
+    gtk_accelerator_parse(resolved->str, key, mods);
+    g_string_free(resolved, TRUE);
+
+    *key = gdk_keyval_to_lower(*key);
+    *mods &= gtk_accelerator_get_default_mod_mask();
+
+    return *key != 0;
+}
+
+static gboolean
+compiler_add_accel(Compiler         *compiler,
+                   const gchar      *action_name,
+                   const gchar      *accel,
+                   guint            *key,
+                   GdkModifierType  *mods,
+                   GError          **error)
+{
+    if (!compiler_parse_accel(accel, key, mods))
+    {
+        g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                    "%s: invalid accelerator \"%s\" for action \"%s\"",
+                    compiler->filename, accel, action_name);
+        return FALSE;
+    }
+
+    CompiledAccel *existing = g_hash_table_lookup(compiler->by_action, action_name);
+    if (existing != NULL)
+    {
+        if (existing->key == *key && existing->mods == *mods)
+            return TRUE;
+
+        g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                    "%s: action \"%s\" is bound to both \"%s\" and \"%s\"",
+                    compiler->filename, action_name, existing->accel, accel);
+        return FALSE;
+    }
+
+    gchar *slot = g_strdup_printf("%u:%u", *key, (guint) *mods);
+    CompiledAccel *owner = g_hash_table_lookup(compiler->by_key, slot);
+    if (owner != NULL)
+    {
+        g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                    "%s: \"%s\" for action \"%s\" conflicts with \"%s\" for action \"%s\"",
+                    compiler->filename, accel, action_name, owner->accel, owner->action_name);
+        g_free(slot);
+        return FALSE;
+    }
+
+    CompiledAccel *entry = g_new0(CompiledAccel, 1);
+    entry->action_name = g_strdup(action_name);
+    entry->accel = g_strdup(accel);
+    entry->key = *key;
+    entry->mods = *mods;
+
+    g_ptr_array_add(compiler->accels, entry);
+    g_hash_table_insert(compiler->by_action, entry->action_name, entry);
+    g_hash_table_insert(compiler->by_key, slot, entry);
+
+    return TRUE;
+}
+
+static CompiledItem *
+compiler_read_item(Compiler     *compiler,
+                   const gchar  *id,
+                   GError      **error)
+{
+    gchar *group = g_strconcat("Item ", id, NULL);
+    CompiledItem *item = NULL;
+
+    if (!g_key_file_has_group(compiler->keyfile, group))
+    {
+        g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_GROUP_NOT_FOUND,
+                    "%s: no [%s] group", compiler->filename, group);
+        goto out;
+    }
+
+    item = g_new0(CompiledItem, 1);
+    item->label = g_key_file_get_string(compiler->keyfile, group, "Label", error);
+    if (item->label == NULL)
+        goto fail;
+
+    item->action_name = g_key_file_get_string(compiler->keyfile, group, "Action", error);
+    if (item->action_name == NULL)
+        goto fail;
+
+    item->accel = g_key_file_get_string(compiler->keyfile, group, "Accel", NULL);
+    item->icon_name = g_key_file_get_string(compiler->keyfile, group, "Icon", NULL);
+
+    if (item->accel != NULL &&
+        !compiler_add_accel(compiler, item->action_name, item->accel,
+                            &item->key, &item->mods, error))
+        goto fail;
+
+    goto out;
+
+fail:
+    compiled_item_free(item);
+    item = NULL;
+
+out:
+    g_free(group);
+    return item;
+}
+
+static gboolean
+compiler_read(Compiler  *compiler,
+              GError   **error)
+{
+    gsize n_groups;
+    gchar **groups = g_key_file_get_groups(compiler->keyfile, &n_groups);
+    gboolean ok = TRUE;
+
+    for (gsize i = 0; ok && i < n_groups; i++)
+    {
+        if (strcmp(groups[i], "Accels") == 0)
+        {
+            gchar **actions = g_key_file_get_keys(compiler->keyfile, groups[i], NULL, NULL);
+
+            for (gchar **a = actions; ok && a != NULL && *a != NULL; a++)
+            {
+                gchar *accel = g_key_file_get_string(compiler->keyfile, groups[i], *a, error);
+                guint key;
+                GdkModifierType mods;
+
+                ok = accel != NULL && compiler_add_accel(compiler, *a, accel, &key, &mods, error);
+                g_free(accel);
+            }
+
+            g_strfreev(actions);
+        }
+        else if (g_str_has_prefix(groups[i], "Menu "))
+        {
+            CompiledMenu *menu = g_new0(CompiledMenu, 1);
+            menu->id = g_strdup(groups[i] + 5);
+            menu->identifier = make_identifier(menu->id);
+            menu->items = g_ptr_array_new_with_free_func(compiled_item_free);
+            g_ptr_array_add(compiler->menus, menu);
+
+            CompiledMenu *owner = g_hash_table_lookup(compiler->by_identifier, menu->identifier);
+            if (owner != NULL)
+            {
+                g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_INVALID_VALUE,
+                            "%s: menus \"%s\" and \"%s\" both map to the C identifier \"%s\"",
+                            compiler->filename, owner->id, menu->id, menu->identifier);
+                ok = FALSE;
+                break;
+            }
+            g_hash_table_insert(compiler->by_identifier, menu->identifier, menu);
+
+            menu->label = g_key_file_get_string(compiler->keyfile, groups[i], "Label", error);
+            if (menu->label == NULL)
+            {
+                ok = FALSE;
+                break;
+            }
+
+            gchar **ids = g_key_file_get_string_list(compiler->keyfile, groups[i], "Items",
+                                                     NULL, NULL);
+
+            for (gchar **id = ids; ok && id != NULL && *id != NULL; id++)
+            {
+                if (strcmp(*id, "-") == 0)
+                {
+                    g_ptr_array_add(menu->items, NULL);
+                    continue;
+                }
+
+                CompiledItem *item = compiler_read_item(compiler, *id, error);
+                if (item == NULL)
+                    ok = FALSE;
+                else
+                    g_ptr_array_add(menu->items, item);
+            }
+
+            g_strfreev(ids);
+        }
+        else if (!g_str_has_prefix(groups[i], "Item "))
+        {
+            g_set_error(error, G_KEY_FILE_ERROR, G_KEY_FILE_ERROR_GROUP_NOT_FOUND,
+                        "%s: unknown group [%s]", compiler->filename, groups[i]);
+            ok = FALSE;
+        }
+    }
+
+    g_strfreev(groups);
+    return ok;
+}
+
+/*
+ * Builds a hash-and-displace perfect hash over the action names: each
+ * bucket of names gets a seed that sends all of its names to free slots,
+ * so a lookup is two hashes and one string compare. Reorders @accels
+ * into slot order and returns the seeds.
+ */
+static GArray *
+compiler_build_index(GPtrArray *accels)
+{
+    guint n = accels->len;
+    guint n_buckets = MAX(1, n / 2 + 1);
+
+    for (;;)
+    {
+        GPtrArray **buckets = g_new0(GPtrArray *, n_buckets);
+        guint *order = g_new(guint, n_buckets);
+        gpointer *slots = g_new0(gpointer, MAX(1, n));
+        GArray *seeds = g_array_sized_new(FALSE, TRUE, sizeof(guint32), n_buckets);
+        gboolean ok = TRUE;
+
+        g_array_set_size(seeds, n_buckets);
+
+        for (guint b = 0; b < n_buckets; b++)
+        {
+            buckets[b] = g_ptr_array_new();
+            order[b] = b;
+        }
+
+        for (guint i = 0; i < n; i++)
+        {
+            CompiledAccel *accel = g_ptr_array_index(accels, i);
+            guint b = _mate_ui_compiled_hash(accel->action_name, 0) % n_buckets;
+            g_ptr_array_add(buckets[b], accel);
+        }
+
+        /* Largest buckets first, while most slots are free */
+        for (guint i = 1; i < n_buckets; i++)
+        {
+            for (guint j = i; j > 0 && buckets[order[j]]->len > buckets[order[j - 1]]->len; j--)
+            {
+                guint tmp = order[j];
+                order[j] = order[j - 1];
+                order[j - 1] = tmp;
+            }
+        }
+
+        for (guint i = 0; ok && i < n_buckets; i++)
+        {
+            GPtrArray *bucket = buckets[order[i]];
+            guint32 seed;
+
+            if (bucket->len == 0)
+                break;
+
+            for (seed = 1; seed < (1u << 20); seed++)
+            {
+                gboolean fits = TRUE;
+
+                for (guint k = 0; fits && k < bucket->len; k++)
+                {
+                    CompiledAccel *accel = g_ptr_array_index(bucket, k);
+                    guint slot = _mate_ui_compiled_hash(accel->action_name, seed) % n;
+
+                    if (slots[slot] != NULL)
+                        fits = FALSE;
+
+                    /* Names of one bucket must not collide with each other */
+                    for (guint m = 0; fits && m < k; m++)
+                    {
+                        CompiledAccel *other = g_ptr_array_index(bucket, m);
+                        if (_mate_ui_compiled_hash(other->action_name, seed) % n == slot)
+                            fits = FALSE;
+                    }
+                }
+
+                if (fits)
+                    break;
+            }
+
+            if (seed == (1u << 20))
+            {
+                ok = FALSE;
+                break;
+            }
+
+            g_array_index(seeds, guint32, order[i]) = seed;
+            for (guint k = 0; k < bucket->len; k++)
+            {
+                CompiledAccel *accel = g_ptr_array_index(bucket, k);
+                slots[_mate_ui_compiled_hash(accel->action_name, seed) % n] = accel;
+            }
+        }
+
+        if (ok)
+        {
+            for (guint i = 0; i < n; i++)
+                g_ptr_array_index(accels, i) = slots[i];
+        }
+
+        for (guint b = 0; b < n_buckets; b++)
+            g_ptr_array_unref(buckets[b]);
+        g_free(buckets);
+        g_free(order);
+        g_free(slots);
+
+        if (ok)
+            return seeds;
+
+        g_array_unref(seeds);
+        n_buckets *= 2;
+    }
+}
+
+static void
+write_string(GString     *out,
+             const gchar *str)
+{
+    if (str == NULL)
+    {
+        g_string_append(out, "NULL");
+        return;
+    }
+
+    g_string_append_c(out, '"');
+    for (const guchar *p = (const guchar *) str; *p != '\0'; p++)
+    {
+        switch (*p)
+        {
+        case '"':
+        case '\\':
+            g_string_append_c(out, '\\');
+            g_string_append_c(out, *p);
+            break;
+        case '\n':
+            g_string_append(out, "\\n");
+            break;
+        case '\r':
+            g_string_append(out, "\\r");
+            break;
+        case '\t':
+            g_string_append(out, "\\t");
+            break;
+        default:
+            /* Always three digits, so a following digit is not taken in */
+            if (*p < 0x20 || *p == 0x7f)
+                g_string_append_printf(out, "\\%03o", *p);
+            else
+                g_string_append_c(out, *p);
+            break;
+        }
+    }
+    g_string_append_c(out, '"');
+}
+
+/* Drops mnemonic underscores for GMenu; "__" stands for a literal one */
+static gchar *
+strip_mnemonic(const gchar *label)
+{
+    GString *out = g_string_new(NULL);
+
+    for (const gchar *p = label; *p != '\0'; p++)
+    {
+        if (*p == '_')
+        {
+            if (p[1] != '_')
+                continue;
+            p++;
+        }
+        g_string_append_c(out, *p);
+    }
+
+    return g_string_free(out, FALSE);
+}
+
+static void
+compiler_write(Compiler    *compiler,
+               const gchar *prefix,
+               GString     *out)
+{
+    GArray *seeds = compiler_build_index(compiler->accels);
+
+    g_string_append_printf(out,
+                           "/* Generated by mateui-compile-ui from %s. Do not edit. */\n"
+                           "/* Include after mate-ui.h. */\n\n",
+                           compiler->filename);
+
+    if (compiler->accels->len > 0)
+    {
+        g_string_append_printf(out, "static const MateUiCompiledAccel %s_accel_entries[] = {\n", prefix);
+        for (guint i = 0; i < compiler->accels->len; i++)
+        {
+            CompiledAccel *accel = g_ptr_array_index(compiler->accels, i);
+
+            g_string_append(out, "    { ");
+            write_string(out, accel->action_name);
+            g_string_append(out, ", ");
+            write_string(out, accel->accel);
+            g_string_append_printf(out, ", 0x%04x, (GdkModifierType) 0x%x },\n",
+                                   accel->key, (guint) accel->mods);
+        }
+        g_string_append(out, "};\n\n");
+
+        g_string_append_printf(out, "static const guint32 %s_accel_seeds[] = {\n   ", prefix);
+        for (guint i = 0; i < seeds->len; i++)
+            g_string_append_printf(out, " %u,", g_array_index(seeds, guint32, i));
+        g_string_append(out, "\n};\n\n");
+
+        g_string_append_printf(out,
+                               "static const MateUiCompiledAccelTable %s_accels = {\n"
+                               "    %s_accel_entries, G_N_ELEMENTS(%s_accel_entries),\n"
+                               "    %s_accel_seeds, G_N_ELEMENTS(%s_accel_seeds),\n"
+                               "};\n\n",
+                               prefix, prefix, prefix, prefix, prefix);
+    }
+    else
+    {
+        g_string_append_printf(out,
+                               "static const MateUiCompiledAccelTable %s_accels = { NULL, 0, NULL, 0 };\n\n",
+                               prefix);
+    }
+
+    for (guint i = 0; i < compiler->menus->len; i++)
+    {
+        CompiledMenu *menu = g_ptr_array_index(compiler->menus, i);
+        const gchar *id = menu->identifier;
+
+        if (menu->items->len == 0)
+            continue;
+
+        g_string_append_printf(out, "static const MateUiCompiledMenuEntry %s_menu_%s_entries[] = {\n",
+                               prefix, id);
+        for (guint j = 0; j < menu->items->len; j++)
+        {
+            CompiledItem *item = g_ptr_array_index(menu->items, j);
+
+            if (item == NULL)
+            {
+                g_string_append(out, "    MATE_UI_COMPILED_MENU_SEPARATOR,\n");
+                continue;
+            }
+
+            gchar *plain = strip_mnemonic(item->label);
+
+            g_string_append(out, "    { ");
+            write_string(out, item->label);
+            g_string_append(out, ", ");
+            write_string(out, plain);
+            g_string_append(out, ", ");
+            write_string(out, item->action_name);
+            g_string_append(out, ", ");
+            write_string(out, item->accel);
+            g_string_append(out, ", ");
+            write_string(out, item->icon_name);
+            g_string_append_printf(out, ", 0x%04x, (GdkModifierType) 0x%x },\n",
+                                   item->key, (guint) item->mods);
+
+            g_free(plain);
+        }
+        g_string_append(out, "};\n\n");
+    }
+
+    g_string_append_printf(out, "static const MateUiCompiledSubmenu %s_menus[] = {\n", prefix);
+    for (guint i = 0; i < compiler->menus->len; i++)
+    {
+        CompiledMenu *menu = g_ptr_array_index(compiler->menus, i);
+        const gchar *id = menu->identifier;
+        gchar *plain = strip_mnemonic(menu->label);
+
+        g_string_append(out, "    { ");
+        write_string(out, menu->label);
+        g_string_append(out, ", ");
+        write_string(out, plain);
+
+        if (menu->items->len > 0)
+            g_string_append_printf(out, ", %s_menu_%s_entries, G_N_ELEMENTS(%s_menu_%s_entries) },\n",
+                                   prefix, id, prefix, id);
+        else
+            g_string_append(out, ", NULL, 0 },\n");
+
+        g_free(plain);
+    }
+    if (compiler->menus->len == 0)
+        g_string_append(out, "    { NULL, NULL, NULL, 0 },\n");
+    g_string_append(out, "};\n");
+
+    g_array_unref(seeds);
+}
+
+int
+main(int    argc,
+     char **argv)
+{
+    gchar *prefix = NULL;
+    gchar *output = NULL;
+    GError *error = NULL;
+    int status = 1;
+
+    GOptionEntry entries[] = {
+        { "prefix", 'p', 0, G_OPTION_ARG_STRING, &prefix,
+          "Prefix of the generated identifiers (default: input basename)", "NAME" },
+        { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+          "File to write", "FILE" },
+        { NULL }
+    };
+
+    GOptionContext *context = g_option_context_new("INPUT");
+    g_option_context_set_summary(context,
+                                 "Compiles menu and shortcut descriptions to C tables for libmateui.");
+    g_option_context_add_main_entries(context, entries, NULL);
+
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+        goto out;
+
+    if (argc != 2 || output == NULL)
+    {
+        gchar *help = g_option_context_get_help(context, TRUE, NULL);
+        g_printerr("%s", help);
+        g_free(help);
+        goto out;
+    }
+
+    if (prefix != NULL)
+    {
+        /* Goes into C identifiers as is */
+        gchar *id = make_identifier(prefix);
+        g_free(prefix);
+        prefix = id;
+    }
+    else
+    {
+        gchar *base = g_path_get_basename(argv[1]);
+        gchar *dot = strchr(base, '.');
+        if (dot != NULL)
+            *dot = '\0';
+        prefix = make_identifier(base);
+        g_free(base);
+    }
+
+    Compiler compiler = { 0 };
+    compiler.filename = argv[1];
+    compiler.keyfile = g_key_file_new();
+    compiler.accels = g_ptr_array_new_with_free_func(compiled_accel_free);
+    compiler.by_action = g_hash_table_new(g_str_hash, g_str_equal);
+    compiler.by_key = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    compiler.menus = g_ptr_array_new_with_free_func(compiled_menu_free);
+    compiler.by_identifier = g_hash_table_new(g_str_hash, g_str_equal);
+
+    if (g_key_file_load_from_file(compiler.keyfile, argv[1], G_KEY_FILE_NONE, &error) &&
+        compiler_read(&compiler, &error))
+    {
+        GString *out = g_string_new(NULL);
+        compiler_write(&compiler, prefix, out);
+
+        if (g_file_set_contents(output, out->str, out->len, &error))
+            status = 0;
+
+        g_string_free(out, TRUE);
+    }
+
+    g_hash_table_unref(compiler.by_identifier);
+    g_hash_table_unref(compiler.by_key);
+    g_hash_table_unref(compiler.by_action);
+    g_ptr_array_unref(compiler.menus);
+    g_ptr_array_unref(compiler.accels);
+    g_key_file_unref(compiler.keyfile);
+
+out:
+    if (error != NULL)
+    {
+        g_printerr("mateui-compile-ui: %s\n", error->message);
+        g_error_free(error);
+    }
+
+    g_option_context_free(context);
+    g_free(prefix);
+    g_free(output);
+
+    return status;
+}